@@ -0,0 +1,198 @@
+// Runs the epoll and io_uring backends side by side in-process with a trivial handler and
+// drives each with the same closed-loop load: every connection keeps `depth` pipelined
+// queries in flight for `seconds`. Reports throughput and round-trip latency percentiles.
+//
+// Usage: BackendBench [connections] [depth] [seconds] [reactors] [port]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../src/socket/ServerBackend.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+	double requestsPerSec;
+	int64_t p50Us;
+	int64_t p99Us;
+	int64_t p999Us;
+	int64_t maxUs;
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p)
+{
+	const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+	return sorted[index];
+}
+
+int connectTo(unsigned short port)
+{
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd == -1 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
+	{
+		throw std::runtime_error("connect failed");
+	}
+	const int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+// One connection's closed loop; returns the round-trip time of every answered query
+std::vector<int64_t> driveConnection(unsigned short port, size_t depth, Clock::time_point deadline)
+{
+	const int fd = connectTo(port);
+	const std::string query = "bench\n7\n";
+	std::deque<Clock::time_point> sentAt;
+	std::vector<int64_t> latencies;
+	char buffer[16384];
+	size_t newlines = 0;
+
+	auto sendQueries = [&](size_t count) {
+		std::string batch;
+		for (size_t i = 0; i < count; ++i)
+		{
+			batch += query;
+			sentAt.push_back(Clock::now());
+		}
+		send(fd, batch.data(), batch.size(), MSG_NOSIGNAL);
+	};
+
+	sendQueries(depth);
+	while (!sentAt.empty())
+	{
+		const ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+		if (bytes <= 0)
+		{
+			break;
+		}
+
+		const auto now = Clock::now();
+		size_t answered = 0;
+		newlines += std::count(buffer, buffer + bytes, '\n');
+		// Every response is two lines
+		for (; newlines >= 2; newlines -= 2, ++answered)
+		{
+			latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - sentAt.front()).count());
+			sentAt.pop_front();
+		}
+
+		if (now < deadline && answered > 0)
+		{
+			sendQueries(answered);
+		}
+	}
+
+	close(fd);
+	return latencies;
+}
+
+Result runBenchmark(BackendKind kind, unsigned short port, size_t connections, size_t depth, int seconds, size_t reactors)
+{
+	ServerConfig config;
+	config.backend = kind;
+	config.reactorCount = reactors;
+	auto backend = makeServerBackend(port, config);
+	backend->setMessageHandler([](std::string_view, WireProtocol, std::string& response) {
+		response = "server\n50\n";
+	});
+
+	std::thread serverThread([&backend] { backend->run(); });
+	// Port 0 leaves the choice to the kernel
+	port = backend->getLocalPort();
+
+	std::vector<std::vector<int64_t>> perConnection(connections);
+	std::vector<std::thread> clients;
+	clients.reserve(connections);
+
+	const auto start = Clock::now();
+	const auto deadline = start + std::chrono::seconds(seconds);
+	for (size_t i = 0; i < connections; ++i)
+	{
+		clients.emplace_back([&, i] {
+			perConnection[i] = driveConnection(port, depth, deadline);
+		});
+	}
+	for (auto& t: clients)
+	{
+		t.join();
+	}
+	const auto elapsed = Clock::now() - start;
+
+	backend->shutdown();
+	serverThread.join();
+
+	std::vector<int64_t> latencies;
+	for (auto& part: perConnection)
+	{
+		latencies.insert(latencies.end(), part.begin(), part.end());
+	}
+	if (latencies.empty())
+	{
+		return {};
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	return {
+		static_cast<double>(latencies.size()) / std::chrono::duration<double>(elapsed).count(),
+		percentile(latencies, 0.50),
+		percentile(latencies, 0.99),
+		percentile(latencies, 0.999),
+		latencies.back(),
+	};
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0)
+			  << std::setw(14) << r.requestsPerSec
+			  << std::setw(10) << r.p50Us
+			  << std::setw(10) << r.p99Us
+			  << std::setw(10) << r.p999Us
+			  << std::setw(12) << r.maxUs << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t connections = argc > 1 ? std::stoul(argv[1]) : 32;
+	const size_t depth = argc > 2 ? std::stoul(argv[2]) : 16;
+	const int seconds = argc > 3 ? std::stoi(argv[3]) : 5;
+	const size_t reactors = argc > 4 ? std::stoul(argv[4]) : 1;
+	const auto port = static_cast<unsigned short>(argc > 5 ? std::stoi(argv[5]) : 5600);
+
+	// Both runs are printed together at the end, after the backends' connection logs
+	const Result epoll = runBenchmark(BackendKind::Epoll, port, connections, depth, seconds, reactors);
+	const Result ioUring = runBenchmark(BackendKind::IoUring, port, connections, depth, seconds, reactors);
+
+	std::cout << std::endl << "connections=" << connections << " depth=" << depth
+			  << " seconds=" << seconds << " reactors=" << reactors << std::endl
+			  << std::left << std::setw(10) << "backend" << std::right
+			  << std::setw(14) << "requests/s"
+			  << std::setw(10) << "p50 us"
+			  << std::setw(10) << "p99 us"
+			  << std::setw(10) << "p99.9 us"
+			  << std::setw(12) << "max us" << std::endl;
+	printResult("epoll", epoll);
+	printResult("io_uring", ioUring);
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+// Measures what busy polling buys an in-process epoll server answering inline, for each of a
+// few spin budgets (ServerConfig::busyPoll.budget, 0 = blocking epoll_wait): clients send
+// one query at a time over their own connection, pausing `gap` between an answer and the
+// next query. Reports the round-trip latency seen by the clients against the CPU time the
+// whole process spent per request and the share of the run the reactor spent spinning.
+//
+// Usage: BusyPollBench [clients] [seconds] [gap us] [budgets us, comma-separated] [port]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include "../src/socket/ServerBackend.h"
+#include "../src/socket/ServerMetrics.h"
+#include "../src/socket/TcpClient.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+	double requestsPerSec;
+	uint64_t p50Us;
+	uint64_t p99Us;
+	uint64_t p999Us;
+	double cpuUsPerRequest;
+	// Share of the run the reactor spent spinning, and how often a spin found events
+	double spinShare;
+	double spinHitRate;
+};
+
+const std::string query = "bench\n7\n";
+
+double processCpuUs()
+{
+	timespec now{};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec) * 1e6 + static_cast<double>(now.tv_nsec) / 1e3;
+}
+
+// One query at a time until deadline; every round trip goes into latency
+uint64_t driveClient(unsigned short port, std::chrono::microseconds gap, Clock::time_point deadline, Histogram& latency)
+{
+	TcpClient socket;
+	if (!socket.connect("127.0.0.1", port))
+	{
+		throw std::runtime_error("connect failed");
+	}
+
+	uint64_t answered = 0;
+	char buffer[256];
+	while (Clock::now() < deadline)
+	{
+		const auto sentAt = Clock::now();
+		if (::send(socket.getHandle(), query.data(), query.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(query.size()))
+		{
+			break;
+		}
+		// The answer is two lines
+		int lines = 0;
+		while (lines < 2)
+		{
+			const ssize_t bytes = ::recv(socket.getHandle(), buffer, sizeof(buffer), 0);
+			if (bytes <= 0)
+			{
+				return answered;
+			}
+			lines += static_cast<int>(std::count(buffer, buffer + bytes, '\n'));
+		}
+		latency.record(ServerMetrics::elapsedNs(sentAt, Clock::now()));
+		++answered;
+		if (gap.count() > 0)
+		{
+			std::this_thread::sleep_for(gap);
+		}
+	}
+	return answered;
+}
+
+Result run(std::chrono::microseconds budget, unsigned short port, size_t clients, int seconds, std::chrono::microseconds gap)
+{
+	ServerConfig config;
+	config.busyPoll.budget = budget;
+	auto backend = makeServerBackend(port, config);
+	backend->setMessageHandler([](std::string_view, WireProtocol, std::string& response) {
+		response = "server\n50\n";
+	}, DispatchPolicy::Inline);
+	std::thread serverThread([&backend] { backend->run(); });
+	// Port 0 leaves the choice to the kernel
+	port = backend->getLocalPort();
+
+	ServerMetrics& metrics = ServerMetrics::instance();
+	const uint64_t spinBefore = metrics.busyPollSpin.snapshot().sum;
+	const uint64_t hitsBefore = metrics.busyPollHits.value();
+	const uint64_t missesBefore = metrics.busyPollMisses.value();
+
+	Histogram latency;
+	std::atomic<uint64_t> answered{ 0 };
+	std::vector<std::thread> threads;
+	const double cpuBefore = processCpuUs();
+	const auto start = Clock::now();
+	const auto deadline = start + std::chrono::seconds(seconds);
+	for (size_t i = 0; i < clients; ++i)
+	{
+		threads.emplace_back([&] { answered.fetch_add(driveClient(port, gap, deadline, latency)); });
+	}
+	for (auto& thread: threads)
+	{
+		thread.join();
+	}
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	const double cpu = processCpuUs() - cpuBefore;
+
+	const double spinSeconds = static_cast<double>(metrics.busyPollSpin.snapshot().sum - spinBefore) / 1e9;
+	const uint64_t hits = metrics.busyPollHits.value() - hitsBefore;
+	const uint64_t spins = hits + metrics.busyPollMisses.value() - missesBefore;
+
+	backend->shutdown();
+	serverThread.join();
+
+	const uint64_t total = answered.load();
+	if (total == 0)
+	{
+		return {};
+	}
+	const HistogramSnapshot snapshot = latency.snapshot();
+	return {
+		static_cast<double>(total) / elapsed,
+		snapshot.percentile(0.50) / 1000,
+		snapshot.percentile(0.99) / 1000,
+		snapshot.percentile(0.999) / 1000,
+		cpu / static_cast<double>(total),
+		spinSeconds / elapsed,
+		spins != 0 ? static_cast<double>(hits) / static_cast<double>(spins) : 0,
+	};
+}
+
+std::vector<int> parseBudgets(const std::string& list)
+{
+	std::vector<int> budgets;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		const size_t comma = std::min(list.find(',', start), list.size());
+		budgets.push_back(std::stoi(list.substr(start, comma - start)));
+		start = comma + 1;
+	}
+	return budgets;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t clients = argc > 1 ? std::stoul(argv[1]) : 1;
+	const int seconds = argc > 2 ? std::stoi(argv[2]) : 3;
+	const auto gap = std::chrono::microseconds(argc > 3 ? std::stoi(argv[3]) : 0);
+	const std::vector<int> budgets = parseBudgets(argc > 4 ? argv[4] : "0,20,100");
+	const auto port = static_cast<unsigned short>(argc > 5 ? std::stoi(argv[5]) : 5800);
+
+	std::vector<Result> results;
+	for (size_t i = 0; i < budgets.size(); ++i)
+	{
+		// A port of its own per run, so that no connection of the last one lingers in the way
+		const auto runPort = static_cast<unsigned short>(port == 0 ? 0 : port + i);
+		results.push_back(run(std::chrono::microseconds(budgets[i]), runPort, clients, seconds, gap));
+	}
+
+	std::cout << std::endl << "clients=" << clients << " seconds=" << seconds << " gap=" << gap.count() << " us" << std::endl
+			  << std::left << std::setw(12) << "budget us" << std::right
+			  << std::setw(12) << "requests/s"
+			  << std::setw(10) << "p50 us"
+			  << std::setw(10) << "p99 us"
+			  << std::setw(10) << "p99.9 us"
+			  << std::setw(12) << "CPU us/req"
+			  << std::setw(10) << "spin %"
+			  << std::setw(10) << "hit %" << std::endl;
+	for (size_t i = 0; i < budgets.size(); ++i)
+	{
+		const Result& r = results[i];
+		std::cout << std::left << std::setw(12) << budgets[i] << std::right << std::fixed
+				  << std::setw(12) << std::setprecision(0) << r.requestsPerSec
+				  << std::setw(10) << r.p50Us
+				  << std::setw(10) << r.p99Us
+				  << std::setw(10) << r.p999Us
+				  << std::setw(12) << std::setprecision(2) << r.cpuUsPerRequest
+				  << std::setw(10) << std::setprecision(1) << r.spinShare * 100
+				  << std::setw(10) << r.spinHitRate * 100 << std::endl;
+	}
+
+	return 0;
+}
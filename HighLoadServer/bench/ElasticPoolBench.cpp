@@ -0,0 +1,155 @@
+// Runs the same open-loop load through a fixed ThreadPool and an elastic one, in two phases:
+//  - blocking: tasks that sleep, as handlers waiting on I/O do, and need more workers than
+//    there are cores;
+//  - cpu: tasks that spin, for which workers beyond the cores only take turns.
+// Tasks arrive at a fixed rate whatever the pool does; latency runs from a task's due time
+// to its end. Prints every resize of the elastic pool as it happens.
+//
+// Usage: ElasticPoolBench [seconds per phase] [minWorkers] [maxWorkers] [fixedWorkers]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "../src/common/Metrics.h"
+#include "../src/common/ThreadPool.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Phase
+{
+	const char* name;
+	double tasksPerSec;
+	std::chrono::microseconds work;
+	bool blocking;
+};
+
+struct Result
+{
+	double completedPerSec;
+	uint64_t p50Us;
+	uint64_t p99Us;
+	size_t finalWorkers;
+};
+
+void spinFor(std::chrono::microseconds duration)
+{
+	const auto until = Clock::now() + duration;
+	while (Clock::now() < until)
+	{
+	}
+}
+
+Result runPhase(ThreadPool& pool, const Phase& phase, int seconds)
+{
+	Histogram latency;
+	std::atomic<uint64_t> completed{ 0 };
+	const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / phase.tasksPerSec));
+	const auto start = Clock::now();
+	const auto end = start + std::chrono::seconds(seconds);
+
+	auto due = start;
+	for (; due < end; due += period)
+	{
+		std::this_thread::sleep_until(due);
+		pool.enqueue([&, due] {
+			if (phase.blocking)
+			{
+				std::this_thread::sleep_for(phase.work);
+			}
+			else
+			{
+				spinFor(phase.work);
+			}
+			latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count()));
+			completed.fetch_add(1, std::memory_order_relaxed);
+		});
+	}
+
+	// Whatever is still queued finishes before the phase counts as done
+	std::atomic<bool> drained{ false };
+	pool.enqueue([&drained] { drained.store(true, std::memory_order_release); });
+	while (!drained.load(std::memory_order_acquire))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	const HistogramSnapshot snapshot = latency.snapshot();
+	return { static_cast<double>(completed.load()) / elapsed, snapshot.percentile(0.50) / 1000, snapshot.percentile(0.99) / 1000, pool.getThreadCount() };
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(0)
+			  << std::setw(12) << r.completedPerSec
+			  << std::setw(12) << r.p50Us
+			  << std::setw(12) << r.p99Us
+			  << std::setw(10) << r.finalWorkers << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const int seconds = argc > 1 ? std::stoi(argv[1]) : 5;
+	const size_t minWorkers = argc > 2 ? std::stoul(argv[2]) : 1;
+	const size_t maxWorkers = argc > 3 ? std::stoul(argv[3]) : 64;
+	const size_t fixedWorkers = argc > 4 ? std::stoul(argv[4]) : std::thread::hardware_concurrency();
+	const size_t cores = std::thread::hardware_concurrency();
+
+	// 2 ms of waiting at 4000/s needs 8 workers busy on average; the spinning phase keeps
+	// about 70% of every core busy
+	const Phase phases[] = {
+		{ "blocking", 4000, std::chrono::microseconds(2000), true },
+		{ "cpu", 7000.0 * static_cast<double>(cores), std::chrono::microseconds(100), false },
+	};
+
+	std::cout << "seconds=" << seconds << " elastic=" << minWorkers << "-" << maxWorkers
+			  << " fixed=" << fixedWorkers << " cores=" << cores << std::endl;
+
+	PoolSizing sizing;
+	sizing.minThreads = minWorkers;
+	sizing.maxThreads = maxWorkers;
+	sizing.onResize = [](const PoolResize& resize) {
+		std::cout << "  resize " << resize.from << " -> " << resize.to << ": wait " << resize.queueWait.count()
+				  << " us, busy " << static_cast<int>(resize.busy * 100) << "%, CPU "
+				  << static_cast<int>(resize.cpus * 100) << "%" << std::endl;
+	};
+
+	Result fixed[std::size(phases)];
+	Result elastic[std::size(phases)];
+	{
+		ThreadPool pool(fixedWorkers);
+		for (size_t i = 0; i < std::size(phases); ++i)
+		{
+			fixed[i] = runPhase(pool, phases[i], seconds);
+		}
+	}
+	{
+		ThreadPool pool(minWorkers, 0, {}, sizing);
+		for (size_t i = 0; i < std::size(phases); ++i)
+		{
+			std::cout << phases[i].name << " phase, elastic pool:" << std::endl;
+			elastic[i] = runPhase(pool, phases[i], seconds);
+		}
+	}
+
+	std::cout << std::endl << std::left << std::setw(20) << "phase/pool" << std::right
+			  << std::setw(12) << "done/s"
+			  << std::setw(12) << "p50 us"
+			  << std::setw(12) << "p99 us"
+			  << std::setw(10) << "workers" << std::endl;
+	for (size_t i = 0; i < std::size(phases); ++i)
+	{
+		printResult(std::string(phases[i].name) + "/fixed", fixed[i]);
+		printResult(std::string(phases[i].name) + "/elastic", elastic[i]);
+	}
+
+	return 0;
+}
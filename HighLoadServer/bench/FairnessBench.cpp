@@ -0,0 +1,176 @@
+// Runs the same open-loop load from several tenants through a ThreadPool queued three ways:
+//  - fifo: every task untagged, one queue in arrival order;
+//  - fair: tagged with its tenant as the key, so each tenant has its own queue, served in
+//    turn (deficit round robin);
+//  - fair+low: as fair, with the noisy tenant's tasks in the Low lane.
+// The quiet tenants send evenly spaced tasks; the noisy one sends bursts, each more than
+// the pool gets through before the next quiet task arrives. Latency runs from a task's due
+// time to its end; reported separately for the quiet tenants and the noisy one.
+//
+// Usage: FairnessBench [seconds] [workers] [quiet tenants] [task us]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../src/common/Metrics.h"
+#include "../src/common/ThreadPool.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+enum class Queuing
+{
+	Fifo,
+	Fair,
+	FairLow
+};
+
+struct Load
+{
+	size_t quietTenants;
+	std::chrono::microseconds work;
+	// Tasks per second from all quiet tenants together
+	double quietPerSec;
+	// A burst of noisyBurst tasks every noisyPeriod
+	size_t noisyBurst;
+	std::chrono::milliseconds noisyPeriod;
+};
+
+struct Latency
+{
+	uint64_t p50Us;
+	uint64_t p99Us;
+	uint64_t maxUs;
+};
+
+struct Result
+{
+	Latency quiet;
+	Latency noisy;
+};
+
+constexpr uint64_t noisyKey = 0;
+
+void spinFor(std::chrono::microseconds duration)
+{
+	const auto until = Clock::now() + duration;
+	while (Clock::now() < until)
+	{
+	}
+}
+
+Latency summarize(const Histogram& histogram)
+{
+	const HistogramSnapshot snapshot = histogram.snapshot();
+	return { snapshot.percentile(0.50) / 1000, snapshot.percentile(0.99) / 1000, snapshot.max / 1000 };
+}
+
+Result run(Queuing queuing, const Load& load, size_t workers, int seconds)
+{
+	Histogram quiet;
+	Histogram noisy;
+	std::atomic<uint64_t> pending{ 0 };
+	ThreadPool pool(workers);
+
+	auto submit = [&](uint64_t tenant, Clock::time_point due) {
+		Histogram& latency = tenant == noisyKey ? noisy : quiet;
+		TaskTag tag;
+		if (queuing != Queuing::Fifo)
+		{
+			tag.key = tenant;
+		}
+		if (queuing == Queuing::FairLow && tenant == noisyKey)
+		{
+			tag.lane = TaskLane::Low;
+		}
+		pending.fetch_add(1, std::memory_order_relaxed);
+		pool.enqueue([&, due] {
+			spinFor(load.work);
+			latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count()));
+			pending.fetch_sub(1, std::memory_order_release);
+		}, tag);
+	};
+
+	const auto start = Clock::now();
+	const auto end = start + std::chrono::seconds(seconds);
+	std::thread noisyThread([&] {
+		for (auto due = start; due < end; due += load.noisyPeriod)
+		{
+			std::this_thread::sleep_until(due);
+			for (size_t i = 0; i < load.noisyBurst; ++i)
+			{
+				submit(noisyKey, due);
+			}
+		}
+	});
+
+	const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / load.quietPerSec));
+	uint64_t next = 0;
+	for (auto due = start; due < end; due += period)
+	{
+		std::this_thread::sleep_until(due);
+		submit(1 + next++ % load.quietTenants, due);
+	}
+	noisyThread.join();
+
+	while (pending.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return { summarize(quiet), summarize(noisy) };
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(12) << name << std::right
+			  << std::setw(12) << r.quiet.p50Us
+			  << std::setw(12) << r.quiet.p99Us
+			  << std::setw(12) << r.quiet.maxUs
+			  << std::setw(12) << r.noisy.p50Us
+			  << std::setw(12) << r.noisy.p99Us << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const int seconds = argc > 1 ? std::stoi(argv[1]) : 5;
+	const size_t workers = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+	const size_t quietTenants = argc > 3 ? std::stoul(argv[3]) : 8;
+	const auto work = std::chrono::microseconds(argc > 4 ? std::stoi(argv[4]) : 50);
+
+	// The quiet tenants keep 20% of the workers busy and the noisy one 60% on average, in
+	// bursts of 60 ms of work for the whole pool every 100 ms
+	const double capacity = static_cast<double>(workers) * 1e6 / static_cast<double>(work.count());
+	const Load load{
+		quietTenants,
+		work,
+		0.2 * capacity,
+		static_cast<size_t>(0.06 * capacity),
+		std::chrono::milliseconds(100),
+	};
+
+	std::cout << "seconds=" << seconds << " workers=" << workers << " quiet tenants=" << quietTenants
+			  << " task=" << work.count() << " us, quiet " << static_cast<int>(load.quietPerSec)
+			  << "/s, noisy bursts of " << load.noisyBurst << " every " << load.noisyPeriod.count() << " ms" << std::endl;
+
+	const Result fifo = run(Queuing::Fifo, load, workers, seconds);
+	const Result fair = run(Queuing::Fair, load, workers, seconds);
+	const Result fairLow = run(Queuing::FairLow, load, workers, seconds);
+
+	std::cout << std::endl << std::left << std::setw(12) << "queuing" << std::right
+			  << std::setw(12) << "quiet p50"
+			  << std::setw(12) << "quiet p99"
+			  << std::setw(12) << "quiet max"
+			  << std::setw(12) << "noisy p50"
+			  << std::setw(12) << "noisy p99" << "  (us)" << std::endl;
+	printResult("fifo", fifo);
+	printResult("fair", fair);
+	printResult("fair+low", fairLow);
+
+	return 0;
+}
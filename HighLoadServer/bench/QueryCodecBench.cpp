@@ -0,0 +1,223 @@
+// Time and heap allocations per request, counted across every thread.
+//
+// The codec rows cover only parsing the query and serializing the answer: the stream-based
+// parseQuery/constructQuery pair against the view-based parseQueryView/appendQuery one, the
+// latter writing into a single reused string. The server rows cover what a reactor does with
+// a decoded request: RequestPipeline dispatches it to Server's handler (makeQueryHandler),
+// inline or through the worker pool, and the response is queued, sent and its buffer handed
+// back, as EpollReactor does once the bytes are written.
+//
+// Usage: QueryCodecBench [requests]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../src/common/constructQuery.h"
+#include "../src/common/parseQuery.h"
+#include "../src/server/QueryHandler.h"
+#include "../src/socket/AdmissionControl.h"
+#include "../src/socket/RequestPipeline.h"
+
+namespace
+{
+std::atomic<uint64_t> g_allocations{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+	double nsPerRequest;
+	double allocationsPerRequest;
+};
+
+const std::string serverName = "Server of Main";
+constexpr int serverNumber = 50;
+// Requests a connection has in flight on the pool, as a pipelining client keeps them
+constexpr size_t poolWindow = 64;
+
+// Keeps the optimiser from discarding the work
+volatile size_t g_sink = 0;
+
+// handle(request) takes one request; flush() finishes whatever is still in flight
+template <typename Handler, typename Flush>
+Result runBenchmark(const std::vector<std::string>& requests, size_t count, Handler&& handle, Flush&& flush)
+{
+	// One warm-up pass so lazily grown buffers are excluded, as they are in a running server
+	for (size_t i = 0; i < requests.size() * 4; ++i)
+	{
+		handle(requests[i % requests.size()]);
+	}
+	flush();
+
+	const uint64_t allocationsBefore = g_allocations.load(std::memory_order_relaxed);
+	const auto start = Clock::now();
+	for (size_t i = 0; i < count; ++i)
+	{
+		handle(requests[i % requests.size()]);
+	}
+	flush();
+	const auto elapsed = Clock::now() - start;
+	const uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+	return {
+		std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(count),
+		static_cast<double>(allocations) / static_cast<double>(count),
+	};
+}
+
+template <typename Handler>
+Result runBenchmark(const std::vector<std::string>& requests, size_t count, Handler&& handle)
+{
+	return runBenchmark(requests, count, handle, [] {});
+}
+
+// A connection as the reactor sees it: the decoded requests go to the pipeline, and whatever
+// lands in the outbound queue is "sent" and its buffer returned
+class Connection
+{
+public:
+	Connection(RequestPipeline& pipeline)
+		: m_pipeline(pipeline)
+	{
+	}
+
+	void dispatch(std::string_view request)
+	{
+		m_pipeline.dispatch(m_stream, m_handle, -1, request, WireProtocol::Text);
+		++m_inFlight;
+		send();
+	}
+
+	void drain()
+	{
+		m_pipeline.drainCompletions([this](RequestPipeline::Completion& completion) {
+			m_stream.accept(completion.sequence, std::move(completion.response));
+		});
+		send();
+	}
+
+	[[nodiscard]] size_t inFlight() const
+	{
+		return m_inFlight;
+	}
+
+private:
+	void send()
+	{
+		while (!m_stream.outbound.empty())
+		{
+			g_sink = g_sink + m_stream.outbound.front().size();
+			m_pipeline.buffers().recycle(std::move(m_stream.outbound.front()));
+			m_stream.outbound.pop_front();
+			--m_inFlight;
+		}
+	}
+
+	RequestPipeline& m_pipeline;
+	RequestStream m_stream;
+	SlotHandle m_handle{ 0, 1 };
+	size_t m_inFlight = 0;
+};
+
+Result runServer(const std::vector<std::string>& requests, size_t count, DispatchPolicy dispatch)
+{
+	ServerConfig config;
+	auto pool = makeExecutor(WorkerPoolKind::Shared);
+	AdmissionControl admission(*pool, config);
+	const ServerBackend::MessageHandler handler = makeQueryHandler(serverName, serverNumber);
+	RequestPipeline pipeline(admission, handler);
+	pipeline.setDispatchPolicy(dispatch);
+
+	Connection connection(pipeline);
+	const auto flush = [&connection] {
+		while (connection.inFlight() != 0)
+		{
+			connection.drain();
+		}
+	};
+	return runBenchmark(requests, count, [&](std::string_view request) {
+		if (connection.inFlight() >= poolWindow)
+		{
+			flush();
+		}
+		connection.dispatch(request);
+	}, flush);
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+			  << std::setw(12) << std::setprecision(1) << r.nsPerRequest
+			  << std::setw(16) << std::setprecision(2) << r.allocationsPerRequest << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? std::stoul(argv[1]) : 2'000'000;
+
+	std::vector<std::string> requests;
+	for (int i = 0; i < 64; ++i)
+	{
+		requests.push_back(constructQuery({ "Client of load_client_" + std::to_string(i), i % 101 }));
+	}
+
+	const Result legacy = runBenchmark(requests, count, [](const std::string& request) {
+		const auto [clientName, clientNumber] = parseQuery(request);
+		const std::string response = constructQuery({ serverName, serverNumber });
+		g_sink = g_sink + clientName.size() + static_cast<size_t>(clientNumber) + response.size();
+	});
+
+	// Codec only: one response buffer reused for every request
+	std::string response;
+	const Result view = runBenchmark(requests, count, [&response](std::string_view request) {
+		const auto query = parseQueryView(request);
+		response.clear();
+		appendQuery(response, serverName, serverNumber);
+		g_sink = g_sink + query->name.size() + static_cast<size_t>(query->number) + response.size();
+	});
+
+	const Result inlineServer = runServer(requests, count, DispatchPolicy::Inline);
+	const Result poolServer = runServer(requests, count / 4, DispatchPolicy::Pool);
+
+	std::cout << "requests=" << count << std::endl
+			  << std::left << std::setw(16) << "path" << std::right
+			  << std::setw(12) << "ns/request"
+			  << std::setw(16) << "allocs/request" << std::endl;
+	printResult("codec stream", legacy);
+	printResult("codec view", view);
+	printResult("server inline", inlineServer);
+	printResult("server pool", poolServer);
+
+	return 0;
+}
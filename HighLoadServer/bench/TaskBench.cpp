@@ -0,0 +1,204 @@
+// Per-task overhead of the worker pools' task path.
+//  - wrapping: storing a callable in std::function<void()> and in Task, moving it through a
+//    queue and invoking it, for a small capture and for one the size of the reactors'
+//    per-request lambda; time and heap allocations per task;
+//  - pools: one producer feeding ThreadPool and WorkStealingThreadPool task by task with
+//    enqueue(), in chunks with enqueueBulk(), and round trips through submit().get().
+//
+// Usage: TaskBench [tasks] [workers] [bulkSize]
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/common/Task.h"
+#include "../src/common/ThreadPool.h"
+#include "../src/common/WorkStealingThreadPool.h"
+
+namespace
+{
+std::atomic<uint64_t> g_allocations{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+	double nsPerTask;
+	double allocationsPerTask;
+};
+
+// Keeps the optimiser from discarding the work
+std::atomic<uint64_t> g_sink{ 0 };
+
+double nsPerTask(Clock::duration elapsed, size_t count)
+{
+	return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(count);
+}
+
+template <typename Body>
+Result measure(size_t count, Body&& body)
+{
+	const uint64_t allocationsBefore = g_allocations.load(std::memory_order_relaxed);
+	const auto start = Clock::now();
+	body();
+	const auto elapsed = Clock::now() - start;
+	const uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - allocationsBefore;
+	return { nsPerTask(elapsed, count), static_cast<double>(allocations) / static_cast<double>(count) };
+}
+
+// Stores count callables made by makeCallable as Wrapper, a batch at a time, then runs them
+template <typename Wrapper, typename MakeCallable>
+Result wrapAndRun(size_t count, MakeCallable&& makeCallable)
+{
+	constexpr size_t batch = 1024;
+	// Reserved up front, so every allocation counted is the wrapper's own
+	std::vector<Wrapper> queue;
+	queue.reserve(batch);
+
+	return measure(count, [&] {
+		for (size_t done = 0; done < count; done += batch)
+		{
+			for (size_t i = 0; i < batch; ++i)
+			{
+				queue.emplace_back(makeCallable(done + i));
+			}
+			for (Wrapper& callable: queue)
+			{
+				callable();
+			}
+			queue.clear();
+		}
+	});
+}
+
+void printRow(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(34) << name << std::right << std::fixed
+			  << std::setw(12) << std::setprecision(1) << r.nsPerTask
+			  << std::setw(16) << std::setprecision(2) << r.allocationsPerTask << std::endl;
+}
+
+void waitFor(const std::atomic<size_t>& completed, size_t total)
+{
+	while (completed.load(std::memory_order_acquire) < total)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void benchmarkPool(const std::string& name, Executor& pool, size_t count, size_t bulkSize)
+{
+	std::atomic<size_t> completed{ 0 };
+	auto makeTask = [&completed]() {
+		return Task([&completed] { completed.fetch_add(1, std::memory_order_release); });
+	};
+
+	const Result single = measure(count, [&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			pool.enqueue(makeTask());
+		}
+		waitFor(completed, count);
+	});
+
+	completed = 0;
+	const size_t chunks = (count + bulkSize - 1) / bulkSize;
+	std::vector<Task> chunk(bulkSize);
+	const Result bulk = measure(chunks * bulkSize, [&] {
+		for (size_t i = 0; i < chunks; ++i)
+		{
+			for (Task& task: chunk)
+			{
+				task = makeTask();
+			}
+			pool.enqueueBulk(chunk);
+		}
+		waitFor(completed, chunks * bulkSize);
+	});
+
+	// Each round trip waits for the previous one, so this is hand-off latency, not throughput
+	const size_t roundTrips = std::max<size_t>(count / 100, 1);
+	const Result submitted = measure(roundTrips, [&] {
+		for (size_t i = 0; i < roundTrips; ++i)
+		{
+			g_sink += pool.submit([i] { return i; }).get();
+		}
+	});
+
+	printRow(name + " enqueue", single);
+	printRow(name + " enqueueBulk", bulk);
+	printRow(name + " submit().get()", submitted);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? std::stoul(argv[1]) : 2'000'000;
+	const size_t workers = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+	const size_t bulkSize = argc > 3 ? std::stoul(argv[3]) : 64;
+
+	// Small: a pointer and a counter. Request-sized: what the reactors capture per request.
+	auto small = [](size_t i) {
+		return [i, sink = &g_sink] { sink->fetch_add(i, std::memory_order_relaxed); };
+	};
+	const std::string request(24, 'q');
+	auto requestSized = [&request](size_t i) {
+		return [text = std::string_view(request), i, handle = uint64_t{ 7 }, sequence = i, at = Clock::time_point{},
+				pad = std::array<char, 24>{}] {
+			g_sink.fetch_add(text.size() + i + handle + sequence + pad.size(), std::memory_order_relaxed);
+		};
+	};
+
+	std::cout << "tasks=" << count << " workers=" << workers << " bulkSize=" << bulkSize << std::endl
+			  << std::left << std::setw(34) << "path" << std::right
+			  << std::setw(12) << "ns/task"
+			  << std::setw(16) << "allocs/task" << std::endl;
+
+	printRow("std::function small", wrapAndRun<std::function<void()>>(count, small));
+	printRow("Task small", wrapAndRun<Task>(count, small));
+	printRow("std::function request-sized", wrapAndRun<std::function<void()>>(count, requestSized));
+	printRow("Task request-sized", wrapAndRun<Task>(count, requestSized));
+
+	{
+		ThreadPool pool(workers);
+		benchmarkPool("ThreadPool", pool, count, bulkSize);
+	}
+	{
+		WorkStealingThreadPool pool(workers);
+		benchmarkPool("WorkStealing", pool, count, bulkSize);
+	}
+
+	return 0;
+}
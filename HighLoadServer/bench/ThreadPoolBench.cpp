@@ -0,0 +1,135 @@
+// Compares ThreadPool and WorkStealingThreadPool on enqueue throughput and on the
+// enqueue-to-start latency distribution of tiny tasks.
+//
+// Usage: ThreadPoolBench [producers] [tasksPerProducer] [workers]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/common/ThreadPool.h"
+#include "../src/common/WorkStealingThreadPool.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+	double enqueueOpsPerSec;
+	double completedPerSec;
+	int64_t p50Ns;
+	int64_t p99Ns;
+	int64_t p999Ns;
+	int64_t maxNs;
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p)
+{
+	const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+	return sorted[index];
+}
+
+Result runBenchmark(Executor& pool, size_t producers, size_t tasksPerProducer)
+{
+	const size_t total = producers * tasksPerProducer;
+	std::vector<int64_t> latencies(total);
+	std::atomic<size_t> completed{0};
+	std::atomic<bool> go{false};
+
+	std::vector<std::thread> threads;
+	threads.reserve(producers);
+	std::vector<Clock::duration> enqueueTimes(producers);
+
+	for (size_t p = 0; p < producers; ++p)
+	{
+		threads.emplace_back([&, p] {
+			while (!go.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+
+			const auto start = Clock::now();
+			for (size_t i = 0; i < tasksPerProducer; ++i)
+			{
+				const size_t slot = p * tasksPerProducer + i;
+				const auto enqueuedAt = Clock::now();
+				pool.enqueue([&latencies, &completed, slot, enqueuedAt] {
+					latencies[slot] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - enqueuedAt).count();
+					completed.fetch_add(1, std::memory_order_release);
+				});
+			}
+			enqueueTimes[p] = Clock::now() - start;
+		});
+	}
+
+	const auto start = Clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& t: threads)
+	{
+		t.join();
+	}
+	while (completed.load(std::memory_order_acquire) < total)
+	{
+		std::this_thread::yield();
+	}
+	const auto elapsed = Clock::now() - start;
+
+	const auto slowestProducer = *std::max_element(enqueueTimes.begin(), enqueueTimes.end());
+	std::sort(latencies.begin(), latencies.end());
+
+	return {
+		static_cast<double>(total) / std::chrono::duration<double>(slowestProducer).count(),
+		static_cast<double>(total) / std::chrono::duration<double>(elapsed).count(),
+		percentile(latencies, 0.50),
+		percentile(latencies, 0.99),
+		percentile(latencies, 0.999),
+		latencies.back(),
+	};
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(0)
+			  << std::setw(14) << r.enqueueOpsPerSec
+			  << std::setw(14) << r.completedPerSec
+			  << std::setw(10) << r.p50Ns
+			  << std::setw(10) << r.p99Ns
+			  << std::setw(10) << r.p999Ns
+			  << std::setw(12) << r.maxNs << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t producers = argc > 1 ? std::stoul(argv[1]) : 4;
+	const size_t tasksPerProducer = argc > 2 ? std::stoul(argv[2]) : 250000;
+	const size_t workers = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+
+	std::cout << "producers=" << producers << " tasks/producer=" << tasksPerProducer
+			  << " workers=" << workers << std::endl
+			  << std::left << std::setw(14) << "pool" << std::right
+			  << std::setw(14) << "enqueue/s"
+			  << std::setw(14) << "done/s"
+			  << std::setw(10) << "p50 ns"
+			  << std::setw(10) << "p99 ns"
+			  << std::setw(10) << "p99.9 ns"
+			  << std::setw(12) << "max ns" << std::endl;
+
+	{
+		ThreadPool pool(workers);
+		printResult("shared", runBenchmark(pool, producers, tasksPerProducer));
+	}
+	{
+		WorkStealingThreadPool pool(workers);
+		printResult("stealing", runBenchmark(pool, producers, tasksPerProducer));
+	}
+
+	return 0;
+}
@@ -0,0 +1,280 @@
+// Compares the transports a caller with single small queries can use against one in-process
+// epoll server answering inline (DispatchPolicy::Inline on TCP, as UdpReactor does):
+//  - tcp: a persistent connection per client, `depth` pipelined queries in flight;
+//  - unix: the same over an AF_UNIX socket, as a client on the same host would use;
+//  - tcp/connect: a new connection for every query, closed after its answer;
+//  - udp: a datagram per query, `depth` in flight per client socket; a datagram lost on the
+//    way is counted once a receive times out, and replaced.
+// Reports requests per second and CPU time per request. Server and clients share the
+// process, so the CPU figure is the cost of both ends of a request.
+//
+// Usage: TransportBench [clients] [depth] [seconds] [reactors] [port]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../src/client/PipelinedConnection.h"
+#include "../src/socket/ServerBackend.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr timeval udpReceiveTimeout{ 0, 200'000 };
+
+struct Result
+{
+	double requestsPerSec;
+	double cpuUsPerRequest;
+	uint64_t lost;
+};
+
+struct Counts
+{
+	uint64_t answered = 0;
+	uint64_t lost = 0;
+};
+
+const std::string query = "bench\n7\n";
+
+double processCpuUs()
+{
+	timespec now{};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec) * 1e6 + static_cast<double>(now.tv_nsec) / 1e3;
+}
+
+// Abstract name, so nothing is left behind; per process, as the port may be picked by the kernel
+std::string unixPath()
+{
+	static const std::string path = "@TransportBench." + std::to_string(getpid());
+	return path;
+}
+
+TcpClient connectTcp(unsigned short port)
+{
+	TcpClient socket;
+	if (!socket.connect("127.0.0.1", port))
+	{
+		throw std::runtime_error("connect failed");
+	}
+	return socket;
+}
+
+TcpClient connectUnix()
+{
+	TcpClient socket(SocketFamily::Unix);
+	if (!socket.connect(unixPath()))
+	{
+		throw std::runtime_error("unix connect failed");
+	}
+	return socket;
+}
+
+Counts drivePipelined(TcpClient socket, size_t depth, Clock::time_point deadline)
+{
+	PipelinedConnection connection(std::move(socket));
+	Counts counts;
+	for (size_t i = 0; i < depth; ++i)
+	{
+		connection.send(query);
+	}
+	while (connection.inFlight() > 0)
+	{
+		if (connection.flush() != PipelinedConnection::Status::Done)
+		{
+			break;
+		}
+		const bool more = Clock::now() < deadline;
+		const auto status = connection.receive([&](std::string_view) {
+			++counts.answered;
+			if (more)
+			{
+				connection.send(query);
+			}
+		});
+		if (status != PipelinedConnection::Status::Done)
+		{
+			break;
+		}
+	}
+	return counts;
+}
+
+Counts driveTcp(unsigned short port, size_t depth, Clock::time_point deadline)
+{
+	return drivePipelined(connectTcp(port), depth, deadline);
+}
+
+Counts driveUnix(unsigned short, size_t depth, Clock::time_point deadline)
+{
+	return drivePipelined(connectUnix(), depth, deadline);
+}
+
+Counts driveTcpConnect(unsigned short port, size_t, Clock::time_point deadline)
+{
+	const std::vector<std::string> queries{ query };
+	Counts counts;
+	while (Clock::now() < deadline)
+	{
+		PipelinedConnection connection(connectTcp(port));
+		if (!connection.exchange(queries, 1, [&](size_t, std::string_view) { ++counts.answered; }))
+		{
+			++counts.lost;
+		}
+	}
+	return counts;
+}
+
+Counts driveUdp(unsigned short port, size_t depth, Clock::time_point deadline)
+{
+	const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	sockaddr_in server{};
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd == -1 || connect(fd, reinterpret_cast<sockaddr*>(&server), sizeof(server)) == -1)
+	{
+		throw std::runtime_error("UDP connect failed");
+	}
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &udpReceiveTimeout, sizeof(udpReceiveTimeout));
+
+	Counts counts;
+	size_t inFlight = 0;
+	auto sendQueries = [&](size_t count) {
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (send(fd, query.data(), query.size(), 0) == static_cast<ssize_t>(query.size()))
+			{
+				++inFlight;
+			}
+		}
+	};
+
+	char buffer[512];
+	sendQueries(depth);
+	while (inFlight > 0)
+	{
+		const ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+		const bool more = Clock::now() < deadline;
+		if (bytes > 0)
+		{
+			--inFlight;
+			++counts.answered;
+			if (more)
+			{
+				sendQueries(1);
+			}
+			continue;
+		}
+
+		// Whatever has not come back by now is not coming
+		counts.lost += inFlight;
+		inFlight = 0;
+		if (more)
+		{
+			sendQueries(depth);
+		}
+	}
+
+	close(fd);
+	return counts;
+}
+
+using Driver = std::function<Counts(unsigned short, size_t, Clock::time_point)>;
+
+Result runClients(const Driver& drive, unsigned short port, size_t clients, size_t depth, int seconds)
+{
+	std::vector<Counts> perClient(clients);
+	std::vector<std::thread> threads;
+	threads.reserve(clients);
+
+	const double cpuBefore = processCpuUs();
+	const auto start = Clock::now();
+	const auto deadline = start + std::chrono::seconds(seconds);
+	for (size_t i = 0; i < clients; ++i)
+	{
+		threads.emplace_back([&, i] { perClient[i] = drive(port, depth, deadline); });
+	}
+	for (auto& thread: threads)
+	{
+		thread.join();
+	}
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	const double cpu = processCpuUs() - cpuBefore;
+
+	Counts total;
+	for (const Counts& counts: perClient)
+	{
+		total.answered += counts.answered;
+		total.lost += counts.lost;
+	}
+	if (total.answered == 0)
+	{
+		return {};
+	}
+	return { static_cast<double>(total.answered) / elapsed, cpu / static_cast<double>(total.answered), total.lost };
+}
+
+void printResult(const std::string& name, const Result& r)
+{
+	std::cout << std::left << std::setw(14) << name << std::right << std::fixed
+			  << std::setw(14) << std::setprecision(0) << r.requestsPerSec
+			  << std::setw(14) << std::setprecision(2) << r.cpuUsPerRequest
+			  << std::setw(10) << r.lost << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const size_t clients = argc > 1 ? std::stoul(argv[1]) : 8;
+	const size_t depth = argc > 2 ? std::stoul(argv[2]) : 1;
+	const int seconds = argc > 3 ? std::stoi(argv[3]) : 3;
+	const size_t reactors = argc > 4 ? std::stoul(argv[4]) : 1;
+	auto port = static_cast<unsigned short>(argc > 5 ? std::stoi(argv[5]) : 5700);
+
+	ServerConfig config;
+	config.reactorCount = reactors;
+	config.udp = true;
+	config.unixPath = unixPath();
+	auto backend = makeServerBackend(port, config);
+	backend->setMessageHandler([](std::string_view, WireProtocol, std::string& response) {
+		response = "server\n50\n";
+	}, DispatchPolicy::Inline);
+	std::thread serverThread([&backend] { backend->run(); });
+	// Port 0 leaves the choice to the kernel
+	port = backend->getLocalPort();
+
+	const Result tcp = runClients(driveTcp, port, clients, depth, seconds);
+	const Result local = runClients(driveUnix, port, clients, depth, seconds);
+	const Result tcpConnect = runClients(driveTcpConnect, port, clients, depth, seconds);
+	const Result udp = runClients(driveUdp, port, clients, depth, seconds);
+
+	backend->shutdown();
+	serverThread.join();
+
+	std::cout << std::endl << "clients=" << clients << " depth=" << depth
+			  << " seconds=" << seconds << " reactors=" << reactors << std::endl
+			  << std::left << std::setw(14) << "transport" << std::right
+			  << std::setw(14) << "requests/s"
+			  << std::setw(14) << "CPU us/req"
+			  << std::setw(10) << "lost" << std::endl;
+	printResult("tcp", tcp);
+	printResult("unix", local);
+	printResult("tcp/connect", tcpConnect);
+	printResult("udp", udp);
+
+	return 0;
+}
@@ -1,72 +1,77 @@
 #include <iostream>
+#include <sstream>
+#include <vector>
 #include "Client.h"
-#include "thread"
 
-#include "../common/constructQuery.h"
-#include "../common/parseQuery.h"
+#include "../common/Logger.h"
 #include "../common/printInfo.h"
 
-Client::Client(std::string address, u_short port, std::string name)
-	: m_address(std::move(address)),
-	  m_port(port),
-	  m_name("Client of " + std::move(name))
+Client::Client(std::string address, u_short port, std::string name, WireProtocol protocol, size_t window)
+	: m_name("Client of " + std::move(name)),
+	  m_protocol(protocol),
+	  m_window(window),
+	  m_pool(std::move(address), port, 1)
 {
 }
 
-void Client::run() const
+void Client::run()
 {
-	using namespace std::chrono_literals;
-	int number;
-	std::osyncstream(std::cout) << "Enter number: ";
-	std::cin >> number;
-	std::osyncstream(std::cout) << std::endl;
-
-	if (!m_tcp.connect("127.0.0.1", m_port))
+	std::string line;
+	while (true)
 	{
-		throw std::runtime_error("Failed to connect to 127.0.0.1:" + std::to_string(m_port));
-	}
+		// The prompt goes straight to the terminal, after whatever is still queued in the logger
+		Logger::instance().flush();
+		std::cout << "Enter numbers: " << std::flush;
+		if (!std::getline(std::cin, line) || line.empty())
+		{
+			return;
+		}
+		std::cout << std::endl;
 
-	auto message = constructQuery({m_name, number});
-	m_tcp.sendString(message);
-	auto response = m_tcp.receiveString();
-	if (response.empty())
-	{
-		std::osyncstream(std::cout) << "Server closed connection" << std::endl;
-		return;
+		std::vector<int> numbers;
+		std::istringstream input(line);
+		for (int number; input >> number;)
+		{
+			numbers.push_back(number);
+		}
+		if (!input.eof())
+		{
+			LOG_WARN("Not a number in '{}'", line);
+			continue;
+		}
+
+		std::vector<std::string> queries(numbers.size());
+		for (size_t i = 0; i < numbers.size(); ++i)
+		{
+			appendQueryFrame(m_protocol, queries[i], m_name, numbers[i]);
+		}
+
+		auto connection = m_pool.acquire();
+		const bool answered = connection->exchange(queries, m_window, [&](size_t index, std::string_view frame) {
+			printResponse(numbers[index], frame);
+		});
+		if (!answered)
+		{
+			LOG_INFO("Server closed connection");
+			return;
+		}
 	}
-	auto [serverName, serverNumber] = parseQuery(response);
-	printInfo(
-		m_name,
-		serverName,
-		number,
-		serverNumber
-	);
 }
 
-void Client::run(int number, int sleepSec = -1) const
+void Client::printResponse(int number, std::string_view frame) const
 {
-	if (sleepSec == -1)
-	{
-		run();
-		return;
-	}
-	using namespace std::chrono_literals;
-	if (!m_tcp.connect("127.0.0.1", m_port))
+	// The server answers in the protocol of the request
+	const auto response = parseQueryFrame(m_protocol, frame);
+	if (!response)
 	{
-		throw std::runtime_error("Failed to connect to 127.0.0.1:" + std::to_string(m_port));
+		throw std::invalid_argument("Invalid response from server");
 	}
-
-	std::this_thread::sleep_for(std::chrono::seconds(sleepSec));
-
-	auto message = constructQuery({m_name, number});
-	m_tcp.sendString(message);
-	auto response = m_tcp.receiveString();
-	if (response.empty())
+	auto [serverName, serverNumber] = *response;
+	if (serverNumber == busyNumber)
 	{
-		std::osyncstream(std::cout) << "Server closed connection" << std::endl;
+		LOG_WARN("Server is overloaded, the query for {} was not handled", number);
 		return;
 	}
-	auto [serverName, serverNumber] = parseQuery(response);
 	printInfo(
 		m_name,
 		serverName,
@@ -1,19 +1,28 @@
 #pragma once
 
-#include "string"
-#include "../socket/TcpClient.h"
+#include <string>
+#include <string_view>
+#include "ConnectionPool.h"
+#include "../common/WireProtocol.h"
 
 class Client
 {
 public:
-	Client(std::string address, u_short port, std::string name);
+	// Queries sent ahead of their answers on the connection
+	static constexpr size_t defaultWindow = 16;
 
-	void run() const;
-	void run(int number, int sleepMs) const;
+	Client(std::string address, u_short port, std::string name, WireProtocol protocol = WireProtocol::Text,
+		size_t window = defaultWindow);
+
+	// Reads lines of numbers until an empty line or end of input; the numbers of a line are
+	// pipelined over one pooled connection, which the next line reuses
+	void run();
 
 private:
-	std::string m_address;
-	u_short m_port;
+	void printResponse(int number, std::string_view frame) const;
+
 	std::string m_name;
-	TcpClient m_tcp;
+	WireProtocol m_protocol;
+	size_t m_window;
+	ConnectionPool m_pool;
 };
@@ -0,0 +1,62 @@
+#include "ConnectionPool.h"
+
+#include <stdexcept>
+#include "../common/Logger.h"
+
+ConnectionPool::Lease::~Lease()
+{
+	if (m_connection)
+	{
+		m_pool->release(std::move(m_connection));
+	}
+}
+
+ConnectionPool::ConnectionPool(std::string address, u_short port, size_t maxIdle)
+	: m_address(std::move(address)), m_port(port), m_maxIdle(maxIdle)
+{
+}
+
+ConnectionPool::Lease ConnectionPool::acquire()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		while (!m_idle.empty())
+		{
+			auto connection = std::move(m_idle.back());
+			m_idle.pop_back();
+			if (!connection->isStale())
+			{
+				return Lease(*this, std::move(connection));
+			}
+			LOG_DEBUG("Dropping idle connection {} closed by the server", connection->getHandle());
+		}
+	}
+
+	const bool local = isUnixSocketPath(m_address);
+	TcpClient socket(local ? SocketFamily::Unix : SocketFamily::Inet);
+	if (local ? !socket.connect(m_address) : !socket.connect(m_address, m_port))
+	{
+		throw std::runtime_error("Failed to connect to " + (local ? m_address : m_address + ":" + std::to_string(m_port)));
+	}
+	return Lease(*this, std::make_unique<PipelinedConnection>(std::move(socket)));
+}
+
+void ConnectionPool::release(std::unique_ptr<PipelinedConnection> connection)
+{
+	// A connection with answers still on their way would hand them to the next user
+	if (!connection->isOpen() || connection->inFlight() != 0)
+	{
+		return;
+	}
+	std::lock_guard lock(m_mutex);
+	if (m_idle.size() < m_maxIdle)
+	{
+		m_idle.push_back(std::move(connection));
+	}
+}
+
+size_t ConnectionPool::idleCount() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_idle.size();
+}
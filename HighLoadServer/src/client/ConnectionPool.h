@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "PipelinedConnection.h"
+
+// Keeps connections to one server open between requests. acquire() hands out an idle one
+// when there is one and connects a new one otherwise; the lease puts it back when it goes
+// out of scope, unless it broke or still has answers outstanding. Thread-safe. An address
+// that is a unix socket path (see isUnixSocketPath) is connected to over AF_UNIX, port unused.
+class ConnectionPool
+{
+public:
+	static constexpr size_t defaultMaxIdle = 8;
+
+	class Lease
+	{
+	public:
+		Lease(Lease&& other) noexcept = default;
+		Lease& operator=(Lease&& other) = delete;
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		~Lease();
+
+		PipelinedConnection& operator*() const { return *m_connection; }
+		PipelinedConnection* operator->() const { return m_connection.get(); }
+
+	private:
+		friend class ConnectionPool;
+
+		Lease(ConnectionPool& pool, std::unique_ptr<PipelinedConnection> connection)
+			: m_pool(&pool), m_connection(std::move(connection))
+		{
+		}
+
+		ConnectionPool* m_pool;
+		std::unique_ptr<PipelinedConnection> m_connection;
+	};
+
+	ConnectionPool(std::string address, u_short port, size_t maxIdle = defaultMaxIdle);
+
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+	// Throws std::runtime_error when a new connection cannot be established
+	Lease acquire();
+
+	[[nodiscard]] size_t idleCount() const;
+
+private:
+	void release(std::unique_ptr<PipelinedConnection> connection);
+
+	const std::string m_address;
+	const u_short m_port;
+	const size_t m_maxIdle;
+
+	mutable std::mutex m_mutex;
+	std::vector<std::unique_ptr<PipelinedConnection>> m_idle;
+};
@@ -0,0 +1,521 @@
+#include "LoadGenerator.h"
+#include <algorithm>
+#include <barrier>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "PipelinedConnection.h"
+#include "../common/Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t maxDefaultThreads = 4;
+constexpr int maxEvents = 1024;
+constexpr std::chrono::seconds connectTimeout{ 30 };
+constexpr std::chrono::milliseconds connectRetryDelay{ 1 };
+// How long answers to the last requests are awaited after the sending window closes
+constexpr std::chrono::seconds drainTimeout{ 5 };
+
+namespace
+{
+// Where the connections go: an IPv4 address and port, or a unix socket
+struct ServerAddress
+{
+	sockaddr_storage storage{};
+	socklen_t length = 0;
+
+	int family() const { return storage.ss_family; }
+	const sockaddr* get() const { return reinterpret_cast<const sockaddr*>(&storage); }
+};
+
+void raiseFileLimit(size_t needed)
+{
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed)
+	{
+		LOG_WARN("Open file limit is {}, fewer than the {} connections requested", limit.rlim_cur, needed);
+	}
+}
+
+timespec toTimespec(Clock::duration duration)
+{
+	const auto ns = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	return { static_cast<time_t>(ns / 1'000'000'000), static_cast<long>(ns % 1'000'000'000) };
+}
+} // namespace
+
+// One event loop and its share of the connections, each a non-blocking PipelinedConnection.
+// Responses come back in request order, so the due times of a connection's requests are
+// kept in a FIFO.
+class LoadGenerator::Worker
+{
+public:
+	Worker(const LoadConfig& config, size_t firstConnection, size_t connectionCount, Histogram& latency)
+		: m_latency(latency)
+		, m_protocol(config.protocol)
+		, m_connections(connectionCount)
+	{
+		m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epollFd == -1)
+		{
+			throw std::runtime_error("epoll_create1 failed: " + std::string(strerror(errno)));
+		}
+
+		std::mt19937 gen(std::random_device{}());
+		std::uniform_int_distribution<> numDist(0, 100);
+		for (size_t i = 0; i < connectionCount; ++i)
+		{
+			appendQueryFrame(m_protocol, m_connections[i].query, config.name + "_" + std::to_string(firstConnection + i), numDist(gen));
+		}
+	}
+
+	~Worker()
+	{
+		::close(m_epollFd);
+	}
+
+	Worker(const Worker&) = delete;
+	Worker& operator=(const Worker&) = delete;
+
+	// Returns once every connection has been established or has failed
+	void connectAll(const ServerAddress& server);
+	// Open loop: requestsPerSec spread evenly, the first one due at start + offset.
+	// Closed loop (requestsPerSec == 0): `concurrency` requests kept in flight.
+	void run(Clock::time_point start, Clock::time_point end, double requestsPerSec, Clock::duration offset, size_t concurrency);
+
+	size_t connected = 0;
+	size_t connectFailures = 0;
+	size_t dropped = 0;
+	uint64_t sent = 0;
+	uint64_t answered = 0;
+	Clock::time_point lastAnswerAt{};
+
+private:
+	struct Connection
+	{
+		std::optional<PipelinedConnection> link;
+		bool alive = false;
+		bool writeArmed = false;
+		bool dirty = false;
+		std::string query;
+		std::deque<Clock::time_point> dueTimes;
+	};
+
+	size_t nextLiveConnection();
+	void issue(size_t index, Clock::time_point due);
+	void flushDirty();
+	void flush(size_t index);
+	void readResponses(size_t index, bool closedLoop, Clock::time_point end);
+	void setInterest(size_t index, uint32_t events, int operation = EPOLL_CTL_MOD);
+	void drop(size_t index);
+
+	Histogram& m_latency;
+	WireProtocol m_protocol;
+	int m_epollFd = -1;
+	std::vector<Connection> m_connections;
+	std::vector<size_t> m_dirty;
+	size_t m_roundRobin = 0;
+	size_t m_alive = 0;
+	uint64_t m_inFlight = 0;
+};
+
+void LoadGenerator::Worker::connectAll(const ServerAddress& server)
+{
+	const auto deadline = Clock::now() + connectTimeout;
+	size_t pending = 0;
+	for (size_t i = 0; i < m_connections.size(); ++i)
+	{
+		Connection& connection = m_connections[i];
+		const int fd = socket(server.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd == -1)
+		{
+			++connectFailures;
+			continue;
+		}
+
+		connection.link.emplace(TcpClient(fd));
+		int result = ::connect(fd, server.get(), server.length);
+		// A unix socket with a full backlog refuses at once instead of retrying like TCP
+		// does, so give the server a moment to accept
+		while (result == -1 && errno == EAGAIN && Clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(connectRetryDelay);
+			result = ::connect(fd, server.get(), server.length);
+		}
+		if (result == -1 && errno != EINPROGRESS)
+		{
+			connection.link.reset();
+			++connectFailures;
+			continue;
+		}
+
+		setInterest(i, EPOLLOUT, EPOLL_CTL_ADD);
+		++pending;
+	}
+
+	std::vector<epoll_event> events(maxEvents);
+	while (pending > 0 && Clock::now() < deadline)
+	{
+		const int count = epoll_wait(m_epollFd, events.data(), maxEvents, 100);
+		for (int e = 0; e < count; ++e)
+		{
+			const size_t index = events[e].data.u64;
+			Connection& connection = m_connections[index];
+			int error = 0;
+			socklen_t length = sizeof(error);
+			getsockopt(connection.link->getHandle(), SOL_SOCKET, SO_ERROR, &error, &length);
+			--pending;
+
+			if (error != 0)
+			{
+				connection.link.reset();
+				++connectFailures;
+				continue;
+			}
+
+			connection.alive = true;
+			setInterest(index, EPOLLIN | EPOLLRDHUP);
+			++connected;
+		}
+	}
+
+	// Whatever is still connecting at the deadline counts as failed
+	for (auto& connection: m_connections)
+	{
+		if (connection.link && !connection.alive)
+		{
+			connection.link.reset();
+			++connectFailures;
+		}
+	}
+	m_alive = connected;
+}
+
+void LoadGenerator::Worker::run(Clock::time_point start, Clock::time_point end, double requestsPerSec, Clock::duration offset, size_t concurrency)
+{
+	const bool closedLoop = requestsPerSec <= 0;
+	const auto drainDeadline = end + drainTimeout;
+	std::vector<epoll_event> events(maxEvents);
+
+	// Due times are computed from the request number rather than accumulated, so they do not drift
+	uint64_t scheduled = 0;
+	auto dueTime = [&](uint64_t n) {
+		return start + offset + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(n) / requestsPerSec));
+	};
+
+	if (closedLoop)
+	{
+		for (size_t i = 0; i < concurrency && m_alive > 0; ++i)
+		{
+			issue(nextLiveConnection(), start);
+		}
+	}
+
+	while (true)
+	{
+		auto now = Clock::now();
+		if (!closedLoop)
+		{
+			// A late wakeup sends everything that has fallen due, each with its own due time
+			for (auto due = dueTime(scheduled); due <= now && due < end && m_alive > 0; due = dueTime(++scheduled))
+			{
+				issue(nextLiveConnection(), due);
+			}
+		}
+		flushDirty();
+
+		if (m_alive == 0 || now >= drainDeadline || (now >= end && m_inFlight == 0))
+		{
+			break;
+		}
+
+		Clock::time_point wakeAt = now < end ? end : drainDeadline;
+		if (!closedLoop && now < end)
+		{
+			wakeAt = std::min(wakeAt, dueTime(scheduled));
+		}
+		const timespec timeout = toTimespec(wakeAt - now);
+
+		const int count = epoll_pwait2(m_epollFd, events.data(), maxEvents, &timeout, nullptr);
+		if (count == -1 && errno != EINTR)
+		{
+			LOG_ERROR("epoll_pwait2 failed: {}", strerror(errno));
+			break;
+		}
+
+		for (int e = 0; e < count; ++e)
+		{
+			const size_t index = events[e].data.u64;
+			if (!m_connections[index].alive)
+			{
+				continue;
+			}
+			if (events[e].events & EPOLLOUT)
+			{
+				flush(index);
+			}
+			if (m_connections[index].alive && (events[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+			{
+				readResponses(index, closedLoop, end);
+			}
+		}
+	}
+}
+
+size_t LoadGenerator::Worker::nextLiveConnection()
+{
+	// Only called while m_alive > 0
+	while (true)
+	{
+		const size_t index = m_roundRobin;
+		m_roundRobin = (m_roundRobin + 1) % m_connections.size();
+		if (m_connections[index].alive)
+		{
+			return index;
+		}
+	}
+}
+
+void LoadGenerator::Worker::issue(size_t index, Clock::time_point due)
+{
+	Connection& connection = m_connections[index];
+	connection.link->send(connection.query);
+	connection.dueTimes.push_back(due);
+	++sent;
+	++m_inFlight;
+
+	if (!connection.dirty)
+	{
+		connection.dirty = true;
+		m_dirty.push_back(index);
+	}
+}
+
+void LoadGenerator::Worker::flushDirty()
+{
+	for (size_t index: m_dirty)
+	{
+		m_connections[index].dirty = false;
+		if (m_connections[index].alive)
+		{
+			flush(index);
+		}
+	}
+	m_dirty.clear();
+}
+
+void LoadGenerator::Worker::flush(size_t index)
+{
+	Connection& connection = m_connections[index];
+	const auto status = connection.link->flush();
+	if (status == PipelinedConnection::Status::Closed)
+	{
+		drop(index);
+		return;
+	}
+
+	const bool blocked = status == PipelinedConnection::Status::WouldBlock;
+	if (blocked != connection.writeArmed)
+	{
+		connection.writeArmed = blocked;
+		setInterest(index, blocked ? EPOLLIN | EPOLLRDHUP | EPOLLOUT : EPOLLIN | EPOLLRDHUP);
+	}
+}
+
+void LoadGenerator::Worker::readResponses(size_t index, bool closedLoop, Clock::time_point end)
+{
+	Connection& connection = m_connections[index];
+	while (true)
+	{
+		const auto now = Clock::now();
+		const auto status = connection.link->receive([&](std::string_view) {
+			if (connection.dueTimes.empty())
+			{
+				return;
+			}
+			m_latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - connection.dueTimes.front()).count()));
+			connection.dueTimes.pop_front();
+			--m_inFlight;
+			++answered;
+			lastAnswerAt = now;
+
+			if (closedLoop && now < end)
+			{
+				issue(index, now);
+			}
+		});
+		if (status == PipelinedConnection::Status::WouldBlock)
+		{
+			return;
+		}
+		if (status == PipelinedConnection::Status::Closed)
+		{
+			drop(index);
+			return;
+		}
+	}
+}
+
+void LoadGenerator::Worker::setInterest(size_t index, uint32_t events, int operation)
+{
+	epoll_event event{};
+	event.events = events;
+	event.data.u64 = index;
+	epoll_ctl(m_epollFd, operation, m_connections[index].link->getHandle(), &event);
+}
+
+void LoadGenerator::Worker::drop(size_t index)
+{
+	// The server rejected a request or went away: whatever was in flight stays unanswered
+	Connection& connection = m_connections[index];
+	m_inFlight -= connection.dueTimes.size();
+	connection.dueTimes.clear();
+	connection.alive = false;
+	connection.link.reset();
+	--m_alive;
+	++dropped;
+}
+
+LoadGenerator::LoadGenerator(LoadConfig config)
+	: m_config(std::move(config))
+{
+}
+
+LoadReport LoadGenerator::run()
+{
+	ServerAddress server;
+	if (isUnixSocketPath(m_config.address))
+	{
+		server.length = makeUnixAddress(m_config.address, reinterpret_cast<sockaddr_un&>(server.storage));
+		if (server.length == 0)
+		{
+			throw std::runtime_error("Invalid unix socket path: " + m_config.address);
+		}
+	}
+	else
+	{
+		auto& inet = reinterpret_cast<sockaddr_in&>(server.storage);
+		inet.sin_family = AF_INET;
+		inet.sin_port = htons(m_config.port);
+		if (inet_pton(AF_INET, m_config.address.c_str(), &inet.sin_addr) != 1)
+		{
+			throw std::runtime_error("Invalid IPv4 address: " + m_config.address);
+		}
+		server.length = sizeof(inet);
+	}
+
+	raiseFileLimit(m_config.connections + 64);
+
+	size_t threadCount = m_config.threads;
+	if (threadCount == 0)
+	{
+		threadCount = std::min<size_t>(maxDefaultThreads, std::max(1u, std::thread::hardware_concurrency()));
+	}
+	threadCount = std::clamp<size_t>(threadCount, 1, m_config.connections);
+
+	Histogram latency;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<size_t> concurrency(threadCount);
+	const size_t totalConcurrency = m_config.concurrency != 0 ? m_config.concurrency : m_config.connections;
+	for (size_t i = 0, first = 0; i < threadCount; ++i)
+	{
+		const size_t count = m_config.connections / threadCount + (i < m_config.connections % threadCount ? 1 : 0);
+		workers.push_back(std::make_unique<Worker>(m_config, first, count, latency));
+		concurrency[i] = totalConcurrency / threadCount + (i < totalConcurrency % threadCount ? 1 : 0);
+		first += count;
+	}
+
+	Clock::time_point start;
+	Clock::time_point end;
+	// Measurement starts only when every thread has its connections up
+	std::barrier connectedBarrier(static_cast<std::ptrdiff_t>(threadCount), [&]() noexcept {
+		start = Clock::now();
+		end = start + m_config.duration;
+		LOG_INFO("Connections ready, running for {}s", m_config.duration.count());
+	});
+
+	{
+		std::vector<std::jthread> threads;
+		threads.reserve(threadCount);
+		for (size_t i = 0; i < threadCount; ++i)
+		{
+			threads.emplace_back([&, i]() {
+				Worker& worker = *workers[i];
+				worker.connectAll(server);
+				connectedBarrier.arrive_and_wait();
+
+				// Each thread sends its share of the rate; the staggered offsets interleave their
+				// requests so that together they arrive evenly spaced
+				const double threadRate = m_config.rate > 0 ? m_config.rate / static_cast<double>(threadCount) : 0;
+				const auto offset = m_config.rate > 0
+					? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(i) / m_config.rate))
+					: Clock::duration::zero();
+				worker.run(start, end, threadRate, offset, concurrency[i]);
+			});
+		}
+	}
+
+	LoadReport report;
+	Clock::time_point lastAnswerAt = start;
+	for (const auto& worker: workers)
+	{
+		report.connected += worker->connected;
+		report.connectFailures += worker->connectFailures;
+		report.dropped += worker->dropped;
+		report.sent += worker->sent;
+		report.answered += worker->answered;
+		lastAnswerAt = std::max(lastAnswerAt, worker->lastAnswerAt);
+	}
+	report.elapsedSeconds = std::chrono::duration<double>(lastAnswerAt - start).count();
+	report.latency = latency.snapshot();
+	return report;
+}
+
+void LoadGenerator::printReport(const LoadConfig& config, const LoadReport& report)
+{
+	const auto toUs = [](uint64_t ns) { return ns / 1000; };
+	const auto throughput = report.elapsedSeconds > 0
+		? static_cast<uint64_t>(static_cast<double>(report.answered) / report.elapsedSeconds)
+		: 0;
+
+	// The results of the run, so on stdout whatever the log level
+	const char* protocol = config.protocol == WireProtocol::Binary ? "binary" : "text";
+	if (config.rate > 0)
+	{
+		std::cout << "Mode: open loop, target " << static_cast<uint64_t>(config.rate) << " req/s, " << protocol << " protocol" << std::endl;
+	}
+	else
+	{
+		std::cout << "Mode: closed loop, " << (config.concurrency != 0 ? config.concurrency : config.connections)
+				  << " request(s) in flight, " << protocol << " protocol" << std::endl;
+	}
+
+	std::cout << "Connections: " << report.connected << " connected, " << report.connectFailures << " failed, "
+			  << report.dropped << " dropped by the server" << std::endl
+			  << "Requests: " << report.sent << " sent, " << report.answered << " answered, "
+			  << report.sent - report.answered << " unanswered" << std::endl
+			  << "Throughput: " << throughput << " req/s over " << static_cast<uint64_t>(report.elapsedSeconds * 1000) << " ms" << std::endl
+			  << "Latency (us, from due time): p50 " << toUs(report.latency.percentile(0.50))
+			  << " p99 " << toUs(report.latency.percentile(0.99))
+			  << " p99.9 " << toUs(report.latency.percentile(0.999))
+			  << " max " << toUs(report.latency.max) << std::endl;
+}
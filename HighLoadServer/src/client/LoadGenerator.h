@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "../common/Metrics.h"
+#include "../common/WireProtocol.h"
+
+struct LoadConfig
+{
+	// IPv4 address, or a unix socket path (see isUnixSocketPath), for which port is unused
+	std::string address = "127.0.0.1";
+	unsigned short port = 0;
+	std::string name;
+	size_t connections = 1;
+	// Event-loop threads sharing the connections; 0 = up to four, one per core
+	size_t threads = 0;
+	// Requests per second across all connections (open loop); 0 selects closed loop
+	double rate = 0;
+	// Closed loop: requests kept in flight across all connections; 0 = one per connection
+	size_t concurrency = 0;
+	std::chrono::seconds duration{ 10 };
+	WireProtocol protocol = WireProtocol::Text;
+};
+
+struct LoadReport
+{
+	size_t connected = 0;
+	size_t connectFailures = 0;
+	// Connections the server closed or reset during the run
+	size_t dropped = 0;
+	uint64_t sent = 0;
+	uint64_t answered = 0;
+	double elapsedSeconds = 0;
+	// Nanoseconds from the moment each answered request was due to the moment its response arrived
+	HistogramSnapshot latency;
+};
+
+// Drives the server from a few epoll threads, each owning a share of the connections, and
+// works in one of two modes:
+//  - open loop: requests are due at fixed intervals whatever the server does, and a request
+//    that goes out late still counts its latency from when it was due, so a stalled server
+//    shows up as latency instead of as a lower send rate (no coordinated omission);
+//  - closed loop: every answer immediately triggers the next request on its connection.
+// All connections are established before the measurement starts.
+class LoadGenerator
+{
+public:
+	explicit LoadGenerator(LoadConfig config);
+
+	LoadReport run();
+
+	// Writes the report to stdout, independent of the log level
+	static void printReport(const LoadConfig& config, const LoadReport& report);
+
+private:
+	class Worker;
+
+	LoadConfig m_config;
+};
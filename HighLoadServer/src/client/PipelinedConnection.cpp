@@ -0,0 +1,111 @@
+#include "PipelinedConnection.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// Per read: room for a few thousand small responses
+constexpr size_t readChunkSize = 64 * 1024;
+
+PipelinedConnection::PipelinedConnection(TcpClient socket)
+	: m_socket(std::move(socket))
+{
+	// A window goes out in one write; Nagle would only hold the next one back
+	const int one = 1;
+	setsockopt(m_socket.getHandle(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void PipelinedConnection::send(std::string_view query)
+{
+	m_outbound += query;
+	++m_inFlight;
+}
+
+PipelinedConnection::Status PipelinedConnection::flush()
+{
+	while (m_outboundOffset < m_outbound.size())
+	{
+		const iovec buffer{ m_outbound.data() + m_outboundOffset, m_outbound.size() - m_outboundOffset };
+		const ssize_t written = m_socket.sendSome(&buffer, 1);
+		if (written == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			return Status::WouldBlock;
+		}
+		if (written == -1)
+		{
+			m_open = false;
+			return Status::Closed;
+		}
+		m_outboundOffset += static_cast<size_t>(written);
+	}
+
+	m_outbound.clear();
+	m_outboundOffset = 0;
+	return Status::Done;
+}
+
+PipelinedConnection::Status PipelinedConnection::fill()
+{
+	const auto space = m_decoder.prepareWrite(readChunkSize);
+	ssize_t bytes;
+	do
+	{
+		bytes = m_socket.receiveSome(space.data(), space.size());
+	} while (bytes == -1 && errno == EINTR);
+
+	if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		return Status::WouldBlock;
+	}
+	if (bytes <= 0)
+	{
+		m_open = false;
+		return Status::Closed;
+	}
+	m_decoder.commitWrite(static_cast<size_t>(bytes));
+	return Status::Done;
+}
+
+bool PipelinedConnection::exchange(std::span<const std::string> queries, size_t window,
+	const std::function<void(size_t, std::string_view)>& onResponse)
+{
+	window = std::max<size_t>(window, 1);
+	size_t next = 0;
+	size_t answered = 0;
+	while (answered < queries.size())
+	{
+		// Tops the window up; the new queries leave together in one write
+		while (next < queries.size() && m_inFlight < window)
+		{
+			send(queries[next++]);
+		}
+		if (flush() != Status::Done)
+		{
+			return false;
+		}
+		if (receive([&](std::string_view frame) { onResponse(answered++, frame); }) != Status::Done)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PipelinedConnection::isStale() const
+{
+	if (!m_open)
+	{
+		return true;
+	}
+	// Nothing may arrive on an idle connection: end of stream, an error or stray bytes all
+	// mean it cannot be reused
+	char byte;
+	const ssize_t bytes = ::recv(m_socket.getHandle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	return !(bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "../common/QueryDecoder.h"
+#include "../socket/TcpClient.h"
+
+// Connection to the server that stays open across requests and pipelines them: queries go
+// out back to back without waiting for answers, and since the server answers a connection
+// in request order, the n-th response belongs to the n-th query. The socket may be blocking
+// (Client, through ConnectionPool) or non-blocking (LoadGenerator, which calls flush() and
+// receive() when epoll reports the socket ready).
+class PipelinedConnection
+{
+public:
+	enum class Status
+	{
+		Done,
+		// Non-blocking socket only: call again once epoll reports it ready
+		WouldBlock,
+		// The server closed the connection or it failed; queries in flight stay unanswered
+		Closed
+	};
+
+	explicit PipelinedConnection(TcpClient socket);
+
+	// Queues a query frame; it goes out with the next flush()
+	void send(std::string_view query);
+	// Writes everything queued, in as few writes as the socket allows
+	Status flush();
+
+	// One read; onResponse(frame) is called for each response it completes, oldest query
+	// first. The frame is valid during the call only.
+	template <typename OnResponse>
+	Status receive(OnResponse&& onResponse)
+	{
+		const Status status = fill();
+		if (status != Status::Done)
+		{
+			return status;
+		}
+		while (auto frame = m_decoder.next())
+		{
+			if (m_inFlight > 0)
+			{
+				--m_inFlight;
+			}
+			onResponse(*frame);
+		}
+		if (m_decoder.isMalformed() || m_decoder.isOverflowed())
+		{
+			m_open = false;
+			return Status::Closed;
+		}
+		return Status::Done;
+	}
+
+	// Blocking socket only: sends queries keeping at most window of them unanswered and calls
+	// onResponse(index, frame) for each answer in order. False when the connection broke first.
+	bool exchange(std::span<const std::string> queries, size_t window,
+		const std::function<void(size_t, std::string_view)>& onResponse);
+
+	// An idle connection the server has closed meanwhile, say on its idle timeout
+	[[nodiscard]] bool isStale() const;
+
+	// Queries sent or queued and not answered yet
+	[[nodiscard]] size_t inFlight() const { return m_inFlight; }
+	[[nodiscard]] bool isOpen() const { return m_open; }
+	[[nodiscard]] int getHandle() const { return m_socket.getHandle(); }
+
+private:
+	Status fill();
+
+	TcpClient m_socket;
+	std::string m_outbound;
+	size_t m_outboundOffset = 0;
+	QueryDecoder m_decoder;
+	size_t m_inFlight = 0;
+	bool m_open = true;
+};
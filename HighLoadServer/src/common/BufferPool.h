@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Strings whose contents have been used up, kept with their memory so that the next request
+// copy or response reuses it instead of allocating. One per event loop, touched only by its
+// thread; the buffers themselves may travel to workers and back.
+class BufferPool
+{
+public:
+	// Buffers kept at most, and the largest one kept, so that a burst or one huge response
+	// does not pin memory for good
+	static constexpr size_t maxBuffers = 1024;
+	static constexpr size_t maxCapacity = 64 * 1024;
+
+	// An empty string, with the capacity of a recycled one when there is one
+	std::string take()
+	{
+		if (m_buffers.empty())
+		{
+			return {};
+		}
+		std::string buffer = std::move(m_buffers.back());
+		m_buffers.pop_back();
+		return buffer;
+	}
+
+	void recycle(std::string buffer)
+	{
+		// One that never left the small-string buffer has no memory worth keeping
+		if (buffer.capacity() <= std::string().capacity() || buffer.capacity() > maxCapacity || m_buffers.size() >= maxBuffers)
+		{
+			return;
+		}
+		buffer.clear();
+		m_buffers.push_back(std::move(buffer));
+	}
+
+private:
+	std::vector<std::string> m_buffers;
+};
@@ -0,0 +1,41 @@
+#include "CoDel.h"
+
+namespace
+{
+int64_t toNs(CoDel::Clock::duration duration)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+} // namespace
+
+CoDel::CoDel(Clock::duration target, Clock::duration interval)
+	: m_targetNs(toNs(target)), m_intervalNs(toNs(interval))
+{
+}
+
+bool CoDel::shouldShed(Clock::duration sojourn, Clock::time_point now)
+{
+	const int64_t sojournNs = toNs(sojourn);
+	const int64_t nowNs = toNs(now.time_since_epoch());
+
+	if (nowNs >= m_intervalEndNs.load(std::memory_order_relaxed) && m_rolloverMutex.try_lock())
+	{
+		std::lock_guard lock(m_rolloverMutex, std::adopt_lock);
+		if (nowNs >= m_intervalEndNs.load(std::memory_order_relaxed))
+		{
+			m_overloaded.store(m_minDelayNs.load(std::memory_order_relaxed) > m_targetNs, std::memory_order_relaxed);
+			m_minDelayNs.store(sojournNs, std::memory_order_relaxed);
+			m_intervalEndNs.store(nowNs + m_intervalNs, std::memory_order_relaxed);
+		}
+	}
+	else
+	{
+		int64_t minDelay = m_minDelayNs.load(std::memory_order_relaxed);
+		while (sojournNs < minDelay
+			   && !m_minDelayNs.compare_exchange_weak(minDelay, sojournNs, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	return m_overloaded.load(std::memory_order_relaxed) && sojournNs > 2 * m_targetNs;
+}
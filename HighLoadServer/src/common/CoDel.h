@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Controlled Delay for a task queue, in the form servers use it rather than the packet
+// form of RFC 8289: the queue counts as overloaded for an interval when not even the
+// quickest task of the previous interval got out within target, and while it is, tasks that
+// waited more than twice the target are shed. Bursts that drain within an interval pass
+// untouched; a standing queue is cut back, which bounds tail latency under overload.
+class CoDel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	CoDel(Clock::duration target, Clock::duration interval);
+
+	CoDel(const CoDel&) = delete;
+	CoDel& operator=(const CoDel&) = delete;
+
+	// Called as a task leaves the queue after waiting sojourn; true when it should be shed.
+	// Lock-free except for the one caller per interval that starts the next interval.
+	bool shouldShed(Clock::duration sojourn, Clock::time_point now);
+
+private:
+	const int64_t m_targetNs;
+	const int64_t m_intervalNs;
+
+	std::mutex m_rolloverMutex;
+	std::atomic<int64_t> m_intervalEndNs{ 0 };
+	// Shortest wait seen in the current interval
+	std::atomic<int64_t> m_minDelayNs{ 0 };
+	std::atomic<bool> m_overloaded{ false };
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "FramePool.h"
+
+// Where a CoTask keeps what its coroutine co_returned
+template <typename T>
+class CoTaskResult
+{
+public:
+	void return_value(T value)
+	{
+		m_value.emplace(std::move(value));
+	}
+
+protected:
+	T takeValue()
+	{
+		return std::move(*m_value);
+	}
+
+private:
+	std::optional<T> m_value;
+};
+
+template <>
+class CoTaskResult<void>
+{
+public:
+	void return_void() {}
+
+protected:
+	void takeValue() {}
+};
+
+// Coroutine returning T, started lazily: co_await on it runs it until it finishes and then
+// resumes the awaiting coroutine by symmetric transfer, so nested calls neither grow the
+// stack nor pass through a scheduler. The outermost one is started with start() by whoever
+// drives it (a reactor). Frames are allocated from FramePool.
+//
+// A CoTask owns its coroutine: destroying it destroys the frame whether the coroutine has
+// finished or is suspended, together with the frames of the CoTasks it is awaiting.
+template <typename T = void>
+class CoTask
+{
+public:
+	class promise_type : public CoTaskResult<T>
+	{
+	public:
+		static void* operator new(size_t size)
+		{
+			return FramePool::allocate(size);
+		}
+
+		static void operator delete(void* frame, size_t size) noexcept
+		{
+			FramePool::deallocate(frame, size);
+		}
+
+		CoTask get_return_object() noexcept
+		{
+			return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		auto final_suspend() noexcept
+		{
+			struct ResumeAwaiting
+			{
+				bool await_ready() noexcept { return false; }
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+				{
+					const std::coroutine_handle<> awaiting = self.promise().m_awaiting;
+					return awaiting ? awaiting : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept {}
+			};
+			return ResumeAwaiting{};
+		}
+
+		void unhandled_exception() noexcept
+		{
+			m_error = std::current_exception();
+		}
+
+		T result()
+		{
+			if (m_error)
+			{
+				std::rethrow_exception(m_error);
+			}
+			return this->takeValue();
+		}
+
+	private:
+		friend class CoTask;
+
+		std::coroutine_handle<> m_awaiting;
+		std::exception_ptr m_error;
+	};
+
+	CoTask() noexcept = default;
+
+	CoTask(CoTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+	CoTask& operator=(CoTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+
+	~CoTask()
+	{
+		reset();
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(m_handle);
+	}
+
+	[[nodiscard]] bool done() const noexcept
+	{
+		return m_handle.done();
+	}
+
+	// Runs the coroutine up to its first suspension; for the outermost CoTask only
+	void start()
+	{
+		m_handle.resume();
+	}
+
+	// What the finished coroutine returned, or rethrows what escaped it
+	T result()
+	{
+		return m_handle.promise().result();
+	}
+
+	auto operator co_await() noexcept
+	{
+		struct Awaiter
+		{
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() noexcept { return handle.done(); }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				handle.promise().m_awaiting = awaiting;
+				return handle;
+			}
+
+			T await_resume() { return handle.promise().result(); }
+		};
+		return Awaiter{ m_handle };
+	}
+
+	void reset() noexcept
+	{
+		if (m_handle)
+		{
+			std::exchange(m_handle, nullptr).destroy();
+		}
+	}
+
+private:
+	explicit CoTask(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
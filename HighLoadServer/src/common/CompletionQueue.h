@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Hands results from worker threads back to an event loop. post() may be called from any
+// thread; the loop watches getFd() and, once it is readable, calls consumeSignal() and then
+// drain(). Posts coalesce: only the first one after a drain writes to the eventfd.
+template <typename T>
+class CompletionQueue
+{
+public:
+	CompletionQueue()
+		: m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+	{
+		if (m_fd == -1)
+		{
+			throw std::runtime_error("eventfd failed: " + std::string(strerror(errno)));
+		}
+	}
+
+	~CompletionQueue()
+	{
+		close(m_fd);
+	}
+
+	CompletionQueue(const CompletionQueue&) = delete;
+	CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+	[[nodiscard]] int getFd() const
+	{
+		return m_fd;
+	}
+
+	void post(T item)
+	{
+		bool needSignal;
+		{
+			std::lock_guard lock(m_mutex);
+			m_items.push_back(std::move(item));
+			needSignal = !m_signalPending;
+			m_signalPending = true;
+		}
+
+		if (needSignal)
+		{
+			signal();
+		}
+	}
+
+	// Posts every item of items, which is left empty, under one lock and with one signal
+	void postAll(std::vector<T>& items)
+	{
+		bool needSignal;
+		{
+			std::lock_guard lock(m_mutex);
+			m_items.insert(m_items.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+			needSignal = !m_signalPending;
+			m_signalPending = true;
+		}
+		items.clear();
+
+		if (needSignal)
+		{
+			signal();
+		}
+	}
+
+	// Wakes the loop without posting anything
+	void signal()
+	{
+		const uint64_t one = 1;
+		while (write(m_fd, &one, sizeof(one)) == -1 && errno == EINTR)
+		{
+		}
+	}
+
+	// Resets the eventfd. Must happen before drain(): an item posted after the swap then
+	// re-signals it and is picked up on the next wakeup.
+	void consumeSignal()
+	{
+		uint64_t counter;
+		while (read(m_fd, &counter, sizeof(counter)) == -1 && errno == EINTR)
+		{
+		}
+	}
+
+	template <typename Callback>
+	void drain(Callback&& onItem)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_inProgress.swap(m_items);
+			m_signalPending = false;
+		}
+
+		for (auto& item: m_inProgress)
+		{
+			onItem(item);
+		}
+		m_inProgress.clear();
+	}
+
+private:
+	int m_fd;
+	std::mutex m_mutex;
+	std::vector<T> m_items;
+	bool m_signalPending = false;
+	// Only touched by the loop thread; keeps its capacity between drains
+	std::vector<T> m_inProgress;
+};
@@ -0,0 +1,91 @@
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "CpuAffinity.h"
+#include "Logger.h"
+
+namespace
+{
+std::optional<int> parseCpu(std::string_view text)
+{
+	int cpu = 0;
+	const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+	if (error != std::errc() || end != text.data() + text.size() || cpu < 0 || cpu >= CPU_SETSIZE)
+	{
+		return std::nullopt;
+	}
+	return cpu;
+}
+
+std::string readLine(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+} // namespace
+
+std::optional<std::vector<int>> parseCpuList(std::string_view list)
+{
+	std::vector<int> cpus;
+	while (!list.empty())
+	{
+		const size_t comma = list.find(',');
+		const std::string_view range = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+		const size_t dash = range.find('-');
+		const auto first = parseCpu(range.substr(0, dash));
+		const auto last = dash == std::string_view::npos ? first : parseCpu(range.substr(dash + 1));
+		if (!first || !last || *last < *first)
+		{
+			return std::nullopt;
+		}
+		for (int cpu = *first; cpu <= *last; ++cpu)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	if (cpus.empty())
+	{
+		return std::nullopt;
+	}
+	return cpus;
+}
+
+bool pinCurrentThread(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (error != 0)
+	{
+		LOG_ERROR("Failed to pin thread to CPU {}: {}", cpu, strerror(error));
+		return false;
+	}
+	return true;
+}
+
+int numaNodeOf(int cpu)
+{
+	const auto nodes = parseCpuList(readLine("/sys/devices/system/node/online"));
+	if (!nodes)
+	{
+		return 0;
+	}
+	for (int node: *nodes)
+	{
+		const auto cpus = parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+		if (cpus && std::ranges::find(*cpus, cpu) != cpus->end())
+		{
+			return node;
+		}
+	}
+	return 0;
+}
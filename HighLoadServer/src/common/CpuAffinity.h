@@ -0,0 +1,58 @@
+#pragma once
+
+#include <exception>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Parses a list in the kernel's cpulist format ("0-3,8,10-11"); nullopt when it is malformed
+// or empty
+std::optional<std::vector<int>> parseCpuList(std::string_view list);
+
+// Pins the calling thread to cpu; logs and returns false when the kernel refuses
+bool pinCurrentThread(int cpu);
+
+// NUMA node cpu belongs to, from /sys/devices/system/node; 0 on machines without NUMA
+int numaNodeOf(int cpu);
+
+// Runs callable on a short-lived thread pinned to cpu and returns what it returns. Linux
+// backs a page with memory from the node of the thread that first touches it, so whatever
+// callable allocates and initialises is local to cpu's NUMA node.
+template <typename F>
+std::invoke_result_t<F&> runOnCpu(int cpu, F&& callable)
+{
+	using R = std::invoke_result_t<F&>;
+	std::optional<std::conditional_t<std::is_void_v<R>, bool, R>> result;
+	std::exception_ptr error;
+
+	std::thread([&] {
+		pinCurrentThread(cpu);
+		try
+		{
+			if constexpr (std::is_void_v<R>)
+			{
+				callable();
+			}
+			else
+			{
+				result.emplace(callable());
+			}
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+	}).join();
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	if constexpr (!std::is_void_v<R>)
+	{
+		return std::move(*result);
+	}
+}
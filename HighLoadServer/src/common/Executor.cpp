@@ -0,0 +1,23 @@
+#include "Executor.h"
+#include "ThreadPool.h"
+#include "WorkStealingThreadPool.h"
+#include <stdexcept>
+
+std::unique_ptr<Executor> makeExecutor(WorkerPoolKind kind, size_t queueCapacity, std::vector<int> cpus, PoolSizing sizing)
+{
+	const size_t threads = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+	if (kind == WorkerPoolKind::WorkStealing)
+	{
+		if (sizing.isElastic())
+		{
+			throw std::runtime_error("Elastic sizing needs the shared worker pool");
+		}
+		return std::make_unique<WorkStealingThreadPool>(threads, queueCapacity, std::move(cpus));
+	}
+	if (sizing.isElastic())
+	{
+		const size_t initial = sizing.minThreads;
+		return std::make_unique<ThreadPool>(initial, queueCapacity, std::move(cpus), std::move(sizing));
+	}
+	return std::make_unique<ThreadPool>(threads, queueCapacity, std::move(cpus));
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "Task.h"
+
+// Priority lanes of a pool that keeps them: a task waits until no task of a lane above it is
+// queued. Tasks queued without a tag go in Normal.
+enum class TaskLane : uint8_t
+{
+	High,
+	Normal,
+	Low
+};
+
+constexpr size_t taskLaneCount = 3;
+
+// Where a task queues in a pool that honours tags (ThreadPool does, WorkStealingThreadPool
+// ignores them). Within a lane the pool serves the keys' queues by deficit round robin, so a
+// key that floods the lane only lengthens its own queue. cost is what the task counts for
+// against its key's share, in requests.
+struct TaskTag
+{
+	TaskLane lane = TaskLane::Normal;
+	uint64_t key = 0;
+	uint32_t cost = 1;
+};
+
+// What tryEnqueue() did with a task
+enum class EnqueueResult
+{
+	Queued,
+	// The queue is full: the task is left untouched
+	Full,
+	// The pool is stopping: the task is discarded, as enqueue() discards it
+	Dropped
+};
+
+// Common interface of the worker pools EpollServer can hand requests to. A pool may be
+// bounded: enqueue() then waits for room, tryEnqueue() fails instead.
+class Executor
+{
+public:
+	virtual ~Executor() = default;
+
+	virtual void enqueue(Task task, TaskTag tag = {}) = 0;
+	virtual EnqueueResult tryEnqueue(Task& task, TaskTag tag = {}) = 0;
+	// Moves every task out of tasks with one lock acquisition and one wakeup where the pool
+	// has them to spare; waits for room like enqueue()
+	virtual void enqueueBulk(std::span<Task> tasks) = 0;
+
+	// Workers running now; only an elastic pool ever changes it
+	[[nodiscard]] virtual size_t getThreadCount() const = 0;
+
+	// Queues callable and returns a handle to what it returns
+	template <typename F, typename R = std::invoke_result_t<std::decay_t<F>&>>
+	TaskHandle<R> submit(F&& callable)
+	{
+		auto [task, handle] = TaskHandle<R>::make(std::forward<F>(callable));
+		enqueue(std::move(task));
+		return std::move(handle);
+	}
+};
+
+enum class WorkerPoolKind
+{
+	Shared,
+	WorkStealing
+};
+
+// One resize of an elastic pool, with what was measured over the interval that led to it
+struct PoolResize
+{
+	size_t from;
+	size_t to;
+	// Mean wait of the tasks picked up, or the age of the oldest one still queued if longer
+	std::chrono::microseconds queueWait;
+	// Fraction of the workers' time spent running tasks
+	double busy;
+	// CPUs' worth of time the workers were actually running on
+	double cpus;
+};
+
+// Elastic sizing of the shared pool. Every interval the pool looks at how long tasks waited
+// for a worker, how busy the workers were and how much CPU they got, and grows while tasks
+// wait longer than targetWait with every worker busy and CPU to spare (handlers that block),
+// shrinks when workers sit idle or outnumber saturated CPUs (handlers that compute). A
+// decision has to hold for a few intervals in a row before the pool acts on it.
+struct PoolSizing
+{
+	size_t minThreads = 1;
+	// 0 keeps the pool at its initial size
+	size_t maxThreads = 0;
+	std::chrono::milliseconds interval{ 100 };
+	std::chrono::microseconds targetWait{ 1000 };
+	// Called on the pool's control thread after each resize
+	std::function<void(const PoolResize&)> onResize;
+
+	[[nodiscard]] bool isElastic() const { return maxThreads != 0; }
+};
+
+// queueCapacity 0 means unbounded. With cpus given there is one worker pinned to each of
+// them instead of one per hardware thread. An elastic sizing, for WorkerPoolKind::Shared
+// only, starts the pool at sizing.minThreads workers instead.
+std::unique_ptr<Executor> makeExecutor(WorkerPoolKind kind, size_t queueCapacity = 0, std::vector<int> cpus = {}, PoolSizing sizing = {});
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Executor.h"
+
+// Queue of items tagged with a TaskTag: strict priority between the lanes, deficit round
+// robin between the keys of a lane. Each key with items queued has a FIFO of its own and a
+// place in its lane's round; when its turn comes it is credited quantum and hands out items
+// while their cost fits its credit, then goes to the back of the round. An item thus waits
+// for at most a turn of every other key ahead of it, however much those keys have queued.
+// Not thread-safe. Queues of keys that run empty are kept for the next new key, up to
+// spareFlows of them, so that keys coming and going do not allocate.
+template <typename T>
+class FairQueue
+{
+public:
+	static constexpr uint32_t quantum = 1;
+	static constexpr size_t spareFlows = 64;
+
+	void push(T item, TaskTag tag)
+	{
+		Lane& lane = m_lanes[static_cast<size_t>(tag.lane)];
+		// Runs of tasks from one key, untagged ones above all, skip the lookup
+		if (!lane.last || lane.last->key != tag.key)
+		{
+			auto it = lane.flows.find(tag.key);
+			lane.last = it != lane.flows.end() ? &it->second : addFlow(lane, tag.key);
+		}
+		lane.last->items.push_back({ std::move(item), tag.cost });
+		++m_size;
+	}
+
+	// The queue must not be empty
+	T pop()
+	{
+		Lane& lane = *std::find_if(m_lanes.begin(), m_lanes.end(), [](const Lane& l) { return !l.round.empty(); });
+		while (true)
+		{
+			Flow& flow = *lane.round.front();
+			Entry& head = flow.items.front();
+			if (lane.round.size() == 1)
+			{
+				// No other key to take turns with
+				flow.deficit = std::max<uint64_t>(flow.deficit, head.cost);
+			}
+			else if (head.cost > flow.deficit)
+			{
+				// Its turn is over; the credit is for the next one
+				flow.deficit += quantum;
+				lane.round.pop_front();
+				lane.round.push_back(&flow);
+				continue;
+			}
+
+			flow.deficit -= head.cost;
+			T item = std::move(head.item);
+			flow.items.pop_front();
+			--m_size;
+			if (flow.items.empty())
+			{
+				lane.round.pop_front();
+				removeFlow(lane, flow);
+			}
+			return item;
+		}
+	}
+
+	[[nodiscard]] size_t size() const { return m_size; }
+	[[nodiscard]] bool empty() const { return m_size == 0; }
+
+	// Calls visit with the oldest item of every key
+	template <typename F>
+	void forEachFront(F&& visit) const
+	{
+		for (const Lane& lane: m_lanes)
+		{
+			for (const Flow* flow: lane.round)
+			{
+				visit(flow->items.front().item);
+			}
+		}
+	}
+
+private:
+	struct Entry
+	{
+		T item;
+		uint32_t cost;
+	};
+
+	struct Flow
+	{
+		std::deque<Entry> items;
+		uint64_t key = 0;
+		uint64_t deficit = 0;
+	};
+
+	using FlowMap = std::unordered_map<uint64_t, Flow>;
+
+	struct Lane
+	{
+		// Flows never move once inserted, so the round can point at them
+		FlowMap flows;
+		std::deque<Flow*> round;
+		// The flow pushed to last, while it exists
+		Flow* last = nullptr;
+	};
+
+	Flow* addFlow(Lane& lane, uint64_t key)
+	{
+		typename FlowMap::iterator it;
+		if (m_spare.empty())
+		{
+			it = lane.flows.try_emplace(key).first;
+		}
+		else
+		{
+			auto node = std::move(m_spare.back());
+			m_spare.pop_back();
+			node.key() = key;
+			it = lane.flows.insert(std::move(node)).position;
+		}
+		Flow& flow = it->second;
+		flow.key = key;
+		flow.deficit = quantum;
+		lane.round.push_back(&flow);
+		return &flow;
+	}
+
+	void removeFlow(Lane& lane, Flow& flow)
+	{
+		if (lane.last == &flow)
+		{
+			lane.last = nullptr;
+		}
+		auto node = lane.flows.extract(flow.key);
+		if (m_spare.size() < spareFlows)
+		{
+			m_spare.push_back(std::move(node));
+		}
+	}
+
+	std::array<Lane, taskLaneCount> m_lanes;
+	std::vector<typename FlowMap::node_type> m_spare;
+	size_t m_size = 0;
+};
@@ -0,0 +1,89 @@
+#include "FramePool.h"
+#include <new>
+#include <utility>
+
+namespace
+{
+constexpr size_t classCount = FramePool::maxPooledSize / FramePool::granularity;
+
+struct FreeFrame
+{
+	FreeFrame* next;
+};
+
+class FrameCache
+{
+public:
+	FrameCache() = default;
+
+	FrameCache(const FrameCache&) = delete;
+	FrameCache& operator=(const FrameCache&) = delete;
+
+	~FrameCache()
+	{
+		for (FreeFrame* head: m_heads)
+		{
+			while (head)
+			{
+				::operator delete(std::exchange(head, head->next));
+			}
+		}
+	}
+
+	void* pop(size_t sizeClass)
+	{
+		FreeFrame* frame = m_heads[sizeClass];
+		if (frame)
+		{
+			m_heads[sizeClass] = frame->next;
+			--m_counts[sizeClass];
+		}
+		return frame;
+	}
+
+	bool push(size_t sizeClass, void* memory)
+	{
+		if (m_counts[sizeClass] == FramePool::maxCachedPerClass)
+		{
+			return false;
+		}
+		m_heads[sizeClass] = ::new (memory) FreeFrame{ m_heads[sizeClass] };
+		++m_counts[sizeClass];
+		return true;
+	}
+
+private:
+	FreeFrame* m_heads[classCount] = {};
+	size_t m_counts[classCount] = {};
+};
+
+thread_local FrameCache t_frames;
+
+size_t sizeClassOf(size_t size)
+{
+	return size == 0 ? 0 : (size - 1) / FramePool::granularity;
+}
+} // namespace
+
+void* FramePool::allocate(size_t size)
+{
+	if (size > maxPooledSize)
+	{
+		return ::operator new(size);
+	}
+
+	const size_t sizeClass = sizeClassOf(size);
+	if (void* frame = t_frames.pop(sizeClass))
+	{
+		return frame;
+	}
+	return ::operator new((sizeClass + 1) * granularity);
+}
+
+void FramePool::deallocate(void* frame, size_t size) noexcept
+{
+	if (size > maxPooledSize || !t_frames.push(sizeClassOf(size), frame))
+	{
+		::operator delete(frame);
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+// Allocator for coroutine frames (see CoTask). Frames up to maxPooledSize are rounded up to
+// a multiple of granularity and recycled through per-thread free lists, so a thread that
+// keeps starting coroutines of the same few shapes stops reaching malloc once warm. Larger
+// frames go straight to operator new. A frame may be freed on another thread than the one
+// that allocated it; it then joins that thread's list.
+class FramePool
+{
+public:
+	static constexpr size_t granularity = 64;
+	static constexpr size_t maxPooledSize = 2048;
+	// Free frames a thread keeps per size class; the rest go back to the heap
+	static constexpr size_t maxCachedPerClass = 1024;
+
+	static void* allocate(size_t size);
+	static void deallocate(void* frame, size_t size) noexcept;
+};
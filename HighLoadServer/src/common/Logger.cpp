@@ -0,0 +1,347 @@
+#include "Logger.h"
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t threadBufferSize = 256 * 1024;
+constexpr size_t recordAlignment = 8;
+// Size field value that tells the reader the rest of the ring up to its end is padding
+constexpr uint32_t wrapMarker = UINT32_MAX;
+constexpr size_t batchLimit = 64 * 1024;
+constexpr std::chrono::milliseconds idleWait{ 1 };
+
+size_t alignRecord(size_t size)
+{
+	return (size + recordAlignment - 1) & ~(recordAlignment - 1);
+}
+
+void writeAll(int fd, const std::string& data)
+{
+	size_t written = 0;
+	while (written < data.size())
+	{
+		const ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+		if (result == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			return;
+		}
+		written += static_cast<size_t>(result);
+	}
+}
+
+char levelLetter(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::Trace:
+		return 'T';
+	case LogLevel::Debug:
+		return 'D';
+	case LogLevel::Info:
+		return 'I';
+	case LogLevel::Warn:
+		return 'W';
+	case LogLevel::Error:
+	default:
+		return 'E';
+	}
+}
+} // namespace
+
+// Byte ring with one producer (the owning thread) and one consumer (the writer thread).
+// Records are contiguous and 8-byte aligned; one that does not fit before the end of the
+// ring is placed at its start behind a wrap marker.
+class Logger::ThreadBuffer
+{
+public:
+	ThreadBuffer()
+		: m_data(new std::byte[threadBufferSize])
+	{
+	}
+
+	std::byte* reserve(size_t size)
+	{
+		const size_t need = alignRecord(size);
+		const size_t offset = m_tail & (threadBufferSize - 1);
+		const size_t toEnd = threadBufferSize - offset;
+		const size_t required = need <= toEnd ? need : toEnd + need;
+
+		if (threadBufferSize - (m_tail - m_cachedHead) < required)
+		{
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			if (threadBufferSize - (m_tail - m_cachedHead) < required)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+		}
+
+		if (need > toEnd)
+		{
+			std::memcpy(m_data.get() + offset, &wrapMarker, sizeof(wrapMarker));
+			m_pendingTail = m_tail + toEnd + need;
+			return m_data.get();
+		}
+		m_pendingTail = m_tail + need;
+		return m_data.get() + offset;
+	}
+
+	void commit()
+	{
+		m_tail = m_pendingTail;
+		m_published.store(m_tail, std::memory_order_release);
+	}
+
+	template <typename Callback>
+	size_t consume(Callback&& onRecord)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		const size_t tail = m_published.load(std::memory_order_acquire);
+		size_t count = 0;
+
+		while (head != tail)
+		{
+			const size_t offset = head & (threadBufferSize - 1);
+			uint32_t size;
+			std::memcpy(&size, m_data.get() + offset, sizeof(size));
+			if (size == wrapMarker)
+			{
+				head += threadBufferSize - offset;
+				continue;
+			}
+
+			onRecord(m_data.get() + offset);
+			head += alignRecord(size);
+			++count;
+		}
+
+		m_head.store(head, std::memory_order_release);
+		return count;
+	}
+
+	[[nodiscard]] bool empty() const
+	{
+		return m_head.load(std::memory_order_acquire) == m_published.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] uint64_t dropped() const
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+	// Set when the owning thread exits; the writer releases the buffer once it is drained
+	std::atomic<bool> retired = false;
+	// Writer-side count of drops already reported
+	uint64_t reportedDrops = 0;
+
+private:
+	std::unique_ptr<std::byte[]> m_data;
+
+	// Producer side
+	size_t m_tail = 0;
+	size_t m_pendingTail = 0;
+	size_t m_cachedHead = 0;
+	alignas(64) std::atomic<size_t> m_published = 0;
+
+	// Consumer side
+	alignas(64) std::atomic<size_t> m_head = 0;
+	std::atomic<uint64_t> m_dropped = 0;
+};
+
+Logger& Logger::instance()
+{
+	static Logger logger;
+	return logger;
+}
+
+Logger::Logger()
+{
+	m_writer = std::jthread([this](std::stop_token stopToken) { writerLoop(stopToken); });
+}
+
+Logger::~Logger()
+{
+	m_writer.request_stop();
+	m_flushCondition.notify_all();
+	m_writer.join();
+}
+
+void Logger::setLevel(LogLevel level)
+{
+	m_level.store(level, std::memory_order_relaxed);
+}
+
+Logger::ThreadBuffer& Logger::localBuffer()
+{
+	struct Holder
+	{
+		~Holder()
+		{
+			if (buffer)
+			{
+				buffer->retired.store(true, std::memory_order_release);
+			}
+		}
+
+		std::shared_ptr<ThreadBuffer> buffer;
+	};
+
+	thread_local Holder holder;
+	if (!holder.buffer)
+	{
+		holder.buffer = std::make_shared<ThreadBuffer>();
+		std::lock_guard lock(m_buffersMutex);
+		m_buffers.push_back(holder.buffer);
+		m_buffersVersion.fetch_add(1, std::memory_order_release);
+	}
+	return *holder.buffer;
+}
+
+std::byte* Logger::reserve(size_t size)
+{
+	if (size > threadBufferSize / 2)
+	{
+		return nullptr;
+	}
+	return localBuffer().reserve(size);
+}
+
+void Logger::commit()
+{
+	localBuffer().commit();
+}
+
+void Logger::flush()
+{
+	std::unique_lock lock(m_flushMutex);
+	const uint64_t ticket = ++m_flushRequested;
+	m_flushCondition.notify_all();
+	m_flushCondition.wait(lock, [this, ticket] { return m_flushCompleted >= ticket; });
+}
+
+void Logger::writerLoop(std::stop_token stopToken)
+{
+	while (true)
+	{
+		uint64_t flushTicket;
+		{
+			std::lock_guard lock(m_flushMutex);
+			flushTicket = m_flushRequested;
+		}
+
+		const bool stopping = stopToken.stop_requested();
+		const size_t drained = drain();
+		writeOut();
+
+		{
+			std::unique_lock lock(m_flushMutex);
+			if (m_flushCompleted < flushTicket)
+			{
+				m_flushCompleted = flushTicket;
+				m_flushCondition.notify_all();
+			}
+			if (stopping && drained == 0)
+			{
+				break;
+			}
+			if (drained == 0)
+			{
+				// Producers never signal; an idle writer polls, and flush() cuts the wait short
+				m_flushCondition.wait_for(lock, idleWait, [this, &stopToken] {
+					return m_flushRequested > m_flushCompleted || stopToken.stop_requested();
+				});
+			}
+		}
+	}
+}
+
+size_t Logger::drain()
+{
+	if (const uint64_t version = m_buffersVersion.load(std::memory_order_acquire); version != m_drainListVersion)
+	{
+		std::lock_guard lock(m_buffersMutex);
+		m_drainList = m_buffers;
+		m_drainListVersion = version;
+	}
+
+	size_t total = 0;
+	uint64_t dropped = 0;
+	bool released = false;
+
+	for (auto& buffer: m_drainList)
+	{
+		// Read before draining: a retired buffer that is empty afterwards stays empty
+		const bool retired = buffer->retired.load(std::memory_order_acquire);
+
+		total += buffer->consume([this](const std::byte* record) {
+			RecordHeader header;
+			std::memcpy(&header, record, sizeof(header));
+
+			std::string& out = header.level >= LogLevel::Warn ? m_err : m_out;
+
+			const int64_t second = header.timestampNs / 1'000'000'000;
+			if (second != m_cachedSecond)
+			{
+				const auto seconds = static_cast<time_t>(second);
+				tm local{};
+				localtime_r(&seconds, &local);
+				strftime(m_cachedTime, sizeof(m_cachedTime), "%H:%M:%S", &local);
+				m_cachedSecond = second;
+			}
+
+			const auto micros = static_cast<unsigned>((header.timestampNs / 1000) % 1'000'000);
+			char prefix[32];
+			const int prefixSize = snprintf(prefix, sizeof(prefix), "%s.%06u %c ", m_cachedTime, micros, levelLetter(header.level));
+			out.append(prefix, static_cast<size_t>(prefixSize));
+
+			header.format({ header.fmt, header.fmtSize }, record + sizeof(header), out);
+			out += '\n';
+
+			if (out.size() >= batchLimit)
+			{
+				writeOut();
+			}
+		});
+
+		const uint64_t bufferDrops = buffer->dropped();
+		dropped += bufferDrops - buffer->reportedDrops;
+		buffer->reportedDrops = bufferDrops;
+		released = released || (retired && buffer->empty());
+	}
+
+	if (dropped != 0)
+	{
+		m_err += "logger: " + std::to_string(dropped) + " record(s) dropped, ring full\n";
+	}
+
+	if (released)
+	{
+		std::lock_guard lock(m_buffersMutex);
+		std::erase_if(m_buffers, [](const auto& buffer) {
+			return buffer->retired.load(std::memory_order_acquire) && buffer->empty();
+		});
+		m_buffersVersion.fetch_add(1, std::memory_order_release);
+	}
+	return total;
+}
+
+void Logger::writeOut()
+{
+	if (!m_out.empty())
+	{
+		writeAll(STDOUT_FILENO, m_out);
+		m_out.clear();
+	}
+	if (!m_err.empty())
+	{
+		writeAll(STDERR_FILENO, m_err);
+		m_err.clear();
+	}
+}
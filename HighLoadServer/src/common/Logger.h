@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+enum class LogLevel : uint8_t
+{
+	Trace,
+	Debug,
+	Info,
+	Warn,
+	Error
+};
+
+// Records below this level are compiled out entirely (0 = trace ... 4 = error)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// Compared as enumerators: an int comparison with the default of 0 is always true, which
+// -Wtype-limits reports at every call site
+constexpr bool isLogLevelCompiledIn(LogLevel level)
+{
+	return level >= static_cast<LogLevel>(LOG_MIN_LEVEL);
+}
+
+#define LOG_AT(level, ...)                                                  \
+	do                                                                      \
+	{                                                                       \
+		if constexpr (isLogLevelCompiledIn(level))                          \
+		{                                                                   \
+			if (Logger::instance().isEnabled(level))                        \
+			{                                                               \
+				Logger::instance().log(level, __VA_ARGS__);                 \
+			}                                                               \
+		}                                                                   \
+	} while (false)
+
+#define LOG_TRACE(...) LOG_AT(LogLevel::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+namespace logdetail
+{
+// Arguments are stored in binary: arithmetic values as they are, strings as a length and
+// the bytes. Anything else is rendered through operator<< on the calling thread.
+template <typename T>
+auto toLoggable(const T& value)
+{
+	if constexpr (std::is_arithmetic_v<T>)
+	{
+		return value;
+	}
+	else if constexpr (std::is_pointer_v<T> && std::is_convertible_v<T, std::string_view>)
+	{
+		return value ? std::string_view(value) : std::string_view("(null)");
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+	{
+		return std::string_view(value);
+	}
+	else
+	{
+		std::ostringstream stream;
+		stream << value;
+		return std::move(stream).str();
+	}
+}
+
+template <typename T>
+using Decoded = std::conditional_t<std::is_arithmetic_v<T>, T, std::string_view>;
+
+template <typename T>
+size_t encodedSize(const T& value)
+{
+	if constexpr (std::is_arithmetic_v<T>)
+	{
+		return sizeof(T);
+	}
+	else
+	{
+		return sizeof(uint32_t) + value.size();
+	}
+}
+
+template <typename T>
+std::byte* encode(std::byte* out, const T& value)
+{
+	if constexpr (std::is_arithmetic_v<T>)
+	{
+		std::memcpy(out, &value, sizeof(T));
+		return out + sizeof(T);
+	}
+	else
+	{
+		const auto size = static_cast<uint32_t>(value.size());
+		std::memcpy(out, &size, sizeof(size));
+		std::memcpy(out + sizeof(size), value.data(), size);
+		return out + sizeof(size) + size;
+	}
+}
+
+template <typename T>
+Decoded<T> decode(const std::byte*& in)
+{
+	if constexpr (std::is_arithmetic_v<T>)
+	{
+		T value;
+		std::memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return value;
+	}
+	else
+	{
+		uint32_t size;
+		std::memcpy(&size, in, sizeof(size));
+		const auto* data = reinterpret_cast<const char*>(in + sizeof(size));
+		in += sizeof(size) + size;
+		return { data, size };
+	}
+}
+
+template <typename T>
+void append(std::string& out, const T& value)
+{
+	if constexpr (std::is_same_v<T, bool>)
+	{
+		out += value ? "true" : "false";
+	}
+	else if constexpr (std::is_same_v<T, char>)
+	{
+		out += value;
+	}
+	else if constexpr (std::is_arithmetic_v<T>)
+	{
+		char buffer[32];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+	else
+	{
+		out += value;
+	}
+}
+
+// Substitutes the arguments for the "{}" placeholders in order; "{{" and "}}" are literal braces
+template <typename... Ts>
+void format(std::string_view fmt, std::string& out, const Ts&... args)
+{
+	size_t pos = 0;
+	auto next = [&](auto&& emitArgument) {
+		while (pos < fmt.size())
+		{
+			const char c = fmt[pos];
+			if ((c == '{' || c == '}') && pos + 1 < fmt.size() && fmt[pos + 1] == c)
+			{
+				out += c;
+				pos += 2;
+				continue;
+			}
+			if (c == '{' && pos + 1 < fmt.size() && fmt[pos + 1] == '}')
+			{
+				pos += 2;
+				emitArgument();
+				return;
+			}
+			out += c;
+			++pos;
+		}
+	};
+
+	(next([&] { append(out, args); }), ...);
+	next([] {});
+}
+
+template <typename... Ts>
+void formatRecord(std::string_view fmt, [[maybe_unused]] const std::byte* payload, std::string& out)
+{
+	// Braced initialisation decodes the arguments left to right
+	const std::tuple<Decoded<Ts>...> values{ decode<Ts>(payload)... };
+	std::apply([&](const auto&... args) { format(fmt, out, args...); }, values);
+}
+} // namespace logdetail
+
+// Asynchronous logger. Every thread appends binary records (a format string pointer, the
+// argument values and a timestamp) to its own single-producer ring, so logging never takes a
+// lock or touches a stream; a background thread drains the rings, formats the records and
+// writes them out in batches. A thread whose ring is full drops the record and counts it.
+// Records of one thread come out in order; records of different threads are only grouped
+// by batch, so their relative order can differ from their timestamps.
+class Logger
+{
+public:
+	using FormatFn = void (*)(std::string_view fmt, const std::byte* payload, std::string& out);
+
+	static Logger& instance();
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	void setLevel(LogLevel level);
+	[[nodiscard]] bool isEnabled(LogLevel level) const
+	{
+		return level >= m_level.load(std::memory_order_relaxed);
+	}
+
+	// fmt must outlive the logger (a string literal): only its address is recorded
+	template <typename... Args>
+	void log(LogLevel level, std::string_view fmt, const Args&... args)
+	{
+		write(level, fmt, logdetail::toLoggable(args)...);
+	}
+
+	// Blocks until everything logged before the call has been written out
+	void flush();
+
+private:
+	struct RecordHeader
+	{
+		uint32_t size;
+		LogLevel level;
+		int64_t timestampNs;
+		FormatFn format;
+		const char* fmt;
+		size_t fmtSize;
+	};
+
+	class ThreadBuffer;
+
+	Logger();
+	~Logger();
+
+	template <typename... Ts>
+	void write(LogLevel level, std::string_view fmt, const Ts&... values);
+
+	std::byte* reserve(size_t size);
+	void commit();
+
+	ThreadBuffer& localBuffer();
+	void writerLoop(std::stop_token stopToken);
+	size_t drain();
+	void writeOut();
+
+	std::atomic<LogLevel> m_level = LogLevel::Info;
+
+	std::mutex m_buffersMutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+	std::atomic<uint64_t> m_buffersVersion = 0;
+
+	// Writer thread state
+	std::vector<std::shared_ptr<ThreadBuffer>> m_drainList;
+	uint64_t m_drainListVersion = 0;
+	std::string m_out;
+	std::string m_err;
+	int64_t m_cachedSecond = -1;
+	char m_cachedTime[16]{};
+
+	std::mutex m_flushMutex;
+	std::condition_variable m_flushCondition;
+	uint64_t m_flushRequested = 0;
+	uint64_t m_flushCompleted = 0;
+
+	std::jthread m_writer;
+};
+
+template <typename... Ts>
+void Logger::write(LogLevel level, std::string_view fmt, const Ts&... values)
+{
+	const size_t size = sizeof(RecordHeader) + (logdetail::encodedSize(values) + ... + 0);
+	std::byte* record = reserve(size);
+	if (!record)
+	{
+		return;
+	}
+
+	const RecordHeader header{
+		static_cast<uint32_t>(size),
+		level,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+		&logdetail::formatRecord<Ts...>,
+		fmt.data(),
+		fmt.size(),
+	};
+	std::memcpy(record, &header, sizeof(header));
+
+	if constexpr (sizeof...(values) > 0)
+	{
+		std::byte* out = record + sizeof(header);
+		((out = logdetail::encode(out, values)), ...);
+	}
+	commit();
+}
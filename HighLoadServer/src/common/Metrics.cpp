@@ -0,0 +1,248 @@
+#include "Metrics.h"
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+// Exported histogram buckets: powers of two from about 1 us to about 9 min (in ns)
+constexpr unsigned firstExportedBucketBits = 10;
+constexpr unsigned lastExportedBucketBits = 39;
+
+void appendSeriesName(std::string& out, const std::string& name, const char* suffix, const std::string& labels, const std::string& extraLabel = {})
+{
+	out += name;
+	out += suffix;
+	if (labels.empty() && extraLabel.empty())
+	{
+		return;
+	}
+
+	out += '{';
+	out += labels;
+	if (!labels.empty() && !extraLabel.empty())
+	{
+		out += ',';
+	}
+	out += extraLabel;
+	out += '}';
+}
+
+std::string formatSeconds(uint64_t nanoseconds)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.9g", static_cast<double>(nanoseconds) / 1e9);
+	return buffer;
+}
+} // namespace
+
+uint64_t Counter::value() const
+{
+	uint64_t total = 0;
+	for (const auto& shard: m_shards)
+	{
+		total += shard.value.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+int64_t Gauge::value() const
+{
+	int64_t total = 0;
+	for (const auto& shard: m_shards)
+	{
+		total += shard.value.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+uint64_t HistogramSnapshot::percentile(double fraction) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	const auto target = static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < counts.size(); ++i)
+	{
+		seen += counts[i];
+		if (seen >= target && seen > 0)
+		{
+			// The top bucket may extend past the largest sample
+			return std::min(Histogram::bucketUpperBound(i), max);
+		}
+	}
+	return max;
+}
+
+uint64_t HistogramSnapshot::countBelow(uint64_t value) const
+{
+	const size_t end = Histogram::bucketIndex(std::min(value, Histogram::maxValue));
+	uint64_t total = 0;
+	for (size_t i = 0; i < end && i < counts.size(); ++i)
+	{
+		total += counts[i];
+	}
+	return total;
+}
+
+Histogram::Histogram()
+{
+	for (auto& shard: m_shards)
+	{
+		shard = std::make_unique<Shard>();
+	}
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+	HistogramSnapshot result;
+	result.counts.assign(bucketCount, 0);
+
+	for (const auto& shard: m_shards)
+	{
+		for (size_t i = 0; i < bucketCount; ++i)
+		{
+			const uint64_t n = shard->counts[i].load(std::memory_order_relaxed);
+			result.counts[i] += n;
+			result.count += n;
+		}
+		result.sum += shard->sum.load(std::memory_order_relaxed);
+		result.max = std::max(result.max, shard->max.load(std::memory_order_relaxed));
+	}
+	return result;
+}
+
+void Histogram::reset()
+{
+	for (auto& shard: m_shards)
+	{
+		for (auto& count: shard->counts)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+		shard->sum.store(0, std::memory_order_relaxed);
+		shard->max.store(0, std::memory_order_relaxed);
+	}
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+	static MetricsRegistry registry;
+	return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrAdd(const std::string& name, const std::string& help, const std::string& labels, Type type)
+{
+	Family* family = nullptr;
+	for (auto& candidate: m_families)
+	{
+		if (candidate->name == name)
+		{
+			family = candidate.get();
+			break;
+		}
+	}
+
+	if (!family)
+	{
+		m_families.push_back(std::make_unique<Family>(Family{ name, help, type, {} }));
+		family = m_families.back().get();
+	}
+	else if (family->type != type)
+	{
+		throw std::logic_error("Metric " + name + " registered with two different types");
+	}
+
+	for (auto& series: family->series)
+	{
+		if (series.labels == labels)
+		{
+			return series;
+		}
+	}
+
+	Series& series = family->series.emplace_back();
+	series.labels = labels;
+	return series;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels)
+{
+	std::lock_guard lock(m_mutex);
+	Series& series = findOrAdd(name, help, labels, Type::Counter);
+	if (!series.counter)
+	{
+		series.counter = std::make_unique<Counter>();
+	}
+	return *series.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+	std::lock_guard lock(m_mutex);
+	Series& series = findOrAdd(name, help, labels, Type::Gauge);
+	if (!series.gauge)
+	{
+		series.gauge = std::make_unique<Gauge>();
+	}
+	return *series.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels)
+{
+	std::lock_guard lock(m_mutex);
+	Series& series = findOrAdd(name, help, labels, Type::Histogram);
+	if (!series.histogram)
+	{
+		series.histogram = std::make_unique<Histogram>();
+	}
+	return *series.histogram;
+}
+
+std::string MetricsRegistry::renderPrometheus() const
+{
+	std::lock_guard lock(m_mutex);
+	std::string out;
+
+	for (const auto& family: m_families)
+	{
+		out += "# HELP " + family->name + " " + family->help + "\n";
+		const char* typeName = family->type == Type::Counter ? "counter"
+			: family->type == Type::Gauge					 ? "gauge"
+															 : "histogram";
+		out += "# TYPE " + family->name + " " + typeName + "\n";
+
+		for (const auto& series: family->series)
+		{
+			if (series.counter)
+			{
+				appendSeriesName(out, family->name, "", series.labels);
+				out += " " + std::to_string(series.counter->value()) + "\n";
+			}
+			else if (series.gauge)
+			{
+				appendSeriesName(out, family->name, "", series.labels);
+				out += " " + std::to_string(series.gauge->value()) + "\n";
+			}
+			else if (series.histogram)
+			{
+				const HistogramSnapshot snapshot = series.histogram->snapshot();
+				for (unsigned bits = firstExportedBucketBits; bits <= lastExportedBucketBits; ++bits)
+				{
+					const uint64_t bound = uint64_t{ 1 } << bits;
+					appendSeriesName(out, family->name, "_bucket", series.labels, "le=\"" + formatSeconds(bound) + "\"");
+					out += " " + std::to_string(snapshot.countBelow(bound)) + "\n";
+				}
+				appendSeriesName(out, family->name, "_bucket", series.labels, "le=\"+Inf\"");
+				out += " " + std::to_string(snapshot.count) + "\n";
+				appendSeriesName(out, family->name, "_sum", series.labels);
+				out += " " + formatSeconds(snapshot.sum) + "\n";
+				appendSeriesName(out, family->name, "_count", series.labels);
+				out += " " + std::to_string(snapshot.count) + "\n";
+			}
+		}
+	}
+	return out;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr size_t metricShardCount = 16;
+
+// Threads are spread over the shards round-robin on their first update, so concurrent
+// writers rarely share a cache line
+inline std::atomic<size_t> g_nextMetricShard{ 0 };
+
+inline size_t currentMetricShard()
+{
+	thread_local const size_t shard = g_nextMetricShard.fetch_add(1, std::memory_order_relaxed) % metricShardCount;
+	return shard;
+}
+
+// Monotonic counter, sharded per thread; reads sum the shards
+class Counter
+{
+public:
+	void inc(uint64_t amount = 1)
+	{
+		m_shards[currentMetricShard()].value.fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] uint64_t value() const;
+
+private:
+	struct alignas(64) Shard
+	{
+		std::atomic<uint64_t> value{ 0 };
+	};
+
+	std::array<Shard, metricShardCount> m_shards;
+};
+
+// Value that goes up and down; add() deltas are sharded like Counter
+class Gauge
+{
+public:
+	void add(int64_t delta)
+	{
+		m_shards[currentMetricShard()].value.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] int64_t value() const;
+
+private:
+	struct alignas(64) Shard
+	{
+		std::atomic<int64_t> value{ 0 };
+	};
+
+	std::array<Shard, metricShardCount> m_shards;
+};
+
+struct HistogramSnapshot
+{
+	std::vector<uint64_t> counts;
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	// Highest value equivalent to the bucket holding the given fraction (0..1) of samples
+	[[nodiscard]] uint64_t percentile(double fraction) const;
+	// Samples below value's bucket
+	[[nodiscard]] uint64_t countBelow(uint64_t value) const;
+};
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is split into
+// 2^subBucketBits equal buckets, which keeps the relative error near 3% across the range
+// while recording stays a couple of shifts and one relaxed increment.
+class Histogram
+{
+public:
+	static constexpr unsigned subBucketBits = 5;
+	static constexpr uint64_t subBucketCount = uint64_t{ 1 } << subBucketBits;
+	static constexpr unsigned maxValueBits = 40;
+	static constexpr uint64_t maxValue = (uint64_t{ 1 } << maxValueBits) - 1;
+	static constexpr size_t bucketCount = (maxValueBits - subBucketBits + 1) * subBucketCount;
+
+	Histogram();
+
+	void record(uint64_t value)
+	{
+		value = value > maxValue ? maxValue : value;
+		Shard& shard = *m_shards[currentMetricShard()];
+		shard.counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t max = shard.max.load(std::memory_order_relaxed);
+		while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	[[nodiscard]] HistogramSnapshot snapshot() const;
+	void reset();
+
+	static size_t bucketIndex(uint64_t value)
+	{
+		if (value < subBucketCount)
+		{
+			return static_cast<size_t>(value);
+		}
+		const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - subBucketBits;
+		return static_cast<size_t>((shift + 1) * subBucketCount + (value >> shift) - subBucketCount);
+	}
+
+	static uint64_t bucketLowerBound(size_t index)
+	{
+		if (index < subBucketCount)
+		{
+			return index;
+		}
+		const uint64_t shift = index / subBucketCount - 1;
+		return (index % subBucketCount + subBucketCount) << shift;
+	}
+
+	static uint64_t bucketUpperBound(size_t index)
+	{
+		return index + 1 < bucketCount ? bucketLowerBound(index + 1) - 1 : maxValue;
+	}
+
+private:
+	struct Shard
+	{
+		std::array<std::atomic<uint64_t>, bucketCount> counts{};
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> max{ 0 };
+	};
+
+	std::array<std::unique_ptr<Shard>, metricShardCount> m_shards;
+};
+
+// Process-wide set of named metrics. Asking twice for the same name and labels returns the
+// same instance, so every reactor or pool can look its metrics up independently. Histograms
+// record nanoseconds and are exported in seconds.
+class MetricsRegistry
+{
+public:
+	static MetricsRegistry& instance();
+
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	// labels use the exposition syntax without braces, e.g. kind="idle"
+	Counter& counter(const std::string& name, const std::string& help, const std::string& labels = {});
+	Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = {});
+	Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = {});
+
+	// Prometheus text exposition format, version 0.0.4
+	[[nodiscard]] std::string renderPrometheus() const;
+
+private:
+	enum class Type
+	{
+		Counter,
+		Gauge,
+		Histogram
+	};
+
+	struct Series
+	{
+		std::string labels;
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Gauge> gauge;
+		std::unique_ptr<Histogram> histogram;
+	};
+
+	struct Family
+	{
+		std::string name;
+		std::string help;
+		Type type;
+		std::vector<Series> series;
+	};
+
+	MetricsRegistry() = default;
+
+	Series& findOrAdd(const std::string& name, const std::string& help, const std::string& labels, Type type);
+
+	mutable std::mutex m_mutex;
+	// Families are only appended, and series own their metric through a pointer, so the
+	// references handed out stay valid
+	std::vector<std::unique_ptr<Family>> m_families;
+};
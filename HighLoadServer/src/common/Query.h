@@ -1,8 +1,16 @@
 #pragma once
 #include <string>
+#include <string_view>
 
 struct Query
 {
 	std::string name;
 	int number;
-};
\ No newline at end of file
+};
+
+// Query whose name points into the buffer it was parsed from
+struct QueryView
+{
+	std::string_view name;
+	int number;
+};
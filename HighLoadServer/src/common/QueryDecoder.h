@@ -0,0 +1,152 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "WireProtocol.h"
+
+// Growable per-connection input buffer that splits the byte stream into frames: text
+// "name\nnumber\n" or binary, whichever the first byte selects (see WireProtocol.h).
+// Bytes are written straight into the buffer by the socket reader; next() hands out
+// complete frames one by one and remembers how far it has scanned, so a frame split over
+// several reads is never rescanned from the start.
+class QueryDecoder
+{
+public:
+	// Room for the largest binary frame
+	static constexpr size_t defaultMaxFrameSize = binaryHeaderSize + maxBinaryNameSize;
+
+	explicit QueryDecoder(size_t maxFrameSize = defaultMaxFrameSize)
+		: m_maxFrameSize(maxFrameSize)
+	{
+	}
+
+	// Free space of at least minSize bytes after the buffered data
+	std::span<char> prepareWrite(size_t minSize)
+	{
+		compact();
+		if (m_data.size() - m_size < minSize)
+		{
+			m_data.resize(std::max(m_data.size() * 2, m_size + minSize));
+		}
+		return { m_data.data() + m_size, m_data.size() - m_size };
+	}
+
+	void commitWrite(size_t size)
+	{
+		m_size += size;
+	}
+
+	// The returned view stays valid until the next prepareWrite()
+	std::optional<std::string_view> next()
+	{
+		if (!m_protocol)
+		{
+			if (m_size == 0)
+			{
+				return std::nullopt;
+			}
+			m_protocol = static_cast<uint8_t>(m_data[0]) == binaryQueryMarker ? WireProtocol::Binary : WireProtocol::Text;
+		}
+		return *m_protocol == WireProtocol::Binary ? nextBinary() : nextText();
+	}
+
+	// Text until the first byte has arrived
+	WireProtocol protocol() const
+	{
+		return m_protocol.value_or(WireProtocol::Text);
+	}
+
+	// A peer that keeps sending without ever completing a frame
+	bool isOverflowed() const
+	{
+		return m_size - m_readPos > m_maxFrameSize;
+	}
+
+	// A binary frame with a wrong marker or an unknown version; nothing after it is decoded
+	bool isMalformed() const
+	{
+		return m_malformed;
+	}
+
+	size_t bufferedSize() const
+	{
+		return m_size - m_readPos;
+	}
+
+private:
+	static constexpr int linesPerFrame = 2;
+
+	std::optional<std::string_view> nextText()
+	{
+		while (m_scanPos < m_size)
+		{
+			const char* begin = m_data.data() + m_scanPos;
+			const auto* newline = static_cast<const char*>(std::memchr(begin, '\n', m_size - m_scanPos));
+			if (!newline)
+			{
+				m_scanPos = m_size;
+				break;
+			}
+
+			m_scanPos = static_cast<size_t>(newline - m_data.data()) + 1;
+			if (++m_linesInFrame == linesPerFrame)
+			{
+				std::string_view frame(m_data.data() + m_readPos, m_scanPos - m_readPos);
+				m_readPos = m_scanPos;
+				m_linesInFrame = 0;
+				return frame;
+			}
+		}
+		return std::nullopt;
+	}
+
+	std::optional<std::string_view> nextBinary()
+	{
+		const std::string_view buffered(m_data.data() + m_readPos, m_size - m_readPos);
+		const auto frameSize = binaryFrameSize(buffered);
+		if (m_malformed || !frameSize)
+		{
+			return std::nullopt;
+		}
+		if (!isBinaryHeaderValid(buffered))
+		{
+			m_malformed = true;
+			return std::nullopt;
+		}
+		if (buffered.size() < *frameSize)
+		{
+			return std::nullopt;
+		}
+
+		m_readPos += *frameSize;
+		m_scanPos = m_readPos;
+		return buffered.substr(0, *frameSize);
+	}
+
+	void compact()
+	{
+		if (m_readPos == 0)
+		{
+			return;
+		}
+		if (m_readPos < m_size)
+		{
+			std::memmove(m_data.data(), m_data.data() + m_readPos, m_size - m_readPos);
+		}
+		m_size -= m_readPos;
+		m_scanPos -= m_readPos;
+		m_readPos = 0;
+	}
+
+	std::vector<char> m_data;
+	size_t m_size = 0;
+	size_t m_readPos = 0;
+	size_t m_scanPos = 0;
+	int m_linesInFrame = 0;
+	size_t m_maxFrameSize;
+	std::optional<WireProtocol> m_protocol;
+	bool m_malformed = false;
+};
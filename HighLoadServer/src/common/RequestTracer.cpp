@@ -0,0 +1,246 @@
+#include "RequestTracer.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <unistd.h>
+
+namespace
+{
+// Events kept per thread: at 1 request in 100 and seven events each, about the last
+// quarter of a million requests a thread has seen
+constexpr size_t ringCapacity = 16 * 1024;
+
+struct Event
+{
+	uint64_t id;
+	uint64_t ticks;
+	TraceStage stage;
+	int connection;
+	int tid;
+};
+
+const char* stageName(TraceStage stage)
+{
+	switch (stage)
+	{
+	case TraceStage::Accept:
+		return "accept";
+	case TraceStage::ReadComplete:
+		return "read";
+	case TraceStage::Enqueue:
+		return "enqueue";
+	case TraceStage::Dequeue:
+		return "dequeue";
+	case TraceStage::HandlerStart:
+		return "handler start";
+	case TraceStage::HandlerEnd:
+		return "handler end";
+	case TraceStage::WriteComplete:
+	default:
+		return "write";
+	}
+}
+
+template <typename T>
+void appendNumber(std::string& out, T value)
+{
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	out.append(buffer, result.ptr);
+}
+
+// Chrome trace timestamps are microseconds; three decimals keep nanoseconds
+void appendMicros(std::string& out, double us)
+{
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), us, std::chars_format::fixed, 3);
+	out.append(buffer, result.ptr);
+}
+
+// One Chrome trace event; ph is "b"/"e" for the ends of an async span, "i" for an instant
+void appendEvent(std::string& out, const char* ph, std::string_view name, uint64_t id, double tsUs, int tid, int connection)
+{
+	out += out.empty() ? "{\"traceEvents\":[\n" : ",\n";
+	out += "{\"ph\":\"";
+	out += ph;
+	out += "\",\"cat\":\"request\",\"name\":\"";
+	out += name;
+	out += "\",\"id\":";
+	appendNumber(out, id);
+	out += ",\"ts\":";
+	appendMicros(out, tsUs);
+	out += ",\"pid\":";
+	appendNumber(out, ::getpid());
+	out += ",\"tid\":";
+	appendNumber(out, tid);
+	if (*ph == 'i')
+	{
+		out += ",\"s\":\"t\"";
+	}
+	if (*ph != 'e')
+	{
+		out += ",\"args\":{\"connection\":";
+		appendNumber(out, connection);
+		out += '}';
+	}
+	out += '}';
+}
+} // namespace
+
+// Events of one thread, oldest overwritten first. Only the owning thread writes; a slot's
+// sequence is odd while it is being written, so a reader can tell a torn copy from a whole one.
+class RequestTracer::ThreadRing
+{
+public:
+	ThreadRing()
+		: m_slots(new Slot[ringCapacity]), m_tid(static_cast<int>(::gettid()))
+	{
+	}
+
+	void write(uint64_t id, TraceStage stage, int connection, uint64_t ticks)
+	{
+		Slot& slot = m_slots[m_next % ringCapacity];
+		const uint64_t sequence = 2 * (m_next / ringCapacity) + 2;
+		slot.sequence.store(sequence - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.id.store(id, std::memory_order_relaxed);
+		slot.ticks.store(ticks, std::memory_order_relaxed);
+		slot.detail.store(static_cast<uint64_t>(stage) << 32 | static_cast<uint32_t>(connection), std::memory_order_relaxed);
+		slot.sequence.store(sequence, std::memory_order_release);
+		++m_next;
+	}
+
+	void collect(std::vector<Event>& out) const
+	{
+		for (size_t i = 0; i < ringCapacity; ++i)
+		{
+			const Slot& slot = m_slots[i];
+			const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+			if (before == 0 || before % 2 != 0)
+			{
+				continue;
+			}
+			const uint64_t id = slot.id.load(std::memory_order_relaxed);
+			const uint64_t ticks = slot.ticks.load(std::memory_order_relaxed);
+			const uint64_t detail = slot.detail.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != before)
+			{
+				continue;
+			}
+			out.push_back({ id, ticks, static_cast<TraceStage>(detail >> 32), static_cast<int>(static_cast<uint32_t>(detail)), m_tid });
+		}
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence = 0;
+		std::atomic<uint64_t> id = 0;
+		std::atomic<uint64_t> ticks = 0;
+		// Stage in the high half, connection in the low half
+		std::atomic<uint64_t> detail = 0;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	const int m_tid;
+	uint64_t m_next = 0;
+};
+
+RequestTracer& RequestTracer::instance()
+{
+	static RequestTracer tracer;
+	return tracer;
+}
+
+RequestTracer::RequestTracer()
+	: m_startTicks(traceTicks()), m_startTime(std::chrono::steady_clock::now())
+{
+}
+
+void RequestTracer::setSampling(uint32_t sampleEvery)
+{
+	m_sampleEvery.store(sampleEvery, std::memory_order_relaxed);
+}
+
+RequestTracer::ThreadRing& RequestTracer::localRing()
+{
+	// Rings outlive their threads: the events of a finished thread are still worth a dump
+	thread_local std::shared_ptr<ThreadRing> ring;
+	if (!ring)
+	{
+		ring = std::make_shared<ThreadRing>();
+		std::lock_guard lock(m_ringsMutex);
+		m_rings.push_back(ring);
+	}
+	return *ring;
+}
+
+void RequestTracer::write(uint64_t id, TraceStage stage, int connection, uint64_t ticks)
+{
+	localRing().write(id, stage, connection, ticks);
+}
+
+double RequestTracer::ticksPerUs() const
+{
+	const uint64_t ticks = traceTicks() - m_startTicks;
+	const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+	return us > 0 && ticks > 0 ? static_cast<double>(ticks) / us : 1000.0;
+}
+
+bool RequestTracer::dump(const std::string& path)
+{
+	std::vector<Event> events;
+	{
+		std::lock_guard lock(m_ringsMutex);
+		for (const auto& ring: m_rings)
+		{
+			ring->collect(events);
+		}
+	}
+
+	// Stages of a request come from several threads; their order is the order of the stages
+	std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+		return a.id != b.id ? a.id < b.id : a.stage < b.stage;
+	});
+
+	const double perUs = ticksPerUs();
+	const auto toUs = [&](uint64_t ticks) {
+		return static_cast<double>(static_cast<int64_t>(ticks - m_startTicks)) / perUs;
+	};
+
+	std::string out;
+	for (size_t first = 0; first < events.size();)
+	{
+		size_t last = first;
+		while (last + 1 < events.size() && events[last + 1].id == events[first].id)
+		{
+			++last;
+		}
+
+		const Event& head = events[first];
+		if (first == last)
+		{
+			// An accepted connection, or a request whose other stages the rings no longer hold
+			appendEvent(out, "i", stageName(head.stage), head.id, toUs(head.ticks), head.tid, head.connection);
+		}
+		else
+		{
+			appendEvent(out, "b", "request", head.id, toUs(head.ticks), head.tid, head.connection);
+			for (size_t i = first; i < last; ++i)
+			{
+				// Each span is named after the stages that bound it and drawn on the thread it starts on
+				const std::string name = std::string(stageName(events[i].stage)) + " -> " + stageName(events[i + 1].stage);
+				appendEvent(out, "b", name, head.id, toUs(events[i].ticks), events[i].tid, head.connection);
+				appendEvent(out, "e", name, head.id, toUs(events[i + 1].ticks), events[i].tid, head.connection);
+			}
+			appendEvent(out, "e", "request", head.id, toUs(events[last].ticks), head.tid, head.connection);
+		}
+		first = last + 1;
+	}
+	out += out.empty() ? "{\"traceEvents\":[]}\n" : "\n]}\n";
+
+	std::ofstream file(path, std::ios::trunc);
+	file << out;
+	return static_cast<bool>(file.flush());
+}
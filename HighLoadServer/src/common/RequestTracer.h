@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Points in the life of a request, in the order it passes them
+enum class TraceStage : uint8_t
+{
+	Accept,
+	ReadComplete,
+	Enqueue,
+	Dequeue,
+	HandlerStart,
+	HandlerEnd,
+	WriteComplete
+};
+
+// Timestamp cheap enough for every stage of a request: the TSC where there is one, which
+// the dump converts to time, and the steady clock in nanoseconds elsewhere
+inline uint64_t traceTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Per-request lifecycle tracing. One request in every sampleEvery gets a trace id, and the
+// reactors and workers record a timestamp for it at each TraceStage; so does one accepted
+// connection in sampleEvery. Every thread writes into its own fixed ring of recent events,
+// overwriting the oldest, without locks or allocation; dump() reads the rings from another
+// thread (each slot is a seqlock, so a torn event is skipped) and writes what they hold as
+// Chrome trace event JSON, one async track per request, for chrome://tracing or Perfetto.
+// Off until setSampling() is called; when off, sample() is a single relaxed load.
+class RequestTracer
+{
+public:
+	static RequestTracer& instance();
+
+	RequestTracer(const RequestTracer&) = delete;
+	RequestTracer& operator=(const RequestTracer&) = delete;
+
+	// 0 turns tracing off
+	void setSampling(uint32_t sampleEvery);
+	[[nodiscard]] bool isEnabled() const
+	{
+		return m_sampleEvery.load(std::memory_order_relaxed) != 0;
+	}
+
+	// Trace id for a new request or connection; 0 when it is not sampled
+	uint64_t sample()
+	{
+		const uint32_t every = m_sampleEvery.load(std::memory_order_relaxed);
+		if (every == 0)
+		{
+			return 0;
+		}
+		thread_local uint32_t countdown = 0;
+		if (countdown > 0)
+		{
+			--countdown;
+			return 0;
+		}
+		countdown = every - 1;
+		return m_nextId.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// connection identifies the socket in the trace (its fd); a request shows the one given
+	// with its earliest stage. ticks 0 means now, read only for a sampled request, so that
+	// the rest pay nothing but the id check.
+	void record(uint64_t id, TraceStage stage, int connection = -1, uint64_t ticks = 0)
+	{
+		if (id != 0)
+		{
+			write(id, stage, connection, ticks != 0 ? ticks : traceTicks());
+		}
+	}
+
+	// Writes the events the rings hold now; false when path cannot be written
+	bool dump(const std::string& path);
+
+private:
+	class ThreadRing;
+
+	RequestTracer();
+
+	void write(uint64_t id, TraceStage stage, int connection, uint64_t ticks);
+	ThreadRing& localRing();
+	// TSC ticks per microsecond, measured between construction and now
+	double ticksPerUs() const;
+
+	std::atomic<uint32_t> m_sampleEvery = 0;
+	std::atomic<uint64_t> m_nextId = 1;
+
+	const uint64_t m_startTicks;
+	const std::chrono::steady_clock::time_point m_startTime;
+
+	std::mutex m_ringsMutex;
+	std::vector<std::shared_ptr<ThreadRing>> m_rings;
+};
+
+// Sampled requests of one connection whose responses have not been written yet. A reactor
+// adds a request as it reserves its sequence number and calls written() whenever its send
+// queue has drained, which completes every request the sequencer has released by then.
+class TracedResponses
+{
+public:
+	void add(uint64_t sequence, uint64_t id)
+	{
+		m_pending.push_back({ sequence, id });
+	}
+
+	void written(uint64_t released)
+	{
+		if (m_pending.empty())
+		{
+			return;
+		}
+		const uint64_t ticks = traceTicks();
+		size_t done = 0;
+		for (; done < m_pending.size() && m_pending[done].sequence < released; ++done)
+		{
+			RequestTracer::instance().record(m_pending[done].id, TraceStage::WriteComplete, -1, ticks);
+		}
+		m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<ptrdiff_t>(done));
+	}
+
+private:
+	struct Pending
+	{
+		uint64_t sequence;
+		uint64_t id;
+	};
+
+	std::vector<Pending> m_pending;
+};
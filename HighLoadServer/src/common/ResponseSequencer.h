@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+
+// Numbers pipelined requests of one connection and releases their responses in that order,
+// however the worker pool happens to complete them.
+class ResponseSequencer
+{
+public:
+	uint64_t reserve()
+	{
+		return m_nextRequest++;
+	}
+
+	// Stores a response and passes every response that is now in order to onReady
+	template <typename Callback>
+	void complete(uint64_t sequence, std::string response, Callback&& onReady)
+	{
+		if (sequence == m_nextResponse && m_pending.empty())
+		{
+			// In order, as every inline response is: nothing to hold back
+			++m_nextResponse;
+			onReady(std::move(response));
+			return;
+		}
+
+		const size_t index = sequence - m_nextResponse;
+		if (m_pending.size() <= index)
+		{
+			m_pending.resize(index + 1);
+		}
+		m_pending[index] = std::move(response);
+
+		while (!m_pending.empty() && m_pending.front())
+		{
+			std::string ready = std::move(*m_pending.front());
+			m_pending.pop_front();
+			++m_nextResponse;
+			onReady(std::move(ready));
+		}
+	}
+
+	// Requests whose responses have been released so far: sequence numbers below this
+	[[nodiscard]] uint64_t released() const
+	{
+		return m_nextResponse;
+	}
+
+	// Every reserved request has been answered
+	[[nodiscard]] bool idle() const
+	{
+		return m_nextRequest == m_nextResponse;
+	}
+
+private:
+	uint64_t m_nextRequest = 0;
+	uint64_t m_nextResponse = 0;
+	std::deque<std::optional<std::string>> m_pending;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Reference to a SlotTable entry that survives the slot being reused: every emplace bumps
+// the slot's generation, so a handle taken before the reuse no longer resolves.
+struct SlotHandle
+{
+	// Never handed out, so that packed values with it are free for the caller's own tokens.
+	// Generation 0 is not either: a default handle resolves to nothing.
+	static constexpr uint32_t reservedGeneration = UINT32_MAX;
+
+	uint32_t slot = 0;
+	uint32_t generation = 0;
+
+	[[nodiscard]] constexpr uint64_t pack() const
+	{
+		return (static_cast<uint64_t>(generation) << 32) | slot;
+	}
+
+	static constexpr SlotHandle unpack(uint64_t packed)
+	{
+		return { static_cast<uint32_t>(packed), static_cast<uint32_t>(packed >> 32) };
+	}
+
+	bool operator==(const SlotHandle&) const = default;
+};
+
+// Flat table of objects indexed by a small integer key (a file descriptor). Values are
+// constructed in place inside fixed-size chunks, so they never move and need no
+// per-object heap allocation; lookups are two array indexations instead of a hash probe.
+template <typename T, size_t ChunkSize = 1024>
+class SlotTable
+{
+public:
+	SlotTable() = default;
+
+	SlotTable(const SlotTable&) = delete;
+	SlotTable& operator=(const SlotTable&) = delete;
+
+	// The slot must be free
+	template <typename... Args>
+	std::pair<SlotHandle, T&> emplace(uint32_t slot, Args&&... args)
+	{
+		Slot& entry = slotAt(slot);
+		if (++entry.generation == SlotHandle::reservedGeneration)
+		{
+			entry.generation = 1;
+		}
+		entry.value.emplace(std::forward<Args>(args)...);
+		++m_size;
+		return { SlotHandle{ slot, entry.generation }, *entry.value };
+	}
+
+	T* get(SlotHandle handle)
+	{
+		Slot* entry = findSlot(handle.slot);
+		if (!entry || !entry->value || entry->generation != handle.generation)
+		{
+			return nullptr;
+		}
+		return &*entry->value;
+	}
+
+	void erase(SlotHandle handle)
+	{
+		Slot* entry = findSlot(handle.slot);
+		if (entry && entry->value && entry->generation == handle.generation)
+		{
+			entry->value.reset();
+			--m_size;
+		}
+	}
+
+	[[nodiscard]] size_t size() const
+	{
+		return m_size;
+	}
+
+	[[nodiscard]] bool empty() const
+	{
+		return m_size == 0;
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t generation = 0;
+		std::optional<T> value;
+	};
+	using Chunk = std::array<Slot, ChunkSize>;
+
+	Slot* findSlot(uint32_t slot)
+	{
+		const size_t chunk = slot / ChunkSize;
+		if (chunk >= m_chunks.size() || !m_chunks[chunk])
+		{
+			return nullptr;
+		}
+		return &(*m_chunks[chunk])[slot % ChunkSize];
+	}
+
+	Slot& slotAt(uint32_t slot)
+	{
+		const size_t chunk = slot / ChunkSize;
+		if (chunk >= m_chunks.size())
+		{
+			m_chunks.resize(chunk + 1);
+		}
+		if (!m_chunks[chunk])
+		{
+			m_chunks[chunk] = std::make_unique<Chunk>();
+		}
+		return (*m_chunks[chunk])[slot % ChunkSize];
+	}
+
+	std::vector<std::unique_ptr<Chunk>> m_chunks;
+	size_t m_size = 0;
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Move-only callable the worker pools queue instead of std::function<void()>. Callables of
+// up to inlineSize bytes that move without throwing are stored in the Task itself, so
+// queueing them allocates nothing; larger ones are moved to the heap. Unlike std::function
+// the callable need not be copyable, so it may own move-only state.
+class Task
+{
+public:
+	// Fits the per-request tasks of the reactors (request and response buffers, a connection
+	// handle, a sequence number, a trace id and a timestamp), and makes a Task two cache lines
+	static constexpr size_t inlineSize = 120;
+
+	template <typename F>
+	static constexpr bool storedInline = sizeof(F) <= inlineSize
+		&& alignof(F) <= alignof(std::max_align_t)
+		&& std::is_nothrow_move_constructible_v<F>;
+
+	Task() noexcept = default;
+
+	template <typename F>
+		requires(!std::is_same_v<std::decay_t<F>, Task> && std::is_invocable_r_v<void, std::decay_t<F>&>)
+	Task(F&& callable)
+	{
+		using Fn = std::decay_t<F>;
+		if constexpr (storedInline<Fn>)
+		{
+			::new (static_cast<void*>(m_storage)) Fn(std::forward<F>(callable));
+		}
+		else
+		{
+			::new (static_cast<void*>(m_storage)) Fn*(new Fn(std::forward<F>(callable)));
+		}
+		m_ops = &opsFor<Fn>;
+	}
+
+	Task(Task&& other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			moveFrom(other);
+		}
+		return *this;
+	}
+
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		reset();
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_ops != nullptr;
+	}
+
+	void operator()()
+	{
+		m_ops->invoke(m_storage);
+	}
+
+	void reset() noexcept
+	{
+		if (m_ops)
+		{
+			m_ops->destroy(m_storage);
+			m_ops = nullptr;
+		}
+	}
+
+	// The stored callable when it is an F, like std::function::target
+	template <typename F>
+	F* target() noexcept
+	{
+		return m_ops == &opsFor<F> ? get<F>(m_storage) : nullptr;
+	}
+
+private:
+	struct Ops
+	{
+		void (*invoke)(void* storage);
+		void (*move)(void* to, void* from) noexcept;
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template <typename Fn>
+	static Fn* get(void* storage) noexcept
+	{
+		if constexpr (storedInline<Fn>)
+		{
+			return std::launder(static_cast<Fn*>(storage));
+		}
+		else
+		{
+			return *std::launder(static_cast<Fn**>(storage));
+		}
+	}
+
+	template <typename Fn>
+	static constexpr Ops opsFor = {
+		[](void* storage) { (*get<Fn>(storage))(); },
+		[](void* to, void* from) noexcept {
+			if constexpr (storedInline<Fn>)
+			{
+				::new (to) Fn(std::move(*get<Fn>(from)));
+				get<Fn>(from)->~Fn();
+			}
+			else
+			{
+				::new (to) Fn*(get<Fn>(from));
+			}
+		},
+		[](void* storage) noexcept {
+			if constexpr (storedInline<Fn>)
+			{
+				get<Fn>(storage)->~Fn();
+			}
+			else
+			{
+				delete get<Fn>(storage);
+			}
+		},
+	};
+
+	void moveFrom(Task& other) noexcept
+	{
+		if (other.m_ops)
+		{
+			other.m_ops->move(m_storage, other.m_storage);
+			m_ops = std::exchange(other.m_ops, nullptr);
+		}
+	}
+
+	alignas(std::max_align_t) std::byte m_storage[inlineSize];
+	const Ops* m_ops = nullptr;
+};
+
+// Result of a task handed to Executor::submit(). get() waits for the task to run, then
+// returns its result or rethrows what it threw. A task the pool drops without running
+// (the pool was shutting down) fails with std::future_errc::broken_promise.
+template <typename R>
+class TaskHandle
+{
+	struct Empty
+	{
+	};
+	using Stored = std::conditional_t<std::is_void_v<R>, Empty, R>;
+
+	struct State
+	{
+		std::atomic<bool> ready{ false };
+		std::optional<Stored> value;
+		std::exception_ptr error;
+
+		void finish()
+		{
+			ready.store(true, std::memory_order_release);
+			ready.notify_all();
+		}
+	};
+
+	// Owned by the queued task; settles the state once, whether or not the task ran
+	class Promise
+	{
+	public:
+		explicit Promise(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+		Promise(Promise&&) noexcept = default;
+		Promise& operator=(Promise&&) noexcept = default;
+
+		~Promise()
+		{
+			if (m_state)
+			{
+				m_state->error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+				m_state->finish();
+			}
+		}
+
+		template <typename F>
+		void run(F& callable)
+		{
+			try
+			{
+				if constexpr (std::is_void_v<R>)
+				{
+					callable();
+					m_state->value.emplace();
+				}
+				else
+				{
+					m_state->value.emplace(callable());
+				}
+			}
+			catch (...)
+			{
+				m_state->error = std::current_exception();
+			}
+			std::exchange(m_state, nullptr)->finish();
+		}
+
+	private:
+		std::shared_ptr<State> m_state;
+	};
+
+public:
+	template <typename F>
+	static std::pair<Task, TaskHandle> make(F&& callable)
+	{
+		auto state = std::make_shared<State>();
+		TaskHandle handle(state);
+		Task task = [promise = Promise(std::move(state)), callable = std::forward<F>(callable)]() mutable {
+			promise.run(callable);
+		};
+		return { std::move(task), std::move(handle) };
+	}
+
+	[[nodiscard]] bool ready() const
+	{
+		return m_state->ready.load(std::memory_order_acquire);
+	}
+
+	void wait() const
+	{
+		m_state->ready.wait(false, std::memory_order_acquire);
+	}
+
+	R get()
+	{
+		wait();
+		if (m_state->error)
+		{
+			std::rethrow_exception(m_state->error);
+		}
+		if constexpr (!std::is_void_v<R>)
+		{
+			return std::move(*m_state->value);
+		}
+	}
+
+private:
+	explicit TaskHandle(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+	std::shared_ptr<State> m_state;
+};
@@ -1,59 +1,355 @@
 #include "ThreadPool.h"
+#include "CpuAffinity.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <pthread.h>
+#include <time.h>
 
-ThreadPool::ThreadPool(size_t numThreads)
+namespace
 {
+// Workers busier than this, with tasks waiting longer than the target, ask for more workers
+constexpr double growBusy = 0.85;
+// Workers idler than this, with tasks not waiting, ask for fewer
+constexpr double shrinkBusy = 0.5;
+// Beyond this share of the CPUs, more workers only take turns on them
+constexpr double cpuSaturation = 0.9;
+// Intervals in a row a resize has to be asked for, and to wait after one
+constexpr size_t stableIntervals = 3;
+
+std::optional<std::chrono::nanoseconds> threadCpuTime(std::jthread& thread)
+{
+	clockid_t clock{};
+	timespec time{};
+	if (pthread_getcpuclockid(thread.native_handle(), &clock) != 0 || clock_gettime(clock, &time) != 0)
+	{
+		return std::nullopt;
+	}
+	return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+} // namespace
+
+ThreadPool::ThreadPool(size_t numThreads, size_t queueCapacity, std::vector<int> cpus, PoolSizing sizing)
+	: m_capacity(queueCapacity == 0 ? SIZE_MAX : queueCapacity)
+	, m_cpus(std::move(cpus))
+	, m_sizing(std::move(sizing))
+	, m_cores(m_cpus.empty() ? std::max(1u, std::thread::hardware_concurrency()) : m_cpus.size())
+{
+	if (m_sizing.isElastic())
+	{
+		const size_t minThreads = std::max<size_t>(m_sizing.minThreads, 1);
+		numThreads = std::clamp(numThreads, minThreads, std::max(m_sizing.maxThreads, minThreads));
+	}
 	if (numThreads == 0)
 	{
 		numThreads = 1;
 	}
 
-	m_threads.reserve(numThreads);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_workers.reserve(numThreads);
 	for (size_t i = 0; i < numThreads; ++i)
 	{
-		m_threads.emplace_back([this] {
-			while (true)
-			{
-				std::function<void()> task;
-				{
-					std::unique_lock<std::mutex> lock(m_mutex);
-					m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
-
-					if (m_stop && m_tasks.empty())
-					{
-						break;
-					}
-
-					task = std::move(m_tasks.front());
-					m_tasks.pop();
-				}
-				if (task)
-				{
-					task();
-				}
-			}
-		});
+		startWorker();
+	}
+
+	if (m_sizing.isElastic())
+	{
+		m_intervalStart = Clock::now();
+		m_controller = std::jthread([this](std::stop_token stop) { control(stop); });
 	}
 }
 
 ThreadPool::~ThreadPool()
 {
+	if (m_controller.joinable())
+	{
+		m_controller.request_stop();
+		m_controller.join();
+	}
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
 		m_stop = true;
 	}
 	m_cv.notify_all();
+	m_notFull.notify_all();
+	// Joined here, while the queue and its lock still exist
+	for (auto& worker: m_workers)
+	{
+		worker->thread.join();
+	}
+}
+
+void ThreadPool::startWorker()
+{
+	const int cpu = m_cpus.empty() ? -1 : m_cpus[m_nextCpu++ % m_cpus.size()];
+	Worker& worker = *m_workers.emplace_back(std::make_unique<Worker>());
+	worker.thread = std::jthread([this, &worker, cpu] { work(worker, cpu); });
+	m_threadCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::work(Worker& self, int cpu)
+{
+	if (cpu >= 0)
+	{
+		pinCurrentThread(cpu);
+	}
+
+	const bool elastic = m_sizing.isElastic();
+	Clock::time_point finishedAt;
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (self.running)
+			{
+				// The control thread may have counted part of the task already
+				m_busy += std::max(Clock::duration::zero(), finishedAt - self.countedFrom);
+				self.running = false;
+			}
+
+			m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty() || m_retiring > 0; });
+
+			if (m_retiring > 0 && !m_stop)
+			{
+				// Retires before its next task, so that a pool shrunk under load does shrink;
+				// the workers that stay pick up what is queued
+				--m_retiring;
+				self.exited = true;
+				break;
+			}
+			if (m_tasks.empty())
+			{
+				// Stopping with nothing left to do
+				break;
+			}
+
+			QueuedTask next = m_tasks.pop();
+			task = std::move(next.task);
+			if (elastic)
+			{
+				const auto now = Clock::now();
+				m_waited += now - next.enqueuedAt;
+				++m_started;
+				self.running = true;
+				self.countedFrom = now;
+			}
+		}
+		if (m_capacity != SIZE_MAX)
+		{
+			m_notFull.notify_one();
+		}
+		if (task)
+		{
+			task();
+		}
+		if (elastic)
+		{
+			finishedAt = Clock::now();
+		}
+	}
 }
 
-void ThreadPool::enqueue(std::function<void()> task)
+void ThreadPool::control(std::stop_token stop)
 {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_controlCv.wait_for(lock, stop, m_sizing.interval, [] { return false; });
+		if (stop.stop_requested())
+		{
+			return;
+		}
+
+		const auto resize = adjust(Clock::now());
+		if (resize && m_sizing.onResize)
+		{
+			lock.unlock();
+			m_sizing.onResize(*resize);
+			lock.lock();
+		}
+	}
+}
+
+std::optional<PoolResize> ThreadPool::adjust(Clock::time_point now)
+{
+	// Retired workers have left the loop; the CPU time of their last interval goes uncounted
+	std::erase_if(m_workers, [](const std::unique_ptr<Worker>& worker) {
+		if (!worker->exited)
+		{
+			return false;
+		}
+		worker->thread.join();
+		return true;
+	});
+
+	Clock::duration busy = m_busy;
+	std::chrono::nanoseconds cpu{};
+	for (auto& worker: m_workers)
+	{
+		if (worker->running)
+		{
+			busy += now - worker->countedFrom;
+			worker->countedFrom = now;
+		}
+		if (const auto total = threadCpuTime(worker->thread))
+		{
+			cpu += *total - worker->lastCpuTime;
+			worker->lastCpuTime = *total;
+		}
+	}
+
+	// Workers that all block leave tasks queued without picking any up, so the oldest
+	// queued task counts as well
+	Clock::duration wait = m_started != 0 ? m_waited / static_cast<Clock::rep>(m_started) : Clock::duration::zero();
+	m_tasks.forEachFront([&](const QueuedTask& queued) { wait = std::max(wait, now - queued.enqueuedAt); });
+
+	const double seconds = std::chrono::duration<double>(now - m_intervalStart).count();
+	const double busySeconds = std::chrono::duration<double>(busy).count();
+	// Workers the arriving tasks keep busy (Little's law), once some have finished to tell
+	// how long a task takes; 0 when none has
+	const double demand = m_started != 0 ? static_cast<double>(m_arrived) / seconds * busySeconds / static_cast<double>(m_started) : 0;
+	m_intervalStart = now;
+	m_busy = {};
+	m_waited = {};
+	m_started = 0;
+	m_arrived = 0;
+
+	const size_t current = m_threadCount.load(std::memory_order_relaxed);
+	if (seconds <= 0 || current == 0)
+	{
+		return std::nullopt;
+	}
+	const double busyWorkers = busySeconds / seconds;
+	const double busyRatio = busyWorkers / static_cast<double>(current);
+	const double cpus = std::chrono::duration<double>(cpu).count() / seconds;
+	const bool saturated = cpus >= cpuSaturation * static_cast<double>(m_cores);
+	const bool waiting = wait > m_sizing.targetWait;
+	const size_t minThreads = std::max<size_t>(m_sizing.minThreads, 1);
+
+	int want = 0;
+	if (waiting && busyRatio > growBusy && !saturated && current < m_sizing.maxThreads)
+	{
+		want = 1;
+	}
+	else if (((busyRatio < shrinkBusy && !waiting) || (saturated && current > m_cores)) && current > minThreads)
+	{
+		want = -1;
+	}
+
+	m_trendLength = want != 0 && want == m_trend ? m_trendLength + 1 : 1;
+	m_trend = want;
+	if (want == 0 || m_trendLength < stableIntervals)
+	{
+		return std::nullopt;
+	}
+	m_trendLength = 0;
+
+	size_t target = 0;
+	if (want > 0)
+	{
+		// Enough workers for the demand to keep them below growBusy, but no more than the
+		// CPU each busy worker took leaves room for; doubling while no task finishes
+		double wanted = demand > 0 ? demand / growBusy : 2.0 * static_cast<double>(current);
+		if (busyWorkers > 0 && cpus > 0)
+		{
+			wanted = std::min(wanted, cpuSaturation * static_cast<double>(m_cores) * busyWorkers / cpus);
+		}
+		target = std::clamp(static_cast<size_t>(std::ceil(wanted)), current + 1, m_sizing.maxThreads);
+		while (m_threadCount.load(std::memory_order_relaxed) < target)
+		{
+			startWorker();
+		}
+	}
+	else
+	{
+		// Surplus workers on saturated CPUs go at once; idle ones a quarter at a time, down to
+		// what keeps the rest between the two thresholds
+		const size_t floor = saturated && current > m_cores
+			? m_cores
+			: std::max(static_cast<size_t>(std::ceil(busyWorkers / ((growBusy + shrinkBusy) / 2))), current - std::max<size_t>(1, current / 4));
+		target = std::clamp(floor, minThreads, current - 1);
+		m_retiring += current - target;
+		m_threadCount.store(target, std::memory_order_relaxed);
+		m_cv.notify_all();
+	}
+
+	return PoolResize{ current, target, std::chrono::duration_cast<std::chrono::microseconds>(wait), busyRatio, cpus };
+}
+
+void ThreadPool::enqueue(Task task, TaskTag tag)
+{
+	const auto enqueuedAt = m_sizing.isElastic() ? Clock::now() : Clock::time_point{};
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_stop || m_tasks.size() < m_capacity; });
 		if (m_stop)
 		{
 			return;
 		}
-		m_tasks.push(std::move(task));
+		m_tasks.push({ std::move(task), enqueuedAt }, tag);
+		++m_arrived;
 	}
 	m_cv.notify_one();
+}
+
+EnqueueResult ThreadPool::tryEnqueue(Task& task, TaskTag tag)
+{
+	const auto enqueuedAt = m_sizing.isElastic() ? Clock::now() : Clock::time_point{};
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_stop)
+		{
+			return EnqueueResult::Dropped;
+		}
+		if (m_tasks.size() >= m_capacity)
+		{
+			return EnqueueResult::Full;
+		}
+		m_tasks.push({ std::move(task), enqueuedAt }, tag);
+		++m_arrived;
+	}
+	m_cv.notify_one();
+	return EnqueueResult::Queued;
+}
+
+void ThreadPool::enqueueBulk(std::span<Task> tasks)
+{
+	const auto enqueuedAt = m_sizing.isElastic() ? Clock::now() : Clock::time_point{};
+	size_t next = 0;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (next < tasks.size())
+		{
+			// Only a bounded queue that fills up lets go of the lock in between
+			m_notFull.wait(lock, [this] { return m_stop || m_tasks.size() < m_capacity; });
+			if (m_stop)
+			{
+				return;
+			}
+			for (; next < tasks.size() && m_tasks.size() < m_capacity; ++next)
+			{
+				m_tasks.push({ std::move(tasks[next]), enqueuedAt }, {});
+				++m_arrived;
+			}
+			if (next < tasks.size())
+			{
+				m_cv.notify_all();
+			}
+		}
+	}
+	if (tasks.size() == 1)
+	{
+		m_cv.notify_one();
+	}
+	else if (!tasks.empty())
+	{
+		m_cv.notify_all();
+	}
+}
+
+size_t ThreadPool::getThreadCount() const
+{
+	return m_threadCount.load(std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -1,28 +1,91 @@
 #pragma once
 
 #include <vector>
-#include <queue>
 #include <thread>
-#include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include "Executor.h"
+#include "FairQueue.h"
 
-class ThreadPool
+class ThreadPool : public Executor
 {
 public:
-	explicit ThreadPool(size_t numThreads = std::thread::hardware_concurrency());
-	~ThreadPool();
+	// queueCapacity bounds the tasks waiting for a worker; 0 means unbounded. Worker i is
+	// pinned to cpus[i % cpus.size()] unless cpus is empty. An elastic sizing starts the pool
+	// at numThreads workers, kept within its bounds, and has a control thread resize it.
+	// Tasks queue by their tags (see FairQueue); untagged ones go in one FIFO.
+	explicit ThreadPool(size_t numThreads = std::thread::hardware_concurrency(), size_t queueCapacity = 0, std::vector<int> cpus = {},
+		PoolSizing sizing = {});
+	~ThreadPool() override;
 
 	ThreadPool(const ThreadPool&) = delete;
 	ThreadPool& operator=(const ThreadPool&) = delete;
 
-	void enqueue(std::function<void()> task);
+	void enqueue(Task task, TaskTag tag = {}) override;
+	EnqueueResult tryEnqueue(Task& task, TaskTag tag = {}) override;
+	void enqueueBulk(std::span<Task> tasks) override;
+	size_t getThreadCount() const override;
 
 private:
-	std::vector<std::jthread> m_threads;
-	std::queue<std::function<void()>> m_tasks;
+	using Clock = std::chrono::steady_clock;
+
+	struct QueuedTask
+	{
+		Task task;
+		// Only stamped when the pool is elastic
+		Clock::time_point enqueuedAt;
+	};
+
+	struct Worker
+	{
+		std::jthread thread;
+		// The rest is guarded by m_mutex. While a task runs, the busy time since countedFrom
+		// has not been added to m_busy yet.
+		bool running = false;
+		Clock::time_point countedFrom;
+		bool exited = false;
+		std::chrono::nanoseconds lastCpuTime{};
+	};
+
+	void startWorker();
+	void work(Worker& self, int cpu);
+	void control(std::stop_token stop);
+	// Measures the interval that just ended and resizes the pool if it has been asking for
+	// that long enough; m_mutex held
+	std::optional<PoolResize> adjust(Clock::time_point now);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	FairQueue<QueuedTask> m_tasks;
 	std::mutex m_mutex;
 	std::condition_variable m_cv;
+	std::condition_variable m_notFull;
+	size_t m_capacity;
 	std::atomic<bool> m_stop{false};
+
+	const std::vector<int> m_cpus;
+	size_t m_nextCpu = 0;
+	std::atomic<size_t> m_threadCount{0};
+
+	// Elastic sizing; the measurements are guarded by m_mutex and cover the current interval
+	const PoolSizing m_sizing;
+	// CPUs the workers can run on
+	const size_t m_cores;
+	// Workers asked to exit that have not yet
+	size_t m_retiring = 0;
+	Clock::time_point m_intervalStart;
+	Clock::duration m_busy{};
+	Clock::duration m_waited{};
+	size_t m_started = 0;
+	size_t m_arrived = 0;
+	// Consecutive intervals that asked for the same resize: +1 grow, -1 shrink
+	int m_trend = 0;
+	size_t m_trendLength = 0;
+	std::condition_variable_any m_controlCv;
+	std::jthread m_controller;
 };
\ No newline at end of file
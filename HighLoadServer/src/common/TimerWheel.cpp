@@ -0,0 +1,133 @@
+#include "TimerWheel.h"
+
+TimerWheel::Timer::~Timer()
+{
+	unlink();
+}
+
+void TimerWheel::Timer::unlink()
+{
+	if (!m_next)
+	{
+		return;
+	}
+
+	m_prev->m_next = m_next;
+	m_next->m_prev = m_prev;
+	m_prev = nullptr;
+	m_next = nullptr;
+
+	if (m_wheel)
+	{
+		--m_wheel->m_armedCount;
+		m_wheel = nullptr;
+	}
+}
+
+void TimerWheel::Timer::linkBefore(Timer& head)
+{
+	m_next = &head;
+	m_prev = head.m_prev;
+	head.m_prev->m_next = this;
+	head.m_prev = this;
+}
+
+TimerWheel::TimerWheel(Clock::duration tick, size_t slotCount)
+	: m_tick(tick)
+	, m_slotCount(slotCount == 0 ? 1 : slotCount)
+	, m_slots(new Timer[m_slotCount])
+	, m_start(Clock::now())
+{
+	for (size_t i = 0; i < m_slotCount; ++i)
+	{
+		makeHead(m_slots[i]);
+	}
+}
+
+TimerWheel::~TimerWheel()
+{
+	// Detach timers that outlive the wheel so their destructors do not touch it
+	for (size_t i = 0; i < m_slotCount; ++i)
+	{
+		Timer& head = m_slots[i];
+		for (Timer* timer = head.m_next; timer != &head;)
+		{
+			Timer* next = timer->m_next;
+			timer->m_prev = nullptr;
+			timer->m_next = nullptr;
+			timer->m_wheel = nullptr;
+			timer = next;
+		}
+		head.m_prev = nullptr;
+		head.m_next = nullptr;
+	}
+}
+
+void TimerWheel::makeHead(Timer& head)
+{
+	head.m_prev = &head;
+	head.m_next = &head;
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point time) const
+{
+	if (time <= m_start)
+	{
+		return 0;
+	}
+	return static_cast<uint64_t>((time - m_start) / m_tick);
+}
+
+TimerWheel::Timer& TimerWheel::slotFor(uint64_t tick) const
+{
+	return m_slots[tick % m_slotCount];
+}
+
+void TimerWheel::arm(Timer& timer, Clock::time_point deadline)
+{
+	timer.unlink();
+
+	// Round up so a timer never fires before its deadline
+	uint64_t tick = tickOf(deadline);
+	if (deadline > m_start && m_start + tick * m_tick < deadline)
+	{
+		++tick;
+	}
+	tick = std::max(tick, m_currentTick);
+
+	timer.m_expiryTick = tick;
+	timer.linkBefore(slotFor(tick));
+	timer.m_wheel = this;
+	++m_armedCount;
+}
+
+void TimerWheel::cancel(Timer& timer)
+{
+	timer.unlink();
+}
+
+int TimerWheel::nextTimeoutMs(Clock::time_point now) const
+{
+	if (m_armedCount == 0)
+	{
+		return -1;
+	}
+
+	// The first occupied slot bounds the next expiry from below; timers hashed there for a
+	// later revolution only cause an early, harmless wakeup.
+	for (size_t i = 0; i < m_slotCount; ++i)
+	{
+		const uint64_t tick = m_currentTick + i;
+		const Timer& head = slotFor(tick);
+		if (head.m_next != &head)
+		{
+			const auto slotDue = m_start + tick * m_tick;
+			if (slotDue <= now)
+			{
+				return 0;
+			}
+			return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(slotDue - now).count());
+		}
+	}
+	return -1;
+}
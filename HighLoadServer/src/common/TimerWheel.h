@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// Hashed timing wheel with intrusive timers: arm, re-arm and cancel are O(1) list splices,
+// and each tick only visits the timers hashed into its slot. Timers are embedded in the
+// objects they guard (connection state etc.) and unlink themselves when destroyed, so an
+// owner may be freed from inside an expiry callback.
+class TimerWheel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	class Timer
+	{
+	public:
+		Timer() = default;
+		~Timer();
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		[[nodiscard]] bool isArmed() const { return m_wheel != nullptr; }
+
+		// Identifies what expired to the callback, e.g. a connection fd and a timeout kind
+		uint64_t userData = 0;
+		int kind = 0;
+
+	private:
+		friend class TimerWheel;
+
+		void unlink();
+		void linkBefore(Timer& head);
+
+		Timer* m_prev = nullptr;
+		Timer* m_next = nullptr;
+		uint64_t m_expiryTick = 0;
+		TimerWheel* m_wheel = nullptr;
+	};
+
+	explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(100), size_t slotCount = 512);
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	void arm(Timer& timer, Clock::time_point deadline);
+	void cancel(Timer& timer);
+
+	// Fires every timer whose deadline is not after now; returns how many fired
+	template <typename Callback>
+	size_t expire(Clock::time_point now, Callback&& onExpired);
+
+	// Milliseconds until the earliest non-empty slot comes due, -1 when nothing is armed.
+	// Suitable as an epoll_wait timeout.
+	[[nodiscard]] int nextTimeoutMs(Clock::time_point now) const;
+
+	[[nodiscard]] size_t armedCount() const { return m_armedCount; }
+
+private:
+	static void makeHead(Timer& head);
+	uint64_t tickOf(Clock::time_point time) const;
+	Timer& slotFor(uint64_t tick) const;
+
+	Clock::duration m_tick;
+	size_t m_slotCount;
+	std::unique_ptr<Timer[]> m_slots;
+	Clock::time_point m_start;
+	uint64_t m_currentTick = 0;
+	size_t m_armedCount = 0;
+};
+
+template <typename Callback>
+size_t TimerWheel::expire(Clock::time_point now, Callback&& onExpired)
+{
+	const uint64_t nowTick = tickOf(now);
+	if (nowTick < m_currentTick)
+	{
+		return 0;
+	}
+
+	// Collect first, fire afterwards: callbacks may destroy or re-arm any timer
+	Timer expired;
+	makeHead(expired);
+
+	const uint64_t steps = std::min<uint64_t>(nowTick - m_currentTick + 1, m_slotCount);
+	for (uint64_t i = 0; i < steps; ++i)
+	{
+		Timer& head = slotFor(m_currentTick + i);
+		for (Timer* timer = head.m_next; timer != &head;)
+		{
+			Timer* next = timer->m_next;
+			if (timer->m_expiryTick <= nowTick)
+			{
+				timer->unlink();
+				timer->linkBefore(expired);
+			}
+			timer = next;
+		}
+	}
+	m_currentTick = nowTick + 1;
+
+	size_t fired = 0;
+	while (expired.m_next != &expired)
+	{
+		Timer& timer = *expired.m_next;
+		timer.unlink();
+		++fired;
+		onExpired(timer);
+	}
+
+	expired.m_next = nullptr;
+	return fired;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "Query.h"
+#include "constructQuery.h"
+#include "parseQuery.h"
+
+// A connection speaks one framing for its whole life, chosen by its first byte: binary when
+// it is binaryQueryMarker, text ("name\nnumber\n") otherwise. Both directions use the same one.
+enum class WireProtocol : uint8_t
+{
+	Text,
+	Binary
+};
+
+// Binary frame, integers little-endian:
+//   offset 0  uint8   marker (0xFB, never the first byte of valid UTF-8 text)
+//   offset 1  uint8   version
+//   offset 2  uint16  name length
+//   offset 4  int32   number
+//   offset 8  name bytes
+constexpr uint8_t binaryQueryMarker = 0xFB;
+constexpr uint8_t binaryQueryVersion = 1;
+constexpr size_t binaryHeaderSize = 8;
+constexpr size_t maxBinaryNameSize = UINT16_MAX;
+
+template <typename T>
+T loadLittleEndian(const char* in)
+{
+	T value;
+	std::memcpy(&value, in, sizeof(T));
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		value = std::byteswap(value);
+	}
+	return value;
+}
+
+template <typename T>
+void storeLittleEndian(char* out, T value)
+{
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		value = std::byteswap(value);
+	}
+	std::memcpy(out, &value, sizeof(T));
+}
+
+// Size of the frame starting at data once its header is complete; nullopt while it is not
+inline std::optional<size_t> binaryFrameSize(std::string_view data)
+{
+	if (data.size() < binaryHeaderSize)
+	{
+		return std::nullopt;
+	}
+	return binaryHeaderSize + loadLittleEndian<uint16_t>(data.data() + 2);
+}
+
+inline bool isBinaryHeaderValid(std::string_view data)
+{
+	return static_cast<uint8_t>(data[0]) == binaryQueryMarker && static_cast<uint8_t>(data[1]) == binaryQueryVersion;
+}
+
+// Names longer than a frame can describe are cut at maxBinaryNameSize
+inline void appendBinaryQuery(std::string& out, std::string_view name, int number)
+{
+	name = name.substr(0, maxBinaryNameSize);
+	const size_t start = out.size();
+	out.resize(start + binaryHeaderSize + name.size());
+
+	char* frame = out.data() + start;
+	frame[0] = static_cast<char>(binaryQueryMarker);
+	frame[1] = static_cast<char>(binaryQueryVersion);
+	storeLittleEndian(frame + 2, static_cast<uint16_t>(name.size()));
+	storeLittleEndian(frame + 4, static_cast<int32_t>(number));
+	std::copy(name.begin(), name.end(), frame + binaryHeaderSize);
+}
+
+// Expects exactly one frame
+inline std::optional<QueryView> parseBinaryQuery(std::string_view frame)
+{
+	const auto size = binaryFrameSize(frame);
+	if (!size || *size != frame.size() || !isBinaryHeaderValid(frame))
+	{
+		return std::nullopt;
+	}
+	return QueryView{ frame.substr(binaryHeaderSize), loadLittleEndian<int32_t>(frame.data() + 4) };
+}
+
+inline std::optional<QueryView> parseQueryFrame(WireProtocol protocol, std::string_view frame)
+{
+	return protocol == WireProtocol::Binary ? parseBinaryQuery(frame) : parseQueryView(frame);
+}
+
+inline void appendQueryFrame(WireProtocol protocol, std::string& out, std::string_view name, int number)
+{
+	if (protocol == WireProtocol::Binary)
+	{
+		appendBinaryQuery(out, name, number);
+	}
+	else
+	{
+		appendQuery(out, name, number);
+	}
+}
+
+// The answer to a request the server shed under overload: an ordinary frame carrying
+// busyNumber, which a handler never answers with
+constexpr std::string_view busyName = "Server busy";
+constexpr int busyNumber = -1;
+
+inline void appendBusyFrame(WireProtocol protocol, std::string& out)
+{
+	appendQueryFrame(protocol, out, busyName, busyNumber);
+}
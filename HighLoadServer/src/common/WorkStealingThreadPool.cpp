@@ -0,0 +1,491 @@
+#include "WorkStealingThreadPool.h"
+#include "CpuAffinity.h"
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace
+{
+constexpr int64_t initialDequeCapacity = 256;
+constexpr size_t inboxCapacity = 4096;
+constexpr int idleSpinRounds = 64;
+
+thread_local WorkStealingThreadPool* tl_pool = nullptr;
+thread_local size_t tl_workerIndex = 0;
+thread_local size_t tl_nextInbox = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+uint64_t nextRandom(uint64_t& state)
+{
+	// xorshift64
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+} // namespace
+
+WorkStealingDeque::Array::Array(int64_t capacity)
+	: capacity(capacity), mask(capacity - 1), slots(new std::atomic<Task*>[capacity])
+{
+}
+
+WorkStealingDeque::WorkStealingDeque()
+	: m_array(new Array(initialDequeCapacity))
+{
+}
+
+WorkStealingDeque::~WorkStealingDeque()
+{
+	Array* array = m_array.load(std::memory_order_relaxed);
+	for (int64_t i = m_top.load(std::memory_order_relaxed); i < m_bottom.load(std::memory_order_relaxed); ++i)
+	{
+		delete array->get(i);
+	}
+	delete array;
+}
+
+void WorkStealingDeque::push(Task* task)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	Array* array = m_array.load(std::memory_order_relaxed);
+
+	if (bottom - top > array->capacity - 1)
+	{
+		array = grow(array, bottom, top);
+	}
+
+	array->put(bottom, task);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+Task* WorkStealingDeque::pop()
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	Array* array = m_array.load(std::memory_order_relaxed);
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Task* task = array->get(bottom);
+	if (top == bottom)
+	{
+		// Last element: race against thieves for it
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			task = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return task;
+}
+
+Task* WorkStealingDeque::steal()
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	Array* array = m_array.load(std::memory_order_acquire);
+	Task* task = array->get(top);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return task;
+}
+
+bool WorkStealingDeque::empty() const
+{
+	return m_top.load(std::memory_order_relaxed) >= m_bottom.load(std::memory_order_relaxed);
+}
+
+WorkStealingDeque::Array* WorkStealingDeque::grow(Array* array, int64_t bottom, int64_t top)
+{
+	auto bigger = std::make_unique<Array>(array->capacity * 2);
+	for (int64_t i = top; i < bottom; ++i)
+	{
+		bigger->put(i, array->get(i));
+	}
+
+	m_retired.emplace_back(array);
+	Array* result = bigger.release();
+	m_array.store(result, std::memory_order_release);
+	return result;
+}
+
+TaskInbox::TaskInbox(size_t capacity)
+	: m_cells(new Cell[capacity]), m_mask(capacity - 1)
+{
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool TaskInbox::tryPush(Task& task)
+{
+	size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true)
+	{
+		cell = &m_cells[pos & m_mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0)
+		{
+			if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->task = std::move(task);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool TaskInbox::tryPop(Task& task)
+{
+	size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true)
+	{
+		cell = &m_cells[pos & m_mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+		if (diff == 0)
+		{
+			if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			pos = m_dequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	task = std::move(cell->task);
+	cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+	return true;
+}
+
+bool TaskInbox::empty() const
+{
+	return m_dequeuePos.load(std::memory_order_relaxed) >= m_enqueuePos.load(std::memory_order_relaxed);
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t numThreads, size_t queueCapacity, std::vector<int> cpus)
+	: m_capacity(queueCapacity == 0 ? SIZE_MAX : queueCapacity)
+{
+	if (numThreads == 0)
+	{
+		numThreads = 1;
+	}
+
+	m_workers.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_workers.push_back(std::make_unique<Worker>(inboxCapacity));
+	}
+
+	m_threads.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+		m_threads.emplace_back([this, i, cpu] { workerLoop(i, cpu); });
+	}
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+	m_stop = true;
+	m_epoch.fetch_add(1, std::memory_order_release);
+	m_epoch.notify_all();
+	m_threads.clear();
+}
+
+void WorkStealingThreadPool::enqueue(Task task, TaskTag)
+{
+	if (!waitForSlot())
+	{
+		return;
+	}
+	place(task);
+	wake(1);
+}
+
+void WorkStealingThreadPool::enqueueBulk(std::span<Task> tasks)
+{
+	for (Task& task: tasks)
+	{
+		if (!waitForSlot())
+		{
+			return;
+		}
+		place(task);
+	}
+	wake(tasks.size());
+}
+
+EnqueueResult WorkStealingThreadPool::tryEnqueue(Task& task, TaskTag)
+{
+	if (m_stop)
+	{
+		return EnqueueResult::Dropped;
+	}
+	if (tl_pool == this)
+	{
+		m_queued.fetch_add(1, std::memory_order_relaxed);
+	}
+	else if (!reserveSlot())
+	{
+		return EnqueueResult::Full;
+	}
+	place(task);
+	wake(1);
+	return EnqueueResult::Queued;
+}
+
+size_t WorkStealingThreadPool::getThreadCount() const
+{
+	return m_workers.size();
+}
+
+bool WorkStealingThreadPool::reserveSlot()
+{
+	if (m_queued.fetch_add(1, std::memory_order_relaxed) < m_capacity)
+	{
+		return true;
+	}
+	m_queued.fetch_sub(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool WorkStealingThreadPool::waitForSlot()
+{
+	if (tl_pool == this)
+	{
+		// A worker waiting for room in its own pool could wait forever
+		if (m_stop)
+		{
+			return false;
+		}
+		m_queued.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool reserved = false;
+	while (!m_stop && !(reserved = reserveSlot()))
+	{
+		std::this_thread::yield();
+	}
+	if (m_stop)
+	{
+		// The task is dropped, so a place claimed just before the stop is given back
+		if (reserved)
+		{
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return false;
+	}
+	return true;
+}
+
+void WorkStealingThreadPool::place(Task& task)
+{
+	if (tl_pool == this)
+	{
+		m_workers[tl_workerIndex]->deque.push(new Task(std::move(task)));
+	}
+	else
+	{
+		const size_t start = tl_nextInbox++;
+		bool pushed = false;
+		for (size_t i = 0; i < m_workers.size() && !pushed; ++i)
+		{
+			pushed = m_workers[(start + i) % m_workers.size()]->inbox.tryPush(task);
+		}
+
+		if (!pushed)
+		{
+			std::lock_guard lock(m_overflowMutex);
+			m_overflow.push_back(std::move(task));
+			m_overflowSize.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void WorkStealingThreadPool::wake(size_t count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleepers.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	if (count == 1)
+	{
+		notifyOne();
+	}
+	else if (count > 1)
+	{
+		m_epoch.fetch_add(1, std::memory_order_release);
+		m_epoch.notify_all();
+	}
+}
+
+void WorkStealingThreadPool::notifyOne()
+{
+	m_epoch.fetch_add(1, std::memory_order_release);
+	m_epoch.notify_one();
+}
+
+bool WorkStealingThreadPool::hasWork() const
+{
+	for (const auto& worker: m_workers)
+	{
+		if (!worker->deque.empty() || !worker->inbox.empty())
+		{
+			return true;
+		}
+	}
+	return m_overflowSize.load(std::memory_order_relaxed) > 0;
+}
+
+bool WorkStealingThreadPool::tryRunOne(size_t index, uint64_t& rng)
+{
+	Worker& self = *m_workers[index];
+	// The queue place is released before the task runs: it bounds waiting, not running, tasks
+	auto run = [this](Task& task) {
+		m_queued.fetch_sub(1, std::memory_order_relaxed);
+		task();
+	};
+
+	if (std::unique_ptr<Task> local{self.deque.pop()})
+	{
+		run(*local);
+		return true;
+	}
+
+	Task task;
+	if (self.inbox.tryPop(task))
+	{
+		run(task);
+		return true;
+	}
+
+	const size_t count = m_workers.size();
+	const size_t start = nextRandom(rng) % count;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const size_t victim = (start + i) % count;
+		if (victim == index)
+		{
+			continue;
+		}
+
+		if (std::unique_ptr<Task> stolen{m_workers[victim]->deque.steal()})
+		{
+			run(*stolen);
+			return true;
+		}
+		if (m_workers[victim]->inbox.tryPop(task))
+		{
+			run(task);
+			return true;
+		}
+	}
+
+	if (m_overflowSize.load(std::memory_order_relaxed) > 0)
+	{
+		{
+			std::lock_guard lock(m_overflowMutex);
+			if (m_overflow.empty())
+			{
+				return false;
+			}
+			task = std::move(m_overflow.front());
+			m_overflow.pop_front();
+			m_overflowSize.fetch_sub(1, std::memory_order_relaxed);
+		}
+		run(task);
+		return true;
+	}
+
+	return false;
+}
+
+void WorkStealingThreadPool::workerLoop(size_t index, int cpu)
+{
+	if (cpu >= 0)
+	{
+		pinCurrentThread(cpu);
+	}
+	tl_pool = this;
+	tl_workerIndex = index;
+	uint64_t rng = 0x9E3779B97F4A7C15ull * (index + 1);
+
+	while (true)
+	{
+		if (tryRunOne(index, rng))
+		{
+			continue;
+		}
+
+		bool found = false;
+		for (int spin = 0; spin < idleSpinRounds && !found; ++spin)
+		{
+			std::this_thread::yield();
+			found = tryRunOne(index, rng);
+		}
+		if (found)
+		{
+			continue;
+		}
+
+		const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+		m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (hasWork())
+		{
+			m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+			continue;
+		}
+		if (m_stop)
+		{
+			m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+			break;
+		}
+
+		m_epoch.wait(epoch, std::memory_order_acquire);
+		m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <span>
+#include "Executor.h"
+
+// Chase-Lev deque: the owning worker pushes and pops at the bottom without locks,
+// other workers steal from the top with a single CAS.
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque();
+	~WorkStealingDeque();
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	void push(Task* task);
+	Task* pop();
+	Task* steal();
+	bool empty() const;
+
+private:
+	struct Array
+	{
+		explicit Array(int64_t capacity);
+
+		int64_t capacity;
+		int64_t mask;
+		std::unique_ptr<std::atomic<Task*>[]> slots;
+
+		Task* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+		void put(int64_t i, Task* task) { slots[i & mask].store(task, std::memory_order_relaxed); }
+	};
+
+	Array* grow(Array* array, int64_t bottom, int64_t top);
+
+	alignas(64) std::atomic<int64_t> m_top{0};
+	alignas(64) std::atomic<int64_t> m_bottom{0};
+	std::atomic<Array*> m_array;
+	// Arrays replaced by grow() may still be read by a concurrent thief, so they live until destruction.
+	std::vector<std::unique_ptr<Array>> m_retired;
+};
+
+// Bounded multi-producer multi-consumer ring (Vyukov) used as a worker's inbox for
+// tasks submitted from threads outside the pool.
+class TaskInbox
+{
+public:
+	explicit TaskInbox(size_t capacity);
+
+	TaskInbox(const TaskInbox&) = delete;
+	TaskInbox& operator=(const TaskInbox&) = delete;
+
+	bool tryPush(Task& task);
+	bool tryPop(Task& task);
+	bool empty() const;
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Task task;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	alignas(64) std::atomic<size_t> m_enqueuePos{0};
+	alignas(64) std::atomic<size_t> m_dequeuePos{0};
+};
+
+// Drop-in alternative to ThreadPool with per-worker queues. Tasks enqueued by a worker go
+// to its own deque, tasks from outside are spread round-robin over the worker inboxes;
+// idle workers steal from random victims before parking. Task tags are ignored: there are no
+// lanes and no fairness between keys.
+class WorkStealingThreadPool : public Executor
+{
+public:
+	// queueCapacity bounds the tasks submitted from outside the pool that wait for a worker;
+	// 0 means unbounded. Tasks enqueued by the workers themselves are never held back.
+	// Worker i is pinned to cpus[i % cpus.size()] unless cpus is empty.
+	explicit WorkStealingThreadPool(size_t numThreads = std::thread::hardware_concurrency(), size_t queueCapacity = 0, std::vector<int> cpus = {});
+	~WorkStealingThreadPool() override;
+
+	WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+	WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+	void enqueue(Task task, TaskTag tag = {}) override;
+	EnqueueResult tryEnqueue(Task& task, TaskTag tag = {}) override;
+	void enqueueBulk(std::span<Task> tasks) override;
+	size_t getThreadCount() const override;
+
+private:
+	struct Worker
+	{
+		explicit Worker(size_t inboxCapacity) : inbox(inboxCapacity) {}
+
+		WorkStealingDeque deque;
+		TaskInbox inbox;
+	};
+
+	void workerLoop(size_t index, int cpu);
+	bool tryRunOne(size_t index, uint64_t& rng);
+	bool hasWork() const;
+	void notifyOne();
+	// Puts task on a queue without waking anybody
+	void place(Task& task);
+	// Wakes sleeping workers for count newly placed tasks
+	void wake(size_t count);
+	// Claims one of m_capacity queue places; false when all are taken
+	bool reserveSlot();
+	// Claims a place for one task, from outside the pool waiting for room; false once the
+	// pool stops, with nothing claimed
+	bool waitForSlot();
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	size_t m_capacity;
+	// Tasks queued and not yet picked up by a worker
+	alignas(64) std::atomic<size_t> m_queued{0};
+
+	// Last resort when every inbox is full
+	std::mutex m_overflowMutex;
+	std::deque<Task> m_overflow;
+	std::atomic<size_t> m_overflowSize{0};
+
+	// Parking: a worker registers in m_sleepers, re-checks the queues and only then waits
+	// on m_epoch. Producers publish the task before reading m_sleepers, so either the
+	// worker sees the task or the producer sees the sleeper and bumps the epoch.
+	alignas(64) std::atomic<uint32_t> m_epoch{0};
+	alignas(64) std::atomic<int> m_sleepers{0};
+	std::atomic<bool> m_stop{false};
+
+	std::vector<std::jthread> m_threads;
+};
@@ -1,7 +1,29 @@
 #pragma once
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
 #include "Query.h"
 
 inline std::string constructQuery(const Query& query)
 {
 	return query.name + "\n" + std::to_string(query.number) + "\n";
 }
+
+// Appends the same "name\nnumber\n" text to out without temporaries; it allocates only when
+// out has to grow
+inline void appendQuery(std::string& out, std::string_view name, int number)
+{
+	char digits[16];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+
+	const size_t start = out.size();
+	const size_t digitCount = static_cast<size_t>(result.ptr - digits);
+	out.resize(start + name.size() + digitCount + 2);
+
+	char* cursor = out.data() + start;
+	cursor = std::copy(name.begin(), name.end(), cursor);
+	*cursor++ = '\n';
+	cursor = std::copy(digits, result.ptr, cursor);
+	*cursor = '\n';
+}
@@ -1,5 +1,8 @@
 #pragma once
+#include <charconv>
+#include <optional>
 #include <sstream>
+#include <string_view>
 
 #include "Query.h"
 
@@ -19,4 +22,35 @@ inline Query parseQuery(const std::string& input)
 	}
 
 	return query;
-}
\ No newline at end of file
+}
+
+// Allocation-free counterpart of parseQuery for the server's hot path: accepts the same
+// "name\nnumber..." input, but returns a view into it and reports bad input as nullopt
+inline std::optional<QueryView> parseQueryView(std::string_view input)
+{
+	const size_t newline = input.find('\n');
+	if (newline == std::string_view::npos)
+	{
+		return std::nullopt;
+	}
+
+	QueryView query{ input.substr(0, newline), 0 };
+
+	// operator>> skips leading whitespace and takes an optional '+'; from_chars does neither
+	const char* begin = input.data() + newline + 1;
+	const char* end = input.data() + input.size();
+	while (begin != end && (*begin == ' ' || *begin == '\t' || *begin == '\n' || *begin == '\r'))
+	{
+		++begin;
+	}
+	if (begin != end && *begin == '+')
+	{
+		++begin;
+	}
+
+	if (std::from_chars(begin, end, query.number).ec != std::errc{})
+	{
+		return std::nullopt;
+	}
+	return query;
+}
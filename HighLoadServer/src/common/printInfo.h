@@ -1,20 +1,14 @@
 #pragma once
-#include <iostream>
-#include <string>
-#include <syncstream>
+#include <string_view>
+#include "Logger.h"
 
 inline void printInfo(
-	const std::string& clientName,
-	const std::string& serverName,
+	std::string_view clientName,
+	std::string_view serverName,
 	int clientNumber,
 	int serverNumber
 )
 {
-	std::osyncstream(std::cout)
-		<< "Client: " << clientName << std::endl
-		<< "Server: " << serverName << std::endl
-		<< "Client number: " << clientNumber << std::endl
-		<< "Server number: " << serverNumber << std::endl
-		<< "Sum: " << clientNumber + serverNumber << std::endl
-		<< std::endl;
+	LOG_INFO("Client: {}\nServer: {}\nClient number: {}\nServer number: {}\nSum: {}\n",
+		clientName, serverName, clientNumber, serverNumber, clientNumber + serverNumber);
 }
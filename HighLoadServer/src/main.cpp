@@ -1,13 +1,23 @@
+#include <charconv>
 #include <exception>
 #include <iostream>
 #include <optional>
+#include <memory>
 #include <csignal>
 #include <thread>
-#include <random>
 #include <vector>
 #include <chrono>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "common/CpuAffinity.h"
+#include "common/Logger.h"
+#include "common/RequestTracer.h"
 #include "server/Server.h"
+#include "server/AdminServer.h"
+#include "server/ListenerHandoff.h"
 #include "client/Client.h"
+#include "client/LoadGenerator.h"
 
 struct Args
 {
@@ -22,38 +32,406 @@ struct Args
 	int port{};
 	std::string address;
 	std::string name;
-	int instanceCount = 1;
+	LoadConfig load;
+	WireProtocol protocol = WireProtocol::Text;
+	size_t window = Client::defaultWindow;
+	ServerConfig serverConfig;
+	DispatchPolicy dispatch = DispatchPolicy::Pool;
+	HandlerKind handler = HandlerKind::Message;
+	std::string handoffPath;
+	// Trace one request in traceSampling; 0 disables tracing
+	uint32_t traceSampling = 0;
+	std::string traceFile = "trace.json";
+	LogLevel logLevel = LogLevel::Info;
+	// 0 disables the metrics endpoint
+	int adminPort = 0;
 };
 
+std::optional<std::string_view> OptionValue(std::string_view arg, std::string_view option)
+{
+	if (!arg.starts_with(option) || arg.size() <= option.size() || arg[option.size()] != '=')
+	{
+		return std::nullopt;
+	}
+	return arg.substr(option.size() + 1);
+}
+
+std::optional<LogLevel> ParseLogLevel(std::string_view name)
+{
+	if (name == "trace")
+		return LogLevel::Trace;
+	if (name == "debug")
+		return LogLevel::Debug;
+	if (name == "info")
+		return LogLevel::Info;
+	if (name == "warn")
+		return LogLevel::Warn;
+	if (name == "error")
+		return LogLevel::Error;
+	return std::nullopt;
+}
+
+// Comma-separated names; empty when one of them is
+std::vector<std::string> ParseNameList(std::string_view list)
+{
+	std::vector<std::string> names;
+	while (true)
+	{
+		const size_t comma = list.find(',');
+		const std::string_view name = list.substr(0, comma);
+		if (name.empty())
+			return {};
+		names.emplace_back(name);
+		if (comma == std::string_view::npos)
+			return names;
+		list.remove_prefix(comma + 1);
+	}
+}
+
+// The whole of text as a T; nullopt when it is not a number or does not fit
+template <typename T>
+std::optional<T> ParseNumber(std::string_view text)
+{
+	T value{};
+	const char* end = text.data() + text.size();
+	const auto [parsed, error] = std::from_chars(text.data(), end, value);
+	if (error != std::errc() || parsed != end)
+		return std::nullopt;
+	return value;
+}
+
+// Names the argument ParseArgs gives up on, ahead of the usage text
+std::nullopt_t InvalidOption(std::string_view arg)
+{
+	std::cerr << "Invalid option: " << arg << std::endl;
+	return std::nullopt;
+}
+
+// Reports the argument when it is not a port number
+std::optional<int> ParsePort(std::string_view text)
+{
+	const auto port = ParseNumber<int>(text);
+	if (!port || *port < 0 || *port > 65535)
+	{
+		std::cerr << "Invalid port: " << text << std::endl;
+		return std::nullopt;
+	}
+	return port;
+}
+
 std::optional<Args> ParseArgs(int argc, char** argv)
 {
 	Args args;
+	std::vector<std::string> positional;
 
-	if (argc == 3)
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (auto value = OptionValue(arg, "--reactors"))
+		{
+			// 0 means one reactor per hardware thread
+			const auto reactorCount = ParseNumber<int>(*value);
+			if (!reactorCount || *reactorCount < 0)
+				return InvalidOption(arg);
+			args.serverConfig.reactorCount = *reactorCount == 0 ? std::thread::hardware_concurrency() : *reactorCount;
+		}
+		else if (auto value = OptionValue(arg, "--pool"))
+		{
+			if (*value == "shared")
+				args.serverConfig.workerPool = WorkerPoolKind::Shared;
+			else if (*value == "stealing")
+				args.serverConfig.workerPool = WorkerPoolKind::WorkStealing;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--pool-size"))
+		{
+			// MIN-MAX: an elastic pool
+			const size_t dash = value->find('-');
+			if (dash == std::string_view::npos)
+				return InvalidOption(arg);
+			const auto minThreads = ParseNumber<int>(value->substr(0, dash));
+			const auto maxThreads = ParseNumber<int>(value->substr(dash + 1));
+			if (!minThreads || !maxThreads || *minThreads <= 0 || *maxThreads < *minThreads)
+				return InvalidOption(arg);
+			args.serverConfig.workerSizing.minThreads = *minThreads;
+			args.serverConfig.workerSizing.maxThreads = *maxThreads;
+		}
+		else if (auto value = OptionValue(arg, "--pool-wait"))
+		{
+			const auto waitUs = ParseNumber<int>(*value);
+			if (!waitUs || *waitUs <= 0)
+				return InvalidOption(arg);
+			args.serverConfig.workerSizing.targetWait = std::chrono::microseconds(*waitUs);
+		}
+		else if (auto value = OptionValue(arg, "--fairness"))
+		{
+			if (*value == "none")
+				args.serverConfig.fairness = FairnessKey::None;
+			else if (*value == "connection")
+				args.serverConfig.fairness = FairnessKey::Connection;
+			else if (*value == "name")
+				args.serverConfig.fairness = FairnessKey::ClientName;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--high-priority"))
+		{
+			args.serverConfig.highPriorityNames = ParseNameList(*value);
+			if (args.serverConfig.highPriorityNames.empty())
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--low-priority"))
+		{
+			args.serverConfig.lowPriorityNames = ParseNameList(*value);
+			if (args.serverConfig.lowPriorityNames.empty())
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--backend"))
+		{
+			if (*value == "epoll")
+				args.serverConfig.backend = BackendKind::Epoll;
+			else if (*value == "io_uring")
+				args.serverConfig.backend = BackendKind::IoUring;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--dispatch"))
+		{
+			if (*value == "inline")
+				args.dispatch = DispatchPolicy::Inline;
+			else if (*value == "pool")
+				args.dispatch = DispatchPolicy::Pool;
+			else if (*value == "batched")
+				args.dispatch = DispatchPolicy::Batched;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--handler"))
+		{
+			if (*value == "message")
+				args.handler = HandlerKind::Message;
+			else if (*value == "coroutine")
+				args.handler = HandlerKind::Coroutine;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--queue-capacity"))
+		{
+			const auto capacity = ParseNumber<int>(*value);
+			if (!capacity || *capacity < 0)
+				return InvalidOption(arg);
+			args.serverConfig.queueCapacity = *capacity;
+		}
+		else if (auto value = OptionValue(arg, "--overload"))
+		{
+			if (*value == "reject")
+				args.serverConfig.overloadPolicy = OverloadPolicy::Reject;
+			else if (*value == "pause")
+				args.serverConfig.overloadPolicy = OverloadPolicy::PauseReading;
+			else if (*value == "block")
+				args.serverConfig.overloadPolicy = OverloadPolicy::Block;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--codel-target"))
+		{
+			const auto target = ParseNumber<int>(*value);
+			if (!target || *target < 0)
+				return InvalidOption(arg);
+			args.serverConfig.codelTarget = std::chrono::milliseconds(*target);
+		}
+		else if (auto value = OptionValue(arg, "--codel-interval"))
+		{
+			const auto interval = ParseNumber<int>(*value);
+			if (!interval || *interval <= 0)
+				return InvalidOption(arg);
+			args.serverConfig.codelInterval = std::chrono::milliseconds(*interval);
+		}
+		else if (auto value = OptionValue(arg, "--reactor-cpus"))
+		{
+			auto cpus = parseCpuList(*value);
+			if (!cpus)
+				return InvalidOption(arg);
+			args.serverConfig.reactorCpus = std::move(*cpus);
+		}
+		else if (auto value = OptionValue(arg, "--worker-cpus"))
+		{
+			auto cpus = parseCpuList(*value);
+			if (!cpus)
+				return InvalidOption(arg);
+			args.serverConfig.workerCpus = std::move(*cpus);
+		}
+		else if (auto value = OptionValue(arg, "--handoff"))
+		{
+			args.handoffPath = std::string(*value);
+		}
+		else if (auto value = OptionValue(arg, "--trace"))
+		{
+			const auto sampling = ParseNumber<int>(*value);
+			if (!sampling || *sampling <= 0)
+				return InvalidOption(arg);
+			args.traceSampling = *sampling;
+		}
+		else if (auto value = OptionValue(arg, "--trace-file"))
+		{
+			args.traceFile = std::string(*value);
+		}
+		else if (auto value = OptionValue(arg, "--unix"))
+		{
+			if (!isUnixSocketPath(*value))
+				return InvalidOption(arg);
+			args.serverConfig.unixPath = std::string(*value);
+		}
+		else if (arg == "--udp")
+		{
+			args.serverConfig.udp = true;
+		}
+		else if (arg == "--incoming-cpu")
+		{
+			args.serverConfig.steerByIncomingCpu = true;
+		}
+		else if (auto value = OptionValue(arg, "--busy-poll"))
+		{
+			const auto budgetUs = ParseNumber<int>(*value);
+			if (!budgetUs || *budgetUs < 0)
+				return InvalidOption(arg);
+			args.serverConfig.busyPoll.budget = std::chrono::microseconds(*budgetUs);
+		}
+		else if (auto value = OptionValue(arg, "--socket-busy-poll"))
+		{
+			const auto pollUs = ParseNumber<int>(*value);
+			if (!pollUs || *pollUs < 0)
+				return InvalidOption(arg);
+			args.serverConfig.busyPoll.socketPoll = std::chrono::microseconds(*pollUs);
+		}
+		else if (auto value = OptionValue(arg, "--log-level"))
+		{
+			auto level = ParseLogLevel(*value);
+			if (!level)
+				return InvalidOption(arg);
+			args.logLevel = *level;
+		}
+		else if (auto value = OptionValue(arg, "--protocol"))
+		{
+			if (*value == "text")
+				args.protocol = WireProtocol::Text;
+			else if (*value == "binary")
+				args.protocol = WireProtocol::Binary;
+			else
+				return InvalidOption(arg);
+		}
+		else if (auto value = OptionValue(arg, "--window"))
+		{
+			const auto window = ParseNumber<int>(*value);
+			if (!window || *window <= 0)
+				return InvalidOption(arg);
+			args.window = *window;
+		}
+		else if (auto value = OptionValue(arg, "--rate"))
+		{
+			const auto rate = ParseNumber<double>(*value);
+			if (!rate || *rate <= 0)
+				return InvalidOption(arg);
+			args.load.rate = *rate;
+		}
+		else if (auto value = OptionValue(arg, "--concurrency"))
+		{
+			const auto concurrency = ParseNumber<int>(*value);
+			if (!concurrency || *concurrency <= 0)
+				return InvalidOption(arg);
+			args.load.concurrency = *concurrency;
+		}
+		else if (auto value = OptionValue(arg, "--duration"))
+		{
+			const auto seconds = ParseNumber<int>(*value);
+			if (!seconds || *seconds <= 0)
+				return InvalidOption(arg);
+			args.load.duration = std::chrono::seconds(*seconds);
+		}
+		else if (auto value = OptionValue(arg, "--threads"))
+		{
+			const auto threads = ParseNumber<int>(*value);
+			if (!threads || *threads <= 0)
+				return InvalidOption(arg);
+			args.load.threads = *threads;
+		}
+		else if (auto value = OptionValue(arg, "--admin-port"))
+		{
+			const auto adminPort = ParseNumber<int>(*value);
+			if (!adminPort || *adminPort <= 0 || *adminPort > 65535)
+				return InvalidOption(arg);
+			args.adminPort = *adminPort;
+		}
+		else if (arg.starts_with("--"))
+		{
+			return InvalidOption(arg);
+		}
+		else
+		{
+			positional.emplace_back(arg);
+		}
+	}
+
+	if (args.serverConfig.steerByIncomingCpu && args.serverConfig.reactorCpus.empty())
+	{
+		return std::nullopt;
+	}
+	const bool tagged = args.serverConfig.fairness != FairnessKey::None || !args.serverConfig.highPriorityNames.empty()
+		|| !args.serverConfig.lowPriorityNames.empty();
+	if ((args.serverConfig.workerSizing.isElastic() || tagged) && args.serverConfig.workerPool != WorkerPoolKind::Shared)
+	{
+		return std::nullopt;
+	}
+	const bool busyPoll = args.serverConfig.busyPoll.budget.count() > 0 || args.serverConfig.busyPoll.socketPoll.count() > 0;
+	const bool epollOnly = args.handler == HandlerKind::Coroutine || args.serverConfig.udp || !args.serverConfig.unixPath.empty() || busyPoll;
+	if (epollOnly && args.serverConfig.backend != BackendKind::Epoll)
+	{
+		return std::nullopt;
+	}
+
+	if (positional.size() == 2)
 	{
 		// Server mode: ./app <port> <name>
 		args.mode = Args::Mode::Server;
-		args.port = std::stoi(argv[1]);
-		args.name = argv[2];
+		const auto port = ParsePort(positional[0]);
+		if (!port)
+			return std::nullopt;
+		args.port = *port;
+		args.name = positional[1];
 	}
-	else if (argc == 4)
+	else if (positional.size() == 3)
 	{
 		// Single client: ./app <addr> <port> <name>
 		args.mode = Args::Mode::SingleClient;
-		args.address = argv[1];
-		args.port = std::stoi(argv[2]);
-		args.name = argv[3];
+		args.address = positional[0];
+		const auto port = ParsePort(positional[1]);
+		if (!port)
+			return std::nullopt;
+		args.port = *port;
+		args.name = positional[2];
 	}
-	else if (argc == 5)
+	else if (positional.size() == 4)
 	{
-		// Load test: ./app <addr> <port> <base_name> <count>
+		// Load test: ./app <addr> <port> <base_name> <connections>
 		args.mode = Args::Mode::LoadClient;
-		args.address = argv[1];
-		args.port = std::stoi(argv[2]);
-		args.name = argv[3];
-		args.instanceCount = std::stoi(argv[4]);
-		if (args.instanceCount <= 0)
+		args.address = positional[0];
+		const auto port = ParsePort(positional[1]);
+		if (!port)
+			return std::nullopt;
+		args.port = *port;
+		args.name = positional[2];
+		const auto connections = ParseNumber<int>(positional[3]);
+		if (!connections || *connections <= 0)
+		{
+			std::cerr << "Invalid connection count: " << positional[3] << std::endl;
 			return std::nullopt;
+		}
+		args.load.address = args.address;
+		args.load.port = static_cast<unsigned short>(args.port);
+		args.load.name = args.name;
+		args.load.connections = *connections;
+		args.load.protocol = args.protocol;
 	}
 	else
 	{
@@ -63,7 +441,9 @@ std::optional<Args> ParseArgs(int argc, char** argv)
 	return args;
 }
 
-void waitForKillSignal()
+// Returns on SIGINT or SIGTERM. With a trace path, each SIGUSR1 meanwhile writes the request
+// trace there.
+void waitForKillSignal(const std::string& tracePath)
 {
 	sigset_t set;
 	int sig;
@@ -71,10 +451,24 @@ void waitForKillSignal()
 	sigemptyset(&set);
 	sigaddset(&set, SIGINT);
 	sigaddset(&set, SIGTERM);
+	if (!tracePath.empty())
+	{
+		sigaddset(&set, SIGUSR1);
+	}
 
-	sigwait(&set, &sig);
+	while (sigwait(&set, &sig) == 0 && sig == SIGUSR1)
+	{
+		if (RequestTracer::instance().dump(tracePath))
+		{
+			LOG_INFO("Request trace written to {}", tracePath);
+		}
+		else
+		{
+			LOG_ERROR("Failed to write request trace to {}", tracePath);
+		}
+	}
 
-	std::cout << "\nReceived signal " << sig << ". Shutting down..." << std::endl;
+	LOG_INFO("Received signal {}. Shutting down...", sig);
 }
 
 void RunImpl(const Args& args)
@@ -86,9 +480,37 @@ void RunImpl(const Args& args)
 		sigemptyset(&set);
 		sigaddset(&set, SIGINT);
 		sigaddset(&set, SIGTERM);
+		if (args.traceSampling != 0)
+		{
+			sigaddset(&set, SIGUSR1);
+		}
 
 		pthread_sigmask(SIG_BLOCK, &set, nullptr);
-		Server server(args.port, args.name);
+		RequestTracer::instance().setSampling(args.traceSampling);
+
+		// With a handoff path, serve the listeners of the server running there, if any
+		ServerConfig serverConfig = args.serverConfig;
+		std::unique_ptr<ListenerHandoff> handoff;
+		if (!args.handoffPath.empty())
+		{
+			handoff = std::make_unique<ListenerHandoff>(args.handoffPath);
+			adoptListeners(serverConfig, handoff->takeListeners());
+			serverConfig.reusePort = true;
+		}
+
+		// Bound before the server starts so a taken admin port fails fast
+		std::unique_ptr<AdminServer> admin;
+		if (args.adminPort != 0)
+		{
+			admin = std::make_unique<AdminServer>(args.adminPort, handoff != nullptr);
+		}
+		Server server(args.port, args.name, serverConfig, args.dispatch, args.handler);
+
+		std::jthread adminThread;
+		if (admin)
+		{
+			adminThread = std::jthread([&admin]() { admin->run(); });
+		}
 
 		std::jthread serverThread([&server]() {
 			try
@@ -97,60 +519,50 @@ void RunImpl(const Args& args)
 			}
 			catch (const std::exception& e)
 			{
-				std::cerr << "Server error: " << e.what() << std::endl;
+				LOG_ERROR("Server error: {}", e.what());
 			}
 		});
 
-		waitForKillSignal();
+		std::jthread handoffThread;
+		if (handoff)
+		{
+			handoff->confirm();
+			handoffThread = std::jthread([&handoff, &server]() {
+				// Once a successor has the listeners, leave as on SIGTERM: stop accepting and drain
+				handoff->run(server.getListeners(), []() { kill(getpid(), SIGTERM); });
+			});
+		}
+
+		waitForKillSignal(args.traceSampling != 0 ? args.traceFile : std::string());
+		if (handoff)
+		{
+			handoff->shutdown();
+		}
+		if (admin)
+		{
+			admin->shutdown();
+		}
 		server.shutdown();
 	}
 	else if (args.mode == Args::Mode::SingleClient)
 	{
-		Client client(args.address, args.port, args.name);
+		Client client(args.address, args.port, args.name, args.protocol, args.window);
 		client.run();
 	}
 	else if (args.mode == Args::Mode::LoadClient)
 	{
-		std::cout << "Starting load test: " << args.instanceCount << " clients to "
-				  << args.address << ":" << args.port << std::endl;
-
-		std::vector<std::jthread> clients;
-		clients.reserve(args.instanceCount);
-
-		for (int i = 0; i < args.instanceCount; ++i)
+		if (isUnixSocketPath(args.address))
 		{
-			clients.emplace_back([&, i](std::stop_token st) {
-				std::random_device rd;
-				std::mt19937 gen(rd());
-				std::uniform_int_distribution<> numDist(0, 100);
-				std::uniform_int_distribution<> sleepDist(0, 15);
-
-				std::string clientName = args.name + "_" + std::to_string(i);
-
-				try
-				{
-					Client client(args.address, args.port, clientName);
-
-					int clientNumber = numDist(gen);
-					auto sleepSec = sleepDist(gen);
-					client.run(clientNumber, sleepSec);
-				}
-				catch (const std::exception& e)
-				{
-					std::cerr << "[Client " << clientName << "] Error: " << e.what() << std::endl;
-				}
-			});
+			LOG_INFO("Starting load test: {} connections to {}", args.load.connections, args.address);
 		}
-
-		std::cout << "All " << args.instanceCount << " clients started." << std::endl;
-
-		for (auto& t : clients)
+		else
 		{
-			if (t.joinable())
-				t.join();
+			LOG_INFO("Starting load test: {} connections to {}:{}", args.load.connections, args.address, args.port);
 		}
 
-		std::cout << "Load test completed." << std::endl;
+		LoadGenerator generator(args.load);
+		const LoadReport report = generator.run();
+		LoadGenerator::printReport(args.load, report);
 	}
 }
 
@@ -161,20 +573,72 @@ int main(int argc, char** argv)
 	{
 		std::cout
 			<< "Usage:\n"
-			<< "  Server mode:      " << argv[0] << " <port> <name>\n"
-			<< "  Single client:    " << argv[0] << " <address> <port> <name>\n"
-			<< "  Load test client: " << argv[0] << " <address> <port> <base_name> <count>\n"
+			<< "  Server mode:      " << argv[0] << " <port> <name> [options]\n"
+			<< "  Single client:    " << argv[0] << " <address> <port> <name> [options]\n"
+			<< "  Load test client: " << argv[0] << " <address> <port> <base_name> <connections> [options]\n"
+			<< "\n"
+			<< "Options:\n"
+			<< "  --log-level=LEVEL trace, debug, info (default), warn or error\n"
+			<< "\n"
+			<< "Server options:\n"
+			<< "  --reactors=N      Event loops sharing the port via SO_REUSEPORT (0 = one per core)\n"
+			<< "  --pool=KIND       Worker pool: shared (mutex queue, default) or stealing\n"
+			<< "  --pool-size=MIN-MAX Shared pool only: grow and shrink between MIN and MAX workers with\n"
+			<< "                      the measured queue wait and worker load (default: one per core, fixed)\n"
+			<< "  --pool-wait=US      Queue wait above which an elastic pool grows (default 1000)\n"
+			<< "  --fairness=KEY      Shared pool only: a queue per connection or per client name (name),\n"
+			<< "                      served in turn, so one client's flood delays only itself (default none)\n"
+			<< "  --high-priority=NAMES Client names, comma-separated, whose requests go before all others\n"
+			<< "  --low-priority=NAMES  Client names whose requests wait until no others are queued\n"
+			<< "  --backend=KIND    I/O backend: epoll (default) or io_uring\n"
+			<< "  --admin-port=N    Serve Prometheus metrics at http://<host>:N/metrics\n"
+			<< "  --dispatch=KIND   Where requests are handled: inline (on the event loop), pool (one\n"
+			<< "                    task per request, default) or batched (one task per loop iteration)\n"
+			<< "  --handler=KIND    message (default) or coroutine: one coroutine per connection on\n"
+			<< "                    the event loop (epoll backend only)\n"
+			<< "  --queue-capacity=N  Requests that may wait for a worker (0 = unbounded, default)\n"
+			<< "  --overload=POLICY   When that queue is full: reject (answer busy, default), pause\n"
+			<< "                      (stop reading the connection) or block (stall the reactor)\n"
+			<< "  --codel-target=MS   Answer busy once requests keep waiting longer than MS (0 = off, default)\n"
+			<< "  --codel-interval=MS How long the wait must stay above target before shedding (default 100)\n"
+			<< "  --reactor-cpus=LIST Pin reactor i to the i-th CPU of LIST, e.g. 0-3,8 (default: unpinned)\n"
+			<< "  --worker-cpus=LIST  One pool worker pinned to each CPU of LIST (default: unpinned, one per core)\n"
+			<< "  --incoming-cpu      Hand each reactor the connections arriving on its CPU (needs --reactor-cpus)\n"
+			<< "  --handoff=PATH      Hot restart: take the listeners of the server serving PATH, if any, which\n"
+			<< "                      then drains and exits; serve PATH for the next restart\n"
+			<< "  --udp               Also answer queries sent as UDP datagrams to the same port (epoll only)\n"
+			<< "  --unix=PATH         Also accept connections on a unix socket: an absolute path, or @name\n"
+			<< "                      in the abstract namespace (epoll only)\n"
+			<< "  --busy-poll=US      Latency mode: an idle reactor polls epoll without blocking for up to US\n"
+			<< "                      before it sleeps, adapting the spin to how soon events come (epoll only)\n"
+			<< "  --socket-busy-poll=US SO_BUSY_POLL and SO_PREFER_BUSY_POLL on accepted sockets (epoll only)\n"
+			<< "  --trace=N           Trace one request in N (accept to write, TSC timestamps); SIGUSR1\n"
+			<< "                      writes the recent ones as Chrome trace JSON\n"
+			<< "  --trace-file=PATH   Where SIGUSR1 writes the trace (default trace.json)\n"
+			<< "\n"
+			<< "Client options:\n"
+			<< "  <address> may be a unix socket path as for --unix, in which case <port> is ignored\n"
+			<< "  --protocol=KIND   Wire format: text (default) or binary; the server accepts both\n"
+			<< "  --window=N        Single client: queries pipelined ahead of their answers (default 16)\n"
+			<< "\n"
+			<< "Load test options:\n"
+			<< "  --rate=R          Open loop: R requests/s in total, latency measured from when each was due\n"
+			<< "  --concurrency=N   Closed loop (default): N requests in flight in total (default: one per connection)\n"
+			<< "  --duration=S      Seconds of load after all connections are up (default 10)\n"
+			<< "  --threads=N       Event-loop threads (default: up to 4)\n"
 			<< std::endl;
 		return EXIT_FAILURE;
 	}
 
+	Logger::instance().setLevel(args->logLevel);
+
 	try
 	{
 		RunImpl(args.value());
 	}
 	catch (const std::exception& e)
 	{
-		std::cerr << "Fatal error: " << e.what() << std::endl;
+		LOG_ERROR("Fatal error: {}", e.what());
 		return EXIT_FAILURE;
 	}
 
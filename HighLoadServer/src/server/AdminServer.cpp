@@ -0,0 +1,116 @@
+#include "AdminServer.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "../common/Logger.h"
+#include "../common/Metrics.h"
+
+constexpr int stopCheckIntervalMs = 250;
+constexpr size_t maxRequestSize = 8192;
+constexpr timeval clientTimeout{ 2, 0 };
+
+namespace
+{
+std::string makeResponse(const std::string& status, const std::string& contentType, const std::string& body)
+{
+	return "HTTP/1.1 " + status + "\r\n"
+		+ "Content-Type: " + contentType + "\r\n"
+		+ "Content-Length: " + std::to_string(body.size()) + "\r\n"
+		+ "Connection: close\r\n\r\n"
+		+ body;
+}
+} // namespace
+
+AdminServer::AdminServer(unsigned short port, bool reusePort)
+{
+	if ((reusePort && !m_server.enableReusePort()) || !m_server.bind(port) || !m_server.listen())
+	{
+		throw std::runtime_error("Failed to bind or listen on admin socket");
+	}
+}
+
+void AdminServer::run()
+{
+	LOG_INFO("Admin endpoint on {}, metrics at /metrics", m_server.getLocalAddress());
+
+	while (!m_stopRequested)
+	{
+		pollfd listener{ m_server.getHandle(), POLLIN, 0 };
+		const int ready = poll(&listener, 1, stopCheckIntervalMs);
+		if (ready == -1 && errno != EINTR)
+		{
+			LOG_ERROR("Admin poll failed: {}", strerror(errno));
+			break;
+		}
+		if (ready <= 0)
+		{
+			continue;
+		}
+
+		auto client = m_server.accept();
+		if (!client || !client->isValid())
+		{
+			continue;
+		}
+
+		// A stalled scraper must not hold the endpoint forever
+		setsockopt(client->getHandle(), SOL_SOCKET, SO_RCVTIMEO, &clientTimeout, sizeof(clientTimeout));
+		setsockopt(client->getHandle(), SOL_SOCKET, SO_SNDTIMEO, &clientTimeout, sizeof(clientTimeout));
+		serveClient(*client);
+	}
+}
+
+void AdminServer::serveClient(TcpClient& client) const
+{
+	std::string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < maxRequestSize)
+	{
+		const ssize_t bytes = client.receiveSome(buffer, sizeof(buffer));
+		if (bytes <= 0)
+		{
+			return;
+		}
+		request.append(buffer, static_cast<size_t>(bytes));
+	}
+
+	std::string response;
+	if (request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?"))
+	{
+		response = makeResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+								MetricsRegistry::instance().renderPrometheus());
+	}
+	else
+	{
+		response = makeResponse("404 Not Found", "text/plain; charset=utf-8", "Not found\n");
+	}
+
+	size_t sent = 0;
+	while (sent < response.size())
+	{
+		const iovec remaining{ response.data() + sent, response.size() - sent };
+		const ssize_t bytes = client.sendSome(&remaining, 1);
+		if (bytes <= 0)
+		{
+			if (bytes == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+		sent += static_cast<size_t>(bytes);
+	}
+}
+
+void AdminServer::shutdown()
+{
+	m_stopRequested = true;
+}
+
+std::string AdminServer::getLocalAddress() const
+{
+	return m_server.getLocalAddress();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include "../socket/TcpServer.h"
+
+// Minimal HTTP endpoint on its own port and thread: GET /metrics returns the metrics
+// registry in Prometheus text format. Requests are served one at a time, which is plenty
+// for a scraper and keeps the admin path off the reactors entirely.
+class AdminServer
+{
+public:
+	// reusePort lets the process replacing this one bind the port while this one still runs
+	explicit AdminServer(unsigned short port, bool reusePort = false);
+
+	void run();
+	void shutdown();
+
+	std::string getLocalAddress() const;
+
+private:
+	void serveClient(TcpClient& client) const;
+
+	TcpServer m_server;
+	std::atomic<bool> m_stopRequested = false;
+};
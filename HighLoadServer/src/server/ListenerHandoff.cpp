@@ -0,0 +1,184 @@
+#include "ListenerHandoff.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../common/Logger.h"
+
+constexpr int stopCheckIntervalMs = 250;
+// How long the successor may take to build its server and confirm
+constexpr int confirmTimeoutMs = 30'000;
+// Most descriptors one SCM_RIGHTS message can carry (the kernel's SCM_MAX_FD)
+constexpr size_t maxListeners = 253;
+constexpr char confirmByte = '!';
+
+ListenerHandoff::ListenerHandoff(std::string path)
+	: m_path(std::move(path))
+{
+	if (m_path.empty() || m_path.size() >= sizeof(sockaddr_un::sun_path))
+	{
+		throw std::runtime_error("Invalid handoff socket path: " + m_path);
+	}
+}
+
+sockaddr_un ListenerHandoff::address() const
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	std::memcpy(addr.sun_path, m_path.data(), m_path.size());
+	return addr;
+}
+
+std::vector<int> ListenerHandoff::takeListeners()
+{
+	Socket predecessor(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	const sockaddr_un addr = address();
+	if (!predecessor.isValid()
+		|| connect(predecessor.getHandle(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1)
+	{
+		// First start, or the last process exited without handing over
+		LOG_INFO("No server to take over at {}: {}", m_path, strerror(errno));
+		return {};
+	}
+
+	uint32_t count = 0;
+	iovec payload{ &count, sizeof(count) };
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxListeners)];
+	msghdr message{};
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t received;
+	do
+	{
+		received = recvmsg(predecessor.getHandle(), &message, MSG_CMSG_CLOEXEC);
+	} while (received == -1 && errno == EINTR);
+
+	std::vector<int> listeners;
+	for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+	{
+		if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+		{
+			const size_t offset = listeners.size();
+			listeners.resize(offset + (header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+			std::memcpy(listeners.data() + offset, CMSG_DATA(header), (listeners.size() - offset) * sizeof(int));
+		}
+	}
+
+	if (received != sizeof(count) || listeners.size() != count || (message.msg_flags & MSG_CTRUNC))
+	{
+		LOG_ERROR("Takeover from {} failed, binding new listeners", m_path);
+		for (int listener: listeners)
+		{
+			::close(listener);
+		}
+		return {};
+	}
+
+	LOG_INFO("Took over {} listener(s) from the server at {}", listeners.size(), m_path);
+	m_predecessor = std::move(predecessor);
+	return listeners;
+}
+
+void ListenerHandoff::confirm()
+{
+	if (!m_predecessor.isValid())
+	{
+		return;
+	}
+	if (::send(m_predecessor.getHandle(), &confirmByte, 1, MSG_NOSIGNAL) != 1)
+	{
+		LOG_ERROR("Failed to confirm the takeover: {}", strerror(errno));
+	}
+	m_predecessor.close();
+}
+
+void ListenerHandoff::run(const std::vector<int>& listeners, const std::function<void()>& onHandedOff)
+{
+	Socket server(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	const sockaddr_un addr = address();
+	// Takes the path over from the predecessor, or from a process that exited without a handoff
+	::unlink(m_path.c_str());
+	if (!server.isValid()
+		|| bind(server.getHandle(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1
+		|| ::listen(server.getHandle(), 1) == -1)
+	{
+		LOG_ERROR("Handoff socket {} unavailable: {}", m_path, strerror(errno));
+		return;
+	}
+	LOG_INFO("Listeners can be taken over at {}", m_path);
+
+	while (!m_stopRequested)
+	{
+		pollfd listener{ server.getHandle(), POLLIN, 0 };
+		const int ready = poll(&listener, 1, stopCheckIntervalMs);
+		if (ready == -1 && errno != EINTR)
+		{
+			LOG_ERROR("Handoff poll failed: {}", strerror(errno));
+			break;
+		}
+		if (ready <= 0)
+		{
+			continue;
+		}
+
+		Socket successor(accept4(server.getHandle(), nullptr, nullptr, SOCK_CLOEXEC));
+		if (successor.isValid() && handOver(successor, listeners))
+		{
+			LOG_INFO("Listeners taken over through {}. Draining...", m_path);
+			onHandedOff();
+			return;
+		}
+	}
+}
+
+bool ListenerHandoff::handOver(const Socket& successor, const std::vector<int>& listeners) const
+{
+	if (listeners.empty() || listeners.size() > maxListeners)
+	{
+		LOG_ERROR("Cannot hand over {} listener(s)", listeners.size());
+		return false;
+	}
+
+	uint32_t count = static_cast<uint32_t>(listeners.size());
+	iovec payload{ &count, sizeof(count) };
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxListeners)] = {};
+	msghdr message{};
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = CMSG_SPACE(sizeof(int) * listeners.size());
+
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int) * listeners.size());
+	std::memcpy(CMSG_DATA(header), listeners.data(), sizeof(int) * listeners.size());
+
+	if (sendmsg(successor.getHandle(), &message, MSG_NOSIGNAL) != sizeof(count))
+	{
+		LOG_ERROR("Failed to hand over {} listener(s): {}", listeners.size(), strerror(errno));
+		return false;
+	}
+
+	// Until the successor confirms, it may still fail to start: keep accepting meanwhile
+	pollfd reply{ successor.getHandle(), POLLIN, 0 };
+	char confirmation = 0;
+	if (poll(&reply, 1, confirmTimeoutMs) != 1 || ::recv(successor.getHandle(), &confirmation, 1, 0) != 1
+		|| confirmation != confirmByte)
+	{
+		LOG_WARN("The process taking over at {} went away without confirming", m_path);
+		return false;
+	}
+	return true;
+}
+
+void ListenerHandoff::shutdown()
+{
+	m_stopRequested = true;
+}
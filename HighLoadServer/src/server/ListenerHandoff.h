@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/un.h>
+#include "../socket/Socket.h"
+
+// Hot restart: a running server hands its listening sockets to the process replacing it over
+// a Unix domain socket at path, with SCM_RIGHTS. Both processes then hold the same sockets,
+// so connections keep queueing on them throughout: none is refused, and the new process
+// accepts as soon as its reactors run.
+//  1. The successor connects to path and receives the listeners (takeListeners()).
+//  2. It builds its server on them and confirms (confirm()).
+//  3. The predecessor, told through onHandedOff, stops accepting and drains its connections.
+//  4. The successor serves path from then on (run()) for the restart after.
+class ListenerHandoff
+{
+public:
+	explicit ListenerHandoff(std::string path);
+
+	// Successor side: the listeners of the process serving path, none when no process does
+	std::vector<int> takeListeners();
+	// Tells the predecessor, if there was one, that its listeners are served here now
+	void confirm();
+
+	// Predecessor side: offers listeners to every process that connects until one of them
+	// confirms, then calls onHandedOff and returns. Also returns on shutdown().
+	void run(const std::vector<int>& listeners, const std::function<void()>& onHandedOff);
+	void shutdown();
+
+private:
+	sockaddr_un address() const;
+	// True once the successor has confirmed
+	bool handOver(const Socket& successor, const std::vector<int>& listeners) const;
+
+	std::string m_path;
+	Socket m_predecessor;
+	std::atomic<bool> m_stopRequested = false;
+};
@@ -0,0 +1,28 @@
+#include "QueryHandler.h"
+#include <utility>
+#include "../common/Logger.h"
+#include "../common/WireProtocol.h"
+
+ServerBackend::MessageHandler makeQueryHandler(std::string serverName, int serverNumber)
+{
+	return [serverName = std::move(serverName), serverNumber](std::string_view request, WireProtocol protocol, std::string& response) {
+		const auto query = parseQueryFrame(protocol, request);
+		if (!query)
+		{
+			LOG_WARN("Malformed query, closing connection.");
+			return;
+		}
+
+		const auto [clientName, clientNumber] = *query;
+		if (clientNumber < 0 || clientNumber > 100)
+		{
+			LOG_WARN("Invalid client number ({}), closing connection.", clientNumber);
+			return;
+		}
+
+		// Per request, so below the default level: the record alone costs more than the answer
+		LOG_DEBUG("Query from {}: {} + {} = {}", clientName, clientNumber, serverNumber, clientNumber + serverNumber);
+
+		appendQueryFrame(protocol, response, serverName, serverNumber);
+	};
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+#include "../socket/ServerBackend.h"
+
+// The message handler Server answers queries with: serverName and serverNumber, one frame in
+// the request's protocol. Malformed queries and client numbers outside 0..100 are rejected.
+// Allocates nothing once the response buffer has grown to fit.
+ServerBackend::MessageHandler makeQueryHandler(std::string serverName, int serverNumber);
@@ -1,46 +1,45 @@
 #include "Server.h"
-#include <iostream>
 #include <memory>
-#include "../common/constructQuery.h"
-#include "../common/parseQuery.h"
-#include "../common/printInfo.h"
+#include "QueryHandler.h"
+#include "../common/Logger.h"
 
-Server::Server(unsigned short port, std::string name)
-	: m_epollServer(port)
+Server::Server(unsigned short port, std::string name, ServerConfig config, DispatchPolicy dispatch, HandlerKind handler)
+	: m_backend(makeServerBackend(port, config))
 	, m_name("Server of " + std::move(name))
+	, m_dispatch(dispatch)
+	, m_handler(handler)
 {
 }
 
 void Server::run()
 {
-	m_epollServer.setMessageHandler([this](const std::string& request) -> std::string {
-		try
-		{
-			const auto [clientName, clientNumber] = parseQuery(request);
-
-			if (clientNumber < 0 || clientNumber > 100)
-			{
-				std::osyncstream(std::cout) << "Invalid client number (" << clientNumber << "), closing connection." << std::endl;
-				return "";
-			}
-
-			printInfo(clientName, m_name, clientNumber, SERVER_NUMBER);
-
-			return constructQuery({m_name, SERVER_NUMBER});
-		}
-		catch (const std::exception& e)
-		{
-			std::osyncstream(std::cerr) << "Error handling client " << ": " << e.what() << std::endl;
-			return "";
-		}
-	});
-
-	std::osyncstream(std::cout) << "Starting server on " << m_epollServer.getLocalAddress() << std::endl << std::endl;
-
-	m_epollServer.run();
+	auto answerQuery = makeQueryHandler(m_name, SERVER_NUMBER);
+
+	if (m_handler == HandlerKind::Coroutine)
+	{
+		m_backend->setConnectionHandler(asConnectionHandler(answerQuery));
+	}
+	else
+	{
+		m_backend->setMessageHandler(answerQuery, m_dispatch);
+	}
+
+	LOG_INFO("Starting server on {}", m_backend->getLocalAddress());
+
+	m_backend->run();
 }
 
 void Server::shutdown()
 {
-	m_epollServer.shutdown();
+	m_backend->shutdown();
+}
+
+size_t Server::getReactorCount() const
+{
+	return m_backend->getReactorCount();
+}
+
+std::vector<int> Server::getListeners() const
+{
+	return m_backend->getListeners();
 }
@@ -1,17 +1,36 @@
 #pragma once
 
+#include <memory>
 #include <string>
-#include "../socket/EpollServer.h"
+#include <vector>
+#include "../socket/ServerBackend.h"
+
+// How Server registers its query handler with the backend
+enum class HandlerKind
+{
+	// As a MessageHandler run according to the dispatch policy
+	Message,
+	// As a coroutine per connection on the reactor thread (ConnectionHandler); epoll only
+	Coroutine
+};
 
 class Server
 {
 public:
-	Server(unsigned short port, std::string name);
+	// dispatch says where the query handler runs (see DispatchPolicy); a Coroutine handler
+	// ignores it
+	Server(unsigned short port, std::string name, ServerConfig config = {}, DispatchPolicy dispatch = DispatchPolicy::Pool,
+		   HandlerKind handler = HandlerKind::Message);
 	void run();
 	void shutdown();
 
+	size_t getReactorCount() const;
+	std::vector<int> getListeners() const;
+
 private:
-	EpollServer m_epollServer;
+	std::unique_ptr<ServerBackend> m_backend;
 	std::string m_name;
+	DispatchPolicy m_dispatch;
+	HandlerKind m_handler;
 	static constexpr int SERVER_NUMBER = 50;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "AdmissionControl.h"
+#include <algorithm>
+#include <functional>
+
+AdmissionControl::AdmissionControl(Executor& pool, const ServerConfig& config)
+	: m_pool(pool), m_policy(config.overloadPolicy)
+	, m_fairness(config.fairness), m_highPriorityNames(config.highPriorityNames), m_lowPriorityNames(config.lowPriorityNames)
+{
+	if (config.codelTarget.count() > 0)
+	{
+		m_codel = std::make_unique<CoDel>(config.codelTarget, config.codelInterval);
+	}
+}
+
+TaskTag AdmissionControl::tagRequest(std::string_view request, WireProtocol protocol, uint64_t connection) const
+{
+	TaskTag tag;
+	if (m_fairness == FairnessKey::Connection)
+	{
+		tag.key = connection;
+	}
+	const bool byName = !m_highPriorityNames.empty() || !m_lowPriorityNames.empty();
+	if (m_fairness != FairnessKey::ClientName && !byName)
+	{
+		return tag;
+	}
+
+	// A request that does not parse goes by the empty name; the handler will refuse it
+	const auto query = parseQueryFrame(protocol, request);
+	const std::string_view name = query ? query->name : std::string_view{};
+	if (m_fairness == FairnessKey::ClientName)
+	{
+		tag.key = std::hash<std::string_view>{}(name);
+	}
+	if (std::ranges::find(m_highPriorityNames, name) != m_highPriorityNames.end())
+	{
+		tag.lane = TaskLane::High;
+	}
+	else if (std::ranges::find(m_lowPriorityNames, name) != m_lowPriorityNames.end())
+	{
+		tag.lane = TaskLane::Low;
+	}
+	return tag;
+}
+
+AdmissionControl::Result AdmissionControl::submit(Task& task, TaskTag tag, size_t requestCount)
+{
+	if (m_policy == OverloadPolicy::Block)
+	{
+		enqueueBlocking(task, tag);
+		return Result::Queued;
+	}
+
+	if (retry(task, tag))
+	{
+		return Result::Queued;
+	}
+	if (m_policy == OverloadPolicy::Reject)
+	{
+		m_metrics.queueFullSheds.inc(requestCount);
+		return Result::Rejected;
+	}
+	return Result::Deferred;
+}
+
+AdmissionControl::Result AdmissionControl::submitBatch(Task& task, size_t requestCount)
+{
+	if (m_policy == OverloadPolicy::PauseReading)
+	{
+		enqueueBlocking(task, {});
+		return Result::Queued;
+	}
+	return submit(task, {}, requestCount);
+}
+
+void AdmissionControl::enqueueBlocking(Task& task, TaskTag tag)
+{
+	m_metrics.poolQueueDepth.add(1);
+	m_pool.enqueue(std::move(task), tag);
+}
+
+bool AdmissionControl::retry(Task& task, TaskTag tag)
+{
+	// Counted before the task can start and count itself out
+	m_metrics.poolQueueDepth.add(1);
+	const EnqueueResult result = m_pool.tryEnqueue(task, tag);
+	if (result != EnqueueResult::Queued)
+	{
+		// Nothing will count out a task that was refused or discarded
+		m_metrics.poolQueueDepth.add(-1);
+	}
+	// A discarded task is as good as queued: the pool is stopping and it will never run
+	return result != EnqueueResult::Full;
+}
+
+bool AdmissionControl::admit(Clock::time_point enqueuedAt, Clock::time_point startedAt, size_t requestCount)
+{
+	m_metrics.poolQueueDepth.add(-1);
+	m_metrics.poolQueueWait.record(ServerMetrics::elapsedNs(enqueuedAt, startedAt));
+
+	if (m_codel && m_codel->shouldShed(startedAt - enqueuedAt, startedAt))
+	{
+		m_metrics.codelSheds.inc(requestCount);
+		return false;
+	}
+	return true;
+}
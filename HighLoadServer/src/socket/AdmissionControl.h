@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ServerBackend.h"
+#include "ServerMetrics.h"
+#include "../common/CoDel.h"
+#include "../common/Executor.h"
+
+// Stands between the reactors and the worker pool of one server and applies its overload
+// settings: the queue bound with the overload policy when a request arrives, CoDel when a
+// worker picks the request up. Keeps the queue depth gauge and the shed counters. Also
+// tags requests for the pool's lanes and fair queuing by the fairness settings.
+class AdmissionControl
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class Result
+	{
+		Queued,
+		// The queue is full: answer busy now
+		Rejected,
+		// The queue is full: hold on to the task, stop reading and retry() later
+		Deferred
+	};
+
+	AdmissionControl(Executor& pool, const ServerConfig& config);
+
+	AdmissionControl(const AdmissionControl&) = delete;
+	AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+	// Where a request queues; connection is any number that tells the reactors' connections
+	// apart (their sockets)
+	TaskTag tagRequest(std::string_view request, WireProtocol protocol, uint64_t connection) const;
+
+	// task, which carries requestCount requests, is moved from only when the result is Queued
+	Result submit(Task& task, TaskTag tag = {}, size_t requestCount = 1);
+	// Submits a Deferred task again, with the tag it was submitted with; false while the
+	// queue is still full
+	bool retry(Task& task, TaskTag tag = {});
+	// For a task carrying the requests of many connections, none of which can pause for it:
+	// under PauseReading it waits for room as under Block. Never Deferred. Queued untagged,
+	// as it belongs to no one client.
+	Result submitBatch(Task& task, size_t requestCount);
+
+	// Called by the worker as it takes the request off the queue; false when the request has
+	// waited so long that it should be answered busy instead of handled
+	bool admit(Clock::time_point enqueuedAt, Clock::time_point startedAt, size_t requestCount = 1);
+
+	[[nodiscard]] OverloadPolicy policy() const { return m_policy; }
+
+private:
+	void enqueueBlocking(Task& task, TaskTag tag);
+
+	Executor& m_pool;
+	const OverloadPolicy m_policy;
+	std::unique_ptr<CoDel> m_codel;
+
+	const FairnessKey m_fairness;
+	const std::vector<std::string> m_highPriorityNames;
+	const std::vector<std::string> m_lowPriorityNames;
+
+	ServerMetrics& m_metrics = ServerMetrics::instance();
+};
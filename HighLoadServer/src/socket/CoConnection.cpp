@@ -0,0 +1,45 @@
+#include "CoConnection.h"
+#include <utility>
+
+CoConnection::CoConnection(TimerWheel& timers, std::deque<std::string>& outbound, BufferPool& buffers, uint64_t timerUserData, int timerKind)
+	: m_timers(timers), m_outbound(outbound), m_buffers(buffers)
+{
+	m_sleepTimer.userData = timerUserData;
+	m_sleepTimer.kind = timerKind;
+}
+
+void CoConnection::SleepAwaiter::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+	connection.m_timers.arm(connection.m_sleepTimer, Clock::now() + duration);
+	connection.suspend(Waiting::Sleep, waiter);
+}
+
+CoConnection::WriteAwaiter CoConnection::write(std::string response)
+{
+	if (!response.empty())
+	{
+		m_queuedBytes += response.size();
+		m_outbound.push_back(std::move(response));
+	}
+	return { *this };
+}
+
+void CoConnection::resumeRead(std::optional<std::string_view> request, WireProtocol protocol)
+{
+	m_request = request;
+	m_endOfStream = !request;
+	m_protocol = protocol;
+	resume();
+}
+
+void CoConnection::resume()
+{
+	m_waiting = Waiting::Nothing;
+	std::exchange(m_waiter, nullptr).resume();
+}
+
+void CoConnection::suspend(Waiting waiting, std::coroutine_handle<> waiter)
+{
+	m_waiting = waiting;
+	m_waiter = waiter;
+}
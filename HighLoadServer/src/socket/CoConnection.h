@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "../common/BufferPool.h"
+#include "../common/CoTask.h"
+#include "../common/TimerWheel.h"
+#include "../common/WireProtocol.h"
+
+// A client connection as a coroutine handler sees it (ServerBackend::ConnectionHandler).
+// The reactor that owns the connection completes its awaitables and resumes the handler on
+// the reactor thread, so a handler waiting for the peer, for its writes to drain or for a
+// timer holds no thread, and one reactor can keep thousands of them in flight. At most one
+// operation may be pending at a time.
+//
+// The reactor reads from the socket only while the handler waits in read(): a handler that
+// is busy elsewhere leaves further requests in the kernel buffer and the peer is throttled.
+class CoConnection
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Bytes waiting to be sent beyond which write() suspends until the peer catches up
+	static constexpr size_t writeHighWater = 256 * 1024;
+
+	enum class Waiting
+	{
+		Nothing,
+		Read,
+		Write,
+		Sleep
+	};
+
+	// Responses are appended to outbound and, once sent, go back to buffers; the sleep timer
+	// is armed on timers and carries timerUserData and timerKind so that the reactor can tell
+	// it apart when it expires
+	CoConnection(TimerWheel& timers, std::deque<std::string>& outbound, BufferPool& buffers, uint64_t timerUserData, int timerKind);
+
+	CoConnection(const CoConnection&) = delete;
+	CoConnection& operator=(const CoConnection&) = delete;
+
+	struct ReadAwaiter
+	{
+		CoConnection& connection;
+
+		bool await_ready() const noexcept { return connection.m_endOfStream; }
+		void await_suspend(std::coroutine_handle<> waiter) noexcept { connection.suspend(Waiting::Read, waiter); }
+		std::optional<std::string_view> await_resume() const noexcept { return connection.m_request; }
+	};
+
+	struct WriteAwaiter
+	{
+		CoConnection& connection;
+
+		bool await_ready() const noexcept { return connection.m_queuedBytes <= writeHighWater; }
+		void await_suspend(std::coroutine_handle<> waiter) noexcept { connection.suspend(Waiting::Write, waiter); }
+		void await_resume() const noexcept {}
+	};
+
+	struct SleepAwaiter
+	{
+		CoConnection& connection;
+		Clock::duration duration;
+
+		bool await_ready() const noexcept { return duration <= Clock::duration::zero(); }
+		void await_suspend(std::coroutine_handle<> waiter) noexcept;
+		void await_resume() const noexcept {}
+	};
+
+	// The next request frame, framing included, as MessageHandler receives it; std::nullopt
+	// once the peer has closed, at once for every read() after that. The view stays valid
+	// until the next read().
+	[[nodiscard]] ReadAwaiter read() { return { *this }; }
+
+	// Queues response, one frame in protocol(), at once; awaiting the result waits while more
+	// than writeHighWater bytes have yet to reach the socket
+	[[nodiscard]] WriteAwaiter write(std::string response);
+	// An empty string to build a response in, reusing the memory of one already sent
+	[[nodiscard]] std::string buffer() { return m_buffers.take(); }
+
+	// Resumes after at least duration, rounded up to the reactor's timer tick (100 ms)
+	[[nodiscard]] SleepAwaiter sleep(Clock::duration duration) { return { *this, duration }; }
+
+	// Protocol of the requests read so far: Text until the first one arrives
+	[[nodiscard]] WireProtocol protocol() const { return m_protocol; }
+
+	// Reactor side
+	[[nodiscard]] Waiting waiting() const { return m_waiting; }
+	[[nodiscard]] size_t queuedBytes() const { return m_queuedBytes; }
+	// size bytes of queued responses went out
+	void sent(size_t size) { m_queuedBytes -= size; }
+	// Completes the pending read() with request, or with the end of the stream
+	void resumeRead(std::optional<std::string_view> request, WireProtocol protocol);
+	// Completes the pending write() or sleep()
+	void resume();
+
+private:
+	void suspend(Waiting waiting, std::coroutine_handle<> waiter);
+
+	TimerWheel& m_timers;
+	std::deque<std::string>& m_outbound;
+	BufferPool& m_buffers;
+	TimerWheel::Timer m_sleepTimer;
+
+	Waiting m_waiting = Waiting::Nothing;
+	std::coroutine_handle<> m_waiter;
+	std::optional<std::string_view> m_request;
+	WireProtocol m_protocol = WireProtocol::Text;
+	bool m_endOfStream = false;
+	size_t m_queuedBytes = 0;
+};
@@ -0,0 +1,730 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "EpollReactor.h"
+#include "../common/Logger.h"
+
+constexpr std::chrono::seconds clientTimeout{ 10 };
+constexpr std::chrono::seconds writeTimeout{ 10 };
+constexpr size_t readChunkSize = 4096;
+// Reads of one connection per wakeup, so that a client that keeps sending neither grows its
+// buffer without bound before the frame limit is checked nor starves the other connections
+constexpr int maxReadsPerWakeup = 16;
+constexpr size_t maxIoVectors = std::min(64, IOV_MAX);
+// Nothing signals that the pool has room again, so paused connections retry this often
+constexpr int pausedRetryMs = 1;
+// An adaptive spin shorter than this share of the busy-poll budget is not worth starting
+constexpr int spinBudgetSteps = 16;
+
+// epoll tokens for the non-client descriptors: packed SlotHandles with the reserved
+// generation, which SlotTable::emplace skips, so no client token can take these values
+constexpr uint64_t listenerToken = UINT64_MAX;
+constexpr uint64_t wakeToken = UINT64_MAX - 1;
+constexpr uint64_t sharedListenerToken = UINT64_MAX - 2;
+static_assert(SlotHandle::unpack(sharedListenerToken).generation == SlotHandle::reservedGeneration);
+
+EpollReactor::EpollReactor(TcpServer listener, int maxEvents, AdmissionControl& admission,
+						   const MessageHandler& onMessage, const ConnectionHandler& onConnection)
+	: m_server(std::move(listener))
+	, m_maxEvents(maxEvents), m_onConnection(onConnection), m_pipeline(admission, onMessage)
+{
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epollFd == -1)
+	{
+		throw std::runtime_error("epoll_create1 failed: " + std::string(strerror(errno)));
+	}
+
+	int flags = fcntl(m_server.getHandle(), F_GETFL, 0);
+	fcntl(m_server.getHandle(), F_SETFL, flags | O_NONBLOCK);
+
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u64 = listenerToken;
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_server.getHandle(), &event) == -1)
+	{
+		close(m_epollFd);
+		throw std::runtime_error("epoll_ctl(server) failed: " + std::string(strerror(errno)));
+	}
+
+	event.events = EPOLLIN;
+	event.data.u64 = wakeToken;
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_pipeline.getWakeFd(), &event) == -1)
+	{
+		close(m_epollFd);
+		throw std::runtime_error("epoll_ctl(eventfd) failed: " + std::string(strerror(errno)));
+	}
+}
+
+EpollReactor::~EpollReactor()
+{
+	if (m_epollFd != -1)
+	{
+		close(m_epollFd);
+	}
+}
+
+bool EpollReactor::steerIncomingCpu(int cpu)
+{
+	return m_server.setIncomingCpu(cpu);
+}
+
+bool EpollReactor::shareListener(const TcpServer& listener)
+{
+	int flags = fcntl(listener.getHandle(), F_GETFL, 0);
+	fcntl(listener.getHandle(), F_SETFL, flags | O_NONBLOCK);
+
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLEXCLUSIVE;
+	event.data.u64 = sharedListenerToken;
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, listener.getHandle(), &event) == -1)
+	{
+		LOG_ERROR("epoll_ctl(shared listener) failed: {}", strerror(errno));
+		return false;
+	}
+	m_sharedListener = &listener;
+	return true;
+}
+
+void EpollReactor::setDispatchPolicy(DispatchPolicy dispatch)
+{
+	m_pipeline.setDispatchPolicy(dispatch);
+}
+
+void EpollReactor::setBusyPoll(const BusyPollConfig& busyPoll)
+{
+	m_busyPoll = busyPoll;
+	m_spinBudget = busyPoll.budget;
+	m_socketBusyPoll = busyPoll.socketPoll.count() > 0;
+}
+
+void EpollReactor::run()
+{
+	std::vector<epoll_event> events(m_maxEvents);
+
+	while (true)
+	{
+		if (m_stopRequested && m_clientsInfo.empty())
+		{
+			break;
+		}
+
+		int timeoutMs = m_timers.nextTimeoutMs(std::chrono::steady_clock::now());
+		if (!m_pausedClients.empty())
+		{
+			timeoutMs = timeoutMs < 0 ? pausedRetryMs : std::min(timeoutMs, pausedRetryMs);
+		}
+		if (!m_dirtyClients.empty())
+		{
+			// Sessions resumed by the last flush have written more
+			timeoutMs = 0;
+		}
+		int numEvents = waitForEvents(events, timeoutMs);
+		if (numEvents == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (!m_stopRequested)
+			{
+				LOG_ERROR("epoll_wait error: {}", strerror(errno));
+			}
+			break;
+		}
+
+		checkTimeouts();
+
+		for (int i = 0; i < numEvents; ++i)
+		{
+			const uint64_t token = events[i].data.u64;
+			const uint32_t ready = events[i].events;
+
+			if (token == listenerToken)
+			{
+				handleNewConnection(m_server);
+				continue;
+			}
+			if (token == sharedListenerToken)
+			{
+				// Another reactor woken for the same connection may have taken it already
+				handleNewConnection(*m_sharedListener);
+				continue;
+			}
+			if (token == wakeToken)
+			{
+				processCompletions();
+				continue;
+			}
+
+			// Stale when an earlier event in this batch closed the connection
+			ClientInfo* info = m_clientsInfo.get(SlotHandle::unpack(token));
+			if (!info)
+			{
+				continue;
+			}
+
+			if ((ready & EPOLLOUT) && !flushOutbound(*info))
+			{
+				continue;
+			}
+
+			if (ready & EPOLLIN)
+			{
+				// Reads until EAGAIN, so queries sent right before a hang-up are still served
+				handleClientData(*info);
+			}
+			else if (ready & (EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+			{
+				LOG_DEBUG("Client disconnected: {}", info->tcp.getHandle());
+				removeClient(*info);
+			}
+		}
+
+		resumeReading();
+		m_pipeline.submitBatch();
+		// One gathered write per connection for everything answered in this batch
+		flushDirtyClients();
+	}
+}
+
+int EpollReactor::waitForEvents(std::vector<epoll_event>& events, int timeoutMs)
+{
+	if (timeoutMs == 0 || m_busyPoll.budget.count() == 0)
+	{
+		return epoll_wait(m_epollFd, events.data(), m_maxEvents, timeoutMs);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+	auto spinUntil = start + m_spinBudget;
+	if (timeoutMs > 0)
+	{
+		spinUntil = std::min(spinUntil, start + std::chrono::milliseconds(timeoutMs));
+	}
+
+	auto now = start;
+	while (now < spinUntil)
+	{
+		const int numEvents = epoll_wait(m_epollFd, events.data(), m_maxEvents, 0);
+		now = Clock::now();
+		if (numEvents != 0)
+		{
+			m_metrics.busyPollSpin.record(ServerMetrics::elapsedNs(start, now));
+			m_metrics.busyPollHits.inc();
+			return numEvents;
+		}
+	}
+
+	if (now != start)
+	{
+		// Ran out with nothing to show for it: spin shorter next time, down to not at all
+		m_metrics.busyPollSpin.record(ServerMetrics::elapsedNs(start, now));
+		m_metrics.busyPollMisses.inc();
+		m_spinBudget /= 2;
+		if (m_spinBudget < m_busyPoll.budget / spinBudgetSteps)
+		{
+			m_spinBudget = {};
+		}
+		if (timeoutMs > 0)
+		{
+			timeoutMs = std::max(0, timeoutMs - static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count()));
+		}
+	}
+
+	const int numEvents = epoll_wait(m_epollFd, events.data(), m_maxEvents, timeoutMs);
+	if (numEvents > 0 && Clock::now() - now < m_busyPoll.budget)
+	{
+		// Woken sooner than a full spin would have lasted: spinning would have caught it
+		m_spinBudget = std::min<std::chrono::nanoseconds>(std::max<std::chrono::nanoseconds>(2 * m_spinBudget, m_busyPoll.budget / spinBudgetSteps), m_busyPoll.budget);
+	}
+	return numEvents;
+}
+
+void EpollReactor::handleNewConnection(const TcpServer& listener)
+{
+	auto client = listener.accept();
+	if (!client || !client->isValid())
+	{
+		return;
+	}
+
+	int clientFd = client->getHandle();
+
+	int flags = fcntl(clientFd, F_GETFL, 0);
+	fcntl(clientFd, F_SETFL, flags | O_NONBLOCK);
+	if (m_socketBusyPoll && !client->setBusyPoll(m_busyPoll.socketPoll))
+	{
+		LOG_WARN("SO_BUSY_POLL refused ({}); accepted sockets keep the default", strerror(errno));
+		m_socketBusyPoll = false;
+	}
+
+	auto [handle, info] = m_clientsInfo.emplace(static_cast<uint32_t>(clientFd), std::move(*client));
+	info.handle = handle;
+
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.u64 = handle.pack();
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, clientFd, &event) == -1)
+	{
+		LOG_ERROR("Failed to add client socket to epoll: {}", strerror(errno));
+		m_clientsInfo.erase(handle);
+		return;
+	}
+
+	info.idleTimer.userData = handle.pack();
+	info.idleTimer.kind = IdleTimeout;
+	info.writeTimer.userData = handle.pack();
+	info.writeTimer.kind = WriteTimeout;
+	m_timers.arm(info.idleTimer, std::chrono::steady_clock::now() + clientTimeout);
+	m_clientCount = m_clientsInfo.size();
+	m_metrics.accepts.inc();
+	m_metrics.activeConnections.add(1);
+	m_tracer.record(m_tracer.sample(), TraceStage::Accept, clientFd);
+	LOG_DEBUG("Client connected: {}", clientFd);
+
+	if (m_onConnection)
+	{
+		startSession(info);
+	}
+}
+
+void EpollReactor::handleClientData(ClientInfo& info)
+{
+	const int clientFd = info.tcp.getHandle();
+	bool peerClosed = false;
+
+	// Drain the socket: a single wakeup may carry several pipelined queries or only part of one.
+	// Whatever is left after maxReadsPerWakeup reads is reported again by the next epoll_wait.
+	for (int reads = 0; reads < maxReadsPerWakeup;)
+	{
+		auto space = info.decoder.prepareWrite(readChunkSize);
+		const ssize_t bytes = info.tcp.receiveSome(space.data(), space.size());
+		if (bytes > 0)
+		{
+			info.decoder.commitWrite(static_cast<size_t>(bytes));
+			m_metrics.bytesReceived.inc(static_cast<uint64_t>(bytes));
+			++reads;
+			continue;
+		}
+		if (bytes == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		if (bytes == -1)
+		{
+			LOG_ERROR("recv failed on client {}: {}", clientFd, strerror(errno));
+		}
+		peerClosed = true;
+		break;
+	}
+
+	m_timers.arm(info.idleTimer, std::chrono::steady_clock::now() + clientTimeout);
+	if (m_tracer.isEnabled())
+	{
+		info.stream.readTicks = traceTicks();
+	}
+
+	if (info.connection)
+	{
+		// The session learns of the close from its read()
+		if (peerClosed)
+		{
+			info.peerClosed = true;
+			updateInterest(info);
+		}
+		driveSession(info);
+		return;
+	}
+
+	if (!processFrames(info))
+	{
+		pauseReading(info);
+	}
+	else if (info.decoder.isOverflowed())
+	{
+		LOG_WARN("Client {} sent an oversized query. Closing.", clientFd);
+		removeClient(info);
+		return;
+	}
+	else if (info.decoder.isMalformed())
+	{
+		LOG_WARN("Client {} sent a malformed binary frame. Closing.", clientFd);
+		removeClient(info);
+		return;
+	}
+
+	if (peerClosed)
+	{
+		// The peer may have only shut down its write side: answer what is in flight first
+		LOG_DEBUG("Client closed or recv error: {}", clientFd);
+		info.peerClosed = true;
+		if (info.stream.sequencer.idle() && info.stream.outbound.empty())
+		{
+			removeClient(info);
+		}
+		else
+		{
+			updateInterest(info);
+		}
+	}
+}
+
+bool EpollReactor::processFrames(ClientInfo& info)
+{
+	while (auto frame = info.decoder.next())
+	{
+		if (info.stream.closeAfterFlush)
+		{
+			continue;
+		}
+		const auto dispatched = m_pipeline.dispatch(info.stream, info.handle, info.tcp.getHandle(), *frame, info.decoder.protocol());
+		if (dispatched == RequestPipeline::Dispatched::Deferred)
+		{
+			return false;
+		}
+		if (dispatched == RequestPipeline::Dispatched::Answered)
+		{
+			m_dirtyClients.push_back(info.handle);
+		}
+	}
+	return true;
+}
+
+void EpollReactor::pauseReading(ClientInfo& info)
+{
+	info.readPaused = true;
+	updateInterest(info);
+	m_pausedClients.push_back(info.handle);
+	m_metrics.readPauses.inc();
+}
+
+void EpollReactor::resumeReading()
+{
+	std::erase_if(m_pausedClients, [this](SlotHandle connection) {
+		ClientInfo* info = m_clientsInfo.get(connection);
+		if (!info)
+		{
+			return true;
+		}
+		if (!m_pipeline.retry(info->stream))
+		{
+			return false;
+		}
+
+		// Requests already buffered go before anything new is read
+		if (!processFrames(*info))
+		{
+			return false;
+		}
+		info->readPaused = false;
+		updateInterest(*info);
+		return true;
+	});
+}
+
+void EpollReactor::startSession(ClientInfo& info)
+{
+	info.connection.emplace(m_timers, info.stream.outbound, m_pipeline.buffers(), info.handle.pack(), SleepTimeout);
+	try
+	{
+		info.session = m_onConnection(*info.connection);
+	}
+	catch (const std::exception& ex)
+	{
+		LOG_ERROR("Error in connection handler: {}", ex.what());
+		removeClient(info);
+		return;
+	}
+
+	info.session.start();
+	driveSession(info);
+}
+
+void EpollReactor::driveSession(ClientInfo& info)
+{
+	if (info.stream.closeAfterFlush)
+	{
+		return;
+	}
+
+	CoConnection& connection = *info.connection;
+	while (!info.session.done())
+	{
+		const CoConnection::Waiting waiting = connection.waiting();
+		if (waiting == CoConnection::Waiting::Read)
+		{
+			if (auto frame = info.decoder.next())
+			{
+				connection.resumeRead(*frame, info.decoder.protocol());
+				continue;
+			}
+			if (info.decoder.isOverflowed())
+			{
+				LOG_WARN("Client {} sent an oversized query. Closing.", info.tcp.getHandle());
+				info.stream.closeAfterFlush = true;
+				break;
+			}
+			if (info.decoder.isMalformed())
+			{
+				LOG_WARN("Client {} sent a malformed binary frame. Closing.", info.tcp.getHandle());
+				info.stream.closeAfterFlush = true;
+				break;
+			}
+			if (info.peerClosed)
+			{
+				connection.resumeRead(std::nullopt, info.decoder.protocol());
+				continue;
+			}
+		}
+		else if (waiting == CoConnection::Waiting::Write && connection.queuedBytes() <= CoConnection::writeHighWater)
+		{
+			connection.resume();
+			continue;
+		}
+		break;
+	}
+
+	if (info.session.done())
+	{
+		try
+		{
+			info.session.result();
+		}
+		catch (const std::exception& ex)
+		{
+			LOG_ERROR("Error in connection handler: {}", ex.what());
+		}
+		info.stream.closeAfterFlush = true;
+	}
+
+	// Only a session waiting for a request can be idle; one that sleeps or writes is not
+	const bool waitingForRequest = !info.stream.closeAfterFlush && connection.waiting() == CoConnection::Waiting::Read;
+	if (waitingForRequest)
+	{
+		m_timers.arm(info.idleTimer, std::chrono::steady_clock::now() + clientTimeout);
+	}
+	else
+	{
+		m_timers.cancel(info.idleTimer);
+	}
+	if (info.readPaused == waitingForRequest)
+	{
+		info.readPaused = !waitingForRequest;
+		updateInterest(info);
+	}
+	m_dirtyClients.push_back(info.handle);
+}
+
+void EpollReactor::processCompletions()
+{
+	m_pipeline.drainCompletions([this](RequestPipeline::Completion& completion) {
+		ClientInfo* info = m_clientsInfo.get(completion.connection);
+		if (!info)
+		{
+			// The connection went away while the request was on the pool
+			return;
+		}
+
+		info->stream.accept(completion.sequence, std::move(completion.response));
+		m_dirtyClients.push_back(completion.connection);
+	});
+}
+
+void EpollReactor::flushDirtyClients()
+{
+	// Sessions that a flush resumes mark their connections for the next iteration
+	m_flushingClients.swap(m_dirtyClients);
+	for (SlotHandle connection: m_flushingClients)
+	{
+		if (ClientInfo* info = m_clientsInfo.get(connection))
+		{
+			flushOutbound(*info);
+		}
+	}
+	m_flushingClients.clear();
+}
+
+bool EpollReactor::flushOutbound(ClientInfo& info)
+{
+	const int clientFd = info.tcp.getHandle();
+	iovec buffers[maxIoVectors];
+	bool progressed = false;
+
+	while (!info.stream.outbound.empty())
+	{
+		size_t count = 0;
+		for (auto it = info.stream.outbound.begin(); it != info.stream.outbound.end() && count < maxIoVectors; ++it, ++count)
+		{
+			const size_t offset = count == 0 ? info.outboundOffset : 0;
+			buffers[count].iov_base = it->data() + offset;
+			buffers[count].iov_len = it->size() - offset;
+		}
+
+		const ssize_t written = info.tcp.sendSome(buffers, count);
+		if (written == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			LOG_ERROR("send failed on client {}: {}", clientFd, strerror(errno));
+			m_metrics.sendErrors.inc();
+			removeClient(info);
+			return false;
+		}
+
+		progressed = progressed || written > 0;
+		m_metrics.bytesSent.inc(static_cast<uint64_t>(written));
+		if (info.connection)
+		{
+			info.connection->sent(static_cast<size_t>(written));
+		}
+		auto remaining = static_cast<size_t>(written);
+		while (remaining > 0)
+		{
+			const size_t frontLeft = info.stream.outbound.front().size() - info.outboundOffset;
+			if (remaining < frontLeft)
+			{
+				info.outboundOffset += remaining;
+				break;
+			}
+			remaining -= frontLeft;
+			m_pipeline.buffers().recycle(std::move(info.stream.outbound.front()));
+			info.stream.outbound.pop_front();
+			info.outboundOffset = 0;
+		}
+	}
+
+	if (info.stream.outbound.empty())
+	{
+		info.stream.tracedResponses.written(info.stream.sequencer.released());
+	}
+	if (info.stream.outbound.empty()
+		&& (info.stream.closeAfterFlush || (info.peerClosed && !info.connection && info.stream.sequencer.idle())))
+	{
+		removeClient(info);
+		return false;
+	}
+
+	// Only wait for EPOLLOUT while the kernel buffer is full, and not forever
+	const bool needWrite = !info.stream.outbound.empty();
+	if (!needWrite)
+	{
+		m_timers.cancel(info.writeTimer);
+	}
+	else if (!info.writeArmed || progressed)
+	{
+		m_timers.arm(info.writeTimer, std::chrono::steady_clock::now() + writeTimeout);
+	}
+
+	if (needWrite != info.writeArmed)
+	{
+		info.writeArmed = needWrite;
+		updateInterest(info);
+	}
+
+	if (info.connection && info.connection->waiting() == CoConnection::Waiting::Write
+		&& info.connection->queuedBytes() <= CoConnection::writeHighWater)
+	{
+		driveSession(info);
+	}
+	return true;
+}
+
+void EpollReactor::updateInterest(const ClientInfo& info)
+{
+	epoll_event event{};
+	event.events = (info.peerClosed || info.readPaused ? 0 : uint32_t{ EPOLLIN | EPOLLRDHUP }) | (info.writeArmed ? uint32_t{ EPOLLOUT } : 0);
+	event.data.u64 = info.handle.pack();
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, info.tcp.getHandle(), &event) == -1)
+	{
+		LOG_ERROR("Failed to update epoll interest for client {}: {}", info.tcp.getHandle(), strerror(errno));
+	}
+}
+
+void EpollReactor::removeClient(ClientInfo& info)
+{
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, info.tcp.getHandle(), nullptr);
+	m_clientsInfo.erase(info.handle);
+	m_clientCount = m_clientsInfo.size();
+	m_metrics.activeConnections.add(-1);
+}
+
+size_t EpollReactor::getClientCount() const
+{
+	return m_clientCount;
+}
+
+std::string EpollReactor::getLocalAddress() const
+{
+	return m_server.getLocalAddress();
+}
+
+int EpollReactor::getListenerHandle() const
+{
+	return m_server.getHandle();
+}
+
+void EpollReactor::shutdown()
+{
+	m_stopRequested = true;
+	// After a handoff the successor holds the same socket, which would otherwise keep waking
+	// this epoll with connections that are no longer ours to accept
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, m_server.getHandle(), nullptr);
+	m_server.close();
+	if (m_sharedListener)
+	{
+		// Its owner closes it once every reactor sharing it has let go
+		epoll_ctl(m_epollFd, EPOLL_CTL_DEL, m_sharedListener->getHandle(), nullptr);
+	}
+	m_pipeline.wake();
+}
+
+void EpollReactor::checkTimeouts()
+{
+	m_timers.expire(std::chrono::steady_clock::now(), [this](const TimerWheel::Timer& timer) {
+		handleTimeout(timer);
+	});
+}
+
+void EpollReactor::handleTimeout(const TimerWheel::Timer& timer)
+{
+	ClientInfo* info = m_clientsInfo.get(SlotHandle::unpack(timer.userData));
+	if (!info)
+	{
+		return;
+	}
+
+	if (timer.kind == SleepTimeout)
+	{
+		info->connection->resume();
+		driveSession(*info);
+		return;
+	}
+
+	const int fd = info->tcp.getHandle();
+	if (timer.kind == IdleTimeout)
+	{
+		LOG_INFO("Client {} timed out (no activity for {}s). Closing.", fd, clientTimeout.count());
+		m_metrics.idleTimeouts.inc();
+	}
+	else
+	{
+		LOG_INFO("Client {} stopped reading responses for {}s. Closing.", fd, writeTimeout.count());
+		m_metrics.writeTimeouts.inc();
+	}
+	removeClient(*info);
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "ServerBackend.h"
+#include "ServerMetrics.h"
+#include "AdmissionControl.h"
+#include "CoConnection.h"
+#include "RequestPipeline.h"
+#include "../common/QueryDecoder.h"
+#include "../common/TimerWheel.h"
+#include "../common/SlotTable.h"
+#include "../common/RequestTracer.h"
+#include <sys/epoll.h>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <optional>
+#include <vector>
+
+// One event loop: its own listening socket, epoll instance and connection table.
+// Several reactors bound to the same port with SO_REUSEPORT let the kernel spread
+// incoming connections across them.
+//
+// Only the reactor thread touches sockets. Workers hand responses back through an
+// eventfd-signalled completion queue; each connection keeps them in request order and
+// flushes them with gathered writes, waiting for EPOLLOUT only when the socket is full.
+//
+// With a connection handler set, each new connection is served by a coroutine instead,
+// which the reactor resumes whenever what it awaits on its CoConnection is ready.
+class EpollReactor
+{
+public:
+	using MessageHandler = ServerBackend::MessageHandler;
+	using ConnectionHandler = ServerBackend::ConnectionHandler;
+
+	// listener is bound and listening already (see openListener)
+	EpollReactor(TcpServer listener, int maxEvents, AdmissionControl& admission,
+				 const MessageHandler& onMessage, const ConnectionHandler& onConnection);
+	~EpollReactor();
+
+	EpollReactor(const EpollReactor&) = delete;
+	EpollReactor& operator=(const EpollReactor&) = delete;
+
+	// Asks the kernel for the connections received on cpu, the one this reactor runs on
+	bool steerIncomingCpu(int cpu);
+	// Also accepts from listener, which several reactors may share (EPOLLEXCLUSIVE wakes only
+	// one of them per connection) and which must outlive the reactor's run()
+	bool shareListener(const TcpServer& listener);
+
+	// Takes effect for requests decoded from then on; Pool until set
+	void setDispatchPolicy(DispatchPolicy dispatch);
+	// Before run(); blocking epoll_wait until set
+	void setBusyPoll(const BusyPollConfig& busyPoll);
+
+	void run();
+	void shutdown();
+	void checkTimeouts();
+
+	size_t getClientCount() const;
+	std::string getLocalAddress() const;
+	int getListenerHandle() const;
+
+private:
+	enum TimeoutKind {
+		IdleTimeout,
+		WriteTimeout,
+		SleepTimeout,
+	};
+
+	struct ClientInfo {
+		explicit ClientInfo(TcpClient client) : tcp(std::move(client)) {}
+
+		TcpClient tcp;
+		SlotHandle handle;
+		QueryDecoder decoder;
+		RequestStream stream;
+
+		// Bytes of stream.outbound.front() already sent
+		size_t outboundOffset = 0;
+		bool writeArmed = false;
+		bool peerClosed = false;
+		// EPOLLIN is off: a request waits in stream.stalledTask, or the session is not reading
+		bool readPaused = false;
+
+		TimerWheel::Timer idleTimer;
+		TimerWheel::Timer writeTimer;
+
+		// Set when a connection handler serves the connection. The session goes first on
+		// destruction: its frames may still refer to the connection.
+		std::optional<CoConnection> connection;
+		CoTask<> session;
+	};
+
+	// epoll_wait as the loop needs it, spinning first in latency mode
+	int waitForEvents(std::vector<epoll_event>& events, int timeoutMs);
+
+	void removeClient(ClientInfo& info);
+	void handleNewConnection(const TcpServer& listener);
+	void handleClientData(ClientInfo& info);
+	// Returns false when a request was deferred and reading has to pause
+	bool processFrames(ClientInfo& info);
+	void pauseReading(ClientInfo& info);
+	void resumeReading();
+
+	void startSession(ClientInfo& info);
+	// Resumes the session for as long as what it awaits is ready, then reads from the socket
+	// only if it waits for a request
+	void driveSession(ClientInfo& info);
+
+	void processCompletions();
+	// Returns false when the connection has been removed
+	bool flushOutbound(ClientInfo& info);
+	void flushDirtyClients();
+	void updateInterest(const ClientInfo& info);
+	void handleTimeout(const TimerWheel::Timer& timer);
+
+	TcpServer m_server;
+	const TcpServer* m_sharedListener = nullptr;
+	int m_epollFd = -1;
+	int m_maxEvents;
+	const ConnectionHandler& m_onConnection;
+	RequestPipeline m_pipeline;
+
+	BusyPollConfig m_busyPoll;
+	// What the next spin may take, adapted within m_busyPoll.budget
+	std::chrono::nanoseconds m_spinBudget{ 0 };
+	// Cleared once the kernel refuses SO_BUSY_POLL, so that it is reported only once
+	bool m_socketBusyPoll = false;
+
+	TimerWheel m_timers;
+	// Indexed by fd; epoll events and pool completions refer to connections by generation-checked
+	// handle, so an event or response meant for a closed connection never reaches a reused fd.
+	SlotTable<ClientInfo> m_clientsInfo;
+	std::atomic<size_t> m_clientCount = 0;
+
+	std::vector<SlotHandle> m_dirtyClients;
+	std::vector<SlotHandle> m_flushingClients;
+	std::vector<SlotHandle> m_pausedClients;
+
+	std::atomic<bool> m_stopRequested = false;
+
+	ServerMetrics& m_metrics = ServerMetrics::instance();
+	RequestTracer& m_tracer = RequestTracer::instance();
+};
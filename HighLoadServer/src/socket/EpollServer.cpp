@@ -1,208 +1,217 @@
-#include <iostream>
-#include <unistd.h>
-#include <fcntl.h>
-#include <cstring>
-#include <cerrno>
-#include <chrono>
-#include <vector>
+#include <thread>
+#include <stdexcept>
 #include <string>
 #include "EpollServer.h"
+#include "../common/CpuAffinity.h"
+#include "../common/Logger.h"
 
-constexpr std::chrono::seconds clientTimeout{ 10 };
-
-EpollServer::EpollServer(unsigned short port, int maxEvents)
-	: m_maxEvents(maxEvents), m_stopRequested(false)
+EpollServer::EpollServer(unsigned short port, ServerConfig config)
+	: m_reactorCpus(config.reactorCpus)
 {
-	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
-	if (m_epollFd == -1)
+	const size_t reactorCount = reactorCountFor(config);
+
+	m_threadPool = makeWorkerPool(config);
+	m_admission = std::make_unique<AdmissionControl>(*m_threadPool, config);
+
+	if (!config.unixPath.empty())
 	{
-		throw std::runtime_error("epoll_create1 failed: " + std::string(strerror(errno)));
+		m_unixListener = std::make_unique<TcpServer>(openUnixListener(config));
 	}
 
-	if (!m_server.bind(port) || !m_server.listen())
+	m_reactors.reserve(reactorCount);
+	for (size_t i = 0; i < reactorCount; ++i)
 	{
-		throw std::runtime_error("Failed to bind or listen on server socket");
+		auto makeReactor = [&]() {
+			TcpServer listener = openListener(port, config, i);
+			// Port 0 binds the first listener to an ephemeral port; the other reactors join
+			// its SO_REUSEPORT group there rather than each getting a port of its own
+			if (port == 0)
+			{
+				port = listener.getLocalPort();
+			}
+			auto reactor = std::make_unique<EpollReactor>(std::move(listener), config.maxEvents, *m_admission, m_onMessage, m_onConnection);
+			reactor->setBusyPoll(config.busyPoll);
+			return reactor;
+		};
+		auto makeUdpReactor = [&]() {
+			return std::make_unique<UdpReactor>(port, m_onMessage);
+		};
+		const int cpu = reactorCpu(i);
+		if (cpu < 0)
+		{
+			m_reactors.push_back(makeReactor());
+			if (config.udp)
+			{
+				m_udpReactors.push_back(makeUdpReactor());
+			}
+			continue;
+		}
+
+		// Built on its own CPU so its tables and buffers come from that CPU's NUMA node
+		m_reactors.push_back(runOnCpu(cpu, makeReactor));
+		if (config.udp)
+		{
+			m_udpReactors.push_back(runOnCpu(cpu, makeUdpReactor));
+		}
+		if (config.steerByIncomingCpu)
+		{
+			m_reactors.back()->steerIncomingCpu(cpu);
+			if (config.udp)
+			{
+				m_udpReactors.back()->steerIncomingCpu(cpu);
+			}
+		}
+		LOG_INFO("Reactor {} pinned to CPU {} (NUMA node {})", i, cpu, numaNodeOf(cpu));
 	}
 
-	int flags = fcntl(m_server.getHandle(), F_GETFL, 0);
-	fcntl(m_server.getHandle(), F_SETFL, flags | O_NONBLOCK);
+	m_port = port;
 
-	epoll_event event{};
-	event.events = EPOLLIN;
-	event.data.fd = m_server.getHandle();
-	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_server.getHandle(), &event) == -1)
+	// A unix socket has no SO_REUSEPORT groups, so the reactors take turns on a single one
+	if (m_unixListener)
 	{
-		throw std::runtime_error("epoll_ctl(server) failed: " + std::string(strerror(errno)));
+		for (auto& reactor: m_reactors)
+		{
+			if (!reactor->shareListener(*m_unixListener))
+			{
+				throw std::runtime_error("Failed to watch the unix socket");
+			}
+		}
 	}
 
-	std::cout << "EpollServer listening on " << m_server.getLocalAddress() << std::endl;
+	LOG_INFO("EpollServer listening on {} with {} reactor(s)", getLocalAddress(), reactorCount);
+	if (m_unixListener)
+	{
+		LOG_INFO("Accepting local connections on {}", m_unixListener->getLocalAddress());
+	}
+	if (config.busyPoll.budget.count() > 0 || config.busyPoll.socketPoll.count() > 0)
+	{
+		LOG_INFO("Busy polling: epoll spins up to {} us, sockets {} us", config.busyPoll.budget.count(), config.busyPoll.socketPoll.count());
+	}
+	if (!m_udpReactors.empty())
+	{
+		LOG_INFO("Answering UDP queries on {} with {} reactor(s)", m_udpReactors.front()->getLocalAddress(), m_udpReactors.size());
+	}
 }
 
 EpollServer::~EpollServer()
 {
-	if (m_epollFd != -1)
+	// Workers still running queued requests use the reactors' clients, so drain them first.
+	m_threadPool.reset();
+}
+
+void EpollServer::setMessageHandler(MessageHandler handler, DispatchPolicy dispatch)
+{
+	m_onMessage = std::move(handler);
+	for (auto& reactor: m_reactors)
 	{
-		close(m_epollFd);
+		reactor->setDispatchPolicy(dispatch);
 	}
 }
 
-void EpollServer::setMessageHandler(MessageHandler handler)
+void EpollServer::setConnectionHandler(ConnectionHandler handler)
 {
-	m_onMessage = std::move(handler);
+	m_onConnection = std::move(handler);
 }
 
 void EpollServer::run()
 {
-	std::vector<epoll_event> events(m_maxEvents);
+	std::vector<std::jthread> reactorThreads;
+	reactorThreads.reserve(m_reactors.size() - 1 + m_udpReactors.size());
 
-	while (true)
+	for (size_t i = 1; i < m_reactors.size(); ++i)
 	{
-		if (m_stopRequested && m_clientsInfo.empty())
-		{
-			break;
-		}
-
-		int numEvents = epoll_wait(m_epollFd, events.data(), m_maxEvents, 1000);
-		if (numEvents == -1)
-		{
-			if (errno == EINTR)
-			{
-				continue;
-			}
-			if (!m_stopRequested)
-			{
-				std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
-			}
-			break;
-		}
-
-		checkTimeouts();
-
-		for (int i = 0; i < numEvents; ++i)
-		{
-			int fd = events[i].data.fd;
-
-			if (fd == m_server.getHandle())
+		reactorThreads.emplace_back([reactor = m_reactors[i].get(), cpu = reactorCpu(i)]() {
+			if (cpu >= 0)
 			{
-				handleNewConnection();
+				pinCurrentThread(cpu);
 			}
-			else if (events[i].events & (EPOLLRDHUP | EPOLLERR))
+			try
 			{
-				std::cout << "Client disconnected: " << fd << std::endl;
-				removeClient(fd);
+				reactor->run();
 			}
-			else if (events[i].events & EPOLLIN)
+			catch (const std::exception& e)
 			{
-				handleClientData(fd);
+				LOG_ERROR("Reactor error: {}", e.what());
 			}
-		}
+		});
 	}
-}
 
-void EpollServer::handleNewConnection()
-{
-	auto client = m_server.accept();
-	if (!client || !client->isValid())
+	for (size_t i = 0; i < m_udpReactors.size(); ++i)
 	{
-		return;
+		reactorThreads.emplace_back([reactor = m_udpReactors[i].get(), cpu = reactorCpu(i)]() {
+			if (cpu >= 0)
+			{
+				pinCurrentThread(cpu);
+			}
+			reactor->run();
+		});
 	}
 
-	int clientFd = client->getHandle();
-
-	int flags = fcntl(clientFd, F_GETFL, 0);
-	fcntl(clientFd, F_SETFL, flags | O_NONBLOCK);
-
-	epoll_event event{};
-	event.events = EPOLLIN | EPOLLRDHUP;
-	event.data.fd = clientFd;
-	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, clientFd, &event) == -1)
+	// The first reactor runs on the calling thread, which it pins like the others
+	if (reactorCpu(0) >= 0)
 	{
-		std::cerr << "Failed to add client socket to epoll" << std::endl;
-		return;
+		pinCurrentThread(reactorCpu(0));
 	}
-
-	m_clientsInfo[clientFd] = { std::chrono::steady_clock::now(), std::move(client) };
-	std::cout << "Client connected: " << clientFd << std::endl;
+	m_reactors.front()->run();
 }
 
-void EpollServer::handleClientData(int clientFd)
+void EpollServer::shutdown()
 {
-	auto it = m_clientsInfo.find(clientFd);
-	if (it == m_clientsInfo.end())
+	size_t activeClients = 0;
+	for (auto& reactor: m_reactors)
 	{
-		return;
+		reactor->shutdown();
+		activeClients += reactor->getClientCount();
 	}
-
-	std::string request = it->second.tcp->receiveString();
-
-	if (request.size() == 0)
+	// Datagrams have nothing in flight to drain
+	for (auto& reactor: m_udpReactors)
 	{
-		std::cout << "Client closed or recv error: " << clientFd << std::endl;
-		removeClient(clientFd);
-		return;
+		reactor->shutdown();
 	}
-
-	it->second.lastActivity = std::chrono::steady_clock::now();
-
-	if (m_onMessage)
+	if (m_unixListener)
 	{
-		auto clientPtr = it->second.tcp.get();
-		m_threadPool.enqueue([this, request = std::move(request), clientPtr]()
-		{
-			try
-			{
-				std::string response = m_onMessage(request);
-				clientPtr->sendString(response);
-			}
-			catch (const std::exception& ex)
-			{
-				std::cerr << "Error in worker thread: " << ex.what() << std::endl;
-			}
-		});
+		m_unixListener->close();
 	}
-}
+	LOG_INFO("Server stopped accepting new connections.");
 
-void EpollServer::removeClient(int clientFd)
-{
-	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, clientFd, nullptr);
-	m_clientsInfo.erase(clientFd);
+	if (activeClients != 0)
+	{
+		LOG_INFO("Active clients: {}. Waiting for them to finish...", activeClients);
+	}
 }
 
-std::string EpollServer::getLocalAddress() const
+int EpollServer::reactorCpu(size_t index) const
 {
-	return m_server.getLocalAddress();
+	return m_reactorCpus.empty() ? -1 : m_reactorCpus[index % m_reactorCpus.size()];
 }
 
-void EpollServer::shutdown()
+std::vector<int> EpollServer::getListeners() const
 {
-	m_stopRequested = true;
-	m_server.close();
-	std::cout << "Server stopped accepting new connections." << std::endl;
-
-	if (!m_clientsInfo.empty())
+	std::vector<int> listeners;
+	for (const auto& reactor: m_reactors)
 	{
-		std::cout << "Active clients: " << m_clientsInfo.size()
-				  << ". Waiting for them to finish..." << std::endl;
+		listeners.push_back(reactor->getListenerHandle());
 	}
+	// A successor replaces a socket file by binding its own, but cannot bind an abstract name
+	// while this process holds it
+	if (m_unixListener && m_unixListener->getLocalAddress().starts_with("unix:@"))
+	{
+		listeners.push_back(m_unixListener->getHandle());
+	}
+	return listeners;
 }
 
-void EpollServer::checkTimeouts()
+size_t EpollServer::getReactorCount() const
 {
-	auto now = std::chrono::steady_clock::now();
-	std::vector<int> timedOutClients;
+	return m_reactors.size();
+}
 
-	for (const auto& [fd, info]: m_clientsInfo)
-	{
-		if (now - info.lastActivity > clientTimeout)
-		{
-			std::cout << "Client " << fd << " timed out (no activity for "
-					  << clientTimeout.count() << "s). Closing." << std::endl;
-			timedOutClients.push_back(fd);
-		}
-	}
+std::string EpollServer::getLocalAddress() const
+{
+	return m_reactors.front()->getLocalAddress();
+}
 
-	for (int fd: timedOutClients)
-	{
-		removeClient(fd);
-	}
-}
\ No newline at end of file
+unsigned short EpollServer::getLocalPort() const
+{
+	return m_port;
+}
@@ -1,44 +1,44 @@
 #pragma once
 
-#include "TcpServer.h"
-#include "../common/ThreadPool.h"
-#include <sys/epoll.h>
-#include <unordered_map>
+#include "ServerBackend.h"
+#include "EpollReactor.h"
+#include "UdpReactor.h"
+#include "AdmissionControl.h"
+#include "../common/Executor.h"
 #include <functional>
 #include <memory>
+#include <vector>
 
-class EpollServer
+class EpollServer : public ServerBackend
 {
 public:
-	using MessageHandler = std::function<std::string(const std::string&)>;
+	explicit EpollServer(unsigned short port, ServerConfig config = {});
+	~EpollServer() override;
 
-	explicit EpollServer(unsigned short port, int max_events = 64);
-	~EpollServer();
+	void setMessageHandler(MessageHandler handler, DispatchPolicy dispatch) override;
+	void setConnectionHandler(ConnectionHandler handler) override;
+	void run() override;
+	void shutdown() override;
 
-	void setMessageHandler(MessageHandler handler);
-	void run();
-	void shutdown();
-	void checkTimeouts();
-
-	std::string getLocalAddress() const;
+	size_t getReactorCount() const override;
+	std::vector<int> getListeners() const override;
+	std::string getLocalAddress() const override;
+	unsigned short getLocalPort() const override;
 
 private:
-	void removeClient(int client_fd);
-	void handleNewConnection();
-	void handleClientData(int clientFd);
+	// CPU reactor index is pinned to, or -1
+	int reactorCpu(size_t index) const;
 
-	TcpServer m_server;
-	int m_epollFd = -1;
-	int m_maxEvents;
 	MessageHandler m_onMessage;
-
-	struct ClientInfo {
-		std::chrono::steady_clock::time_point lastActivity;
-		std::unique_ptr<TcpClient> tcp;
-	};
-	std::unordered_map<int, ClientInfo> m_clientsInfo;
-
-	ThreadPool m_threadPool;
-
-	std::atomic<bool> m_stopRequested = false;
-};
\ No newline at end of file
+	ConnectionHandler m_onConnection;
+	std::unique_ptr<Executor> m_threadPool;
+	std::unique_ptr<AdmissionControl> m_admission;
+	// With ServerConfig::unixPath, accepted from by every reactor; declared before them so
+	// that it outlives them
+	std::unique_ptr<TcpServer> m_unixListener;
+	std::vector<std::unique_ptr<EpollReactor>> m_reactors;
+	// With ServerConfig::udp, one per reactor and on the same CPU
+	std::vector<std::unique_ptr<UdpReactor>> m_udpReactors;
+	std::vector<int> m_reactorCpus;
+	unsigned short m_port = 0;
+};
@@ -0,0 +1,323 @@
+#include "IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+int ioUringSetup(unsigned entries, io_uring_params& params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+std::runtime_error ioUringError(const std::string& what, int error)
+{
+	return std::runtime_error(what + " failed: " + strerror(error));
+}
+} // namespace
+
+IoUring::IoUring(unsigned entries)
+{
+	io_uring_params params{};
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+	params.cq_entries = entries * 4;
+	m_fd = ioUringSetup(entries, params);
+	if (m_fd == -1 && errno == EINVAL)
+	{
+		// Kernels before 5.19 do not know COOP_TASKRUN
+		params = {};
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = entries * 4;
+		m_fd = ioUringSetup(entries, params);
+	}
+	if (m_fd == -1)
+	{
+		throw ioUringError("io_uring_setup", errno);
+	}
+
+	m_features = params.features;
+	if (!(m_features & IORING_FEAT_EXT_ARG) || !(m_features & IORING_FEAT_SINGLE_MMAP))
+	{
+		close(m_fd);
+		throw std::runtime_error("io_uring: kernel is too old (needs EXT_ARG and SINGLE_MMAP)");
+	}
+
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+	m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+	if (m_sqRing == MAP_FAILED)
+	{
+		const int error = errno;
+		close(m_fd);
+		throw ioUringError("mmap(sq ring)", error);
+	}
+	m_cqRing = m_sqRing;
+
+	m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+	if (m_sqes == MAP_FAILED)
+	{
+		const int error = errno;
+		munmap(m_sqRing, m_sqRingSize);
+		close(m_fd);
+		throw ioUringError("mmap(sqes)", error);
+	}
+
+	auto* sq = static_cast<char*>(m_sqRing);
+	m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	m_sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+	m_sqeTail = *m_sqTail;
+
+	// SQEs are always used in ring order, so the indirection array is the identity
+	auto* sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	for (unsigned i = 0; i < m_sqEntries; ++i)
+	{
+		sqArray[i] = i;
+	}
+
+	auto* cq = static_cast<char*>(m_cqRing);
+	m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring()
+{
+	munmap(m_sqes, m_sqesSize);
+	munmap(m_sqRing, m_sqRingSize);
+	close(m_fd);
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+	const unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	if (m_sqeTail - head >= m_sqEntries)
+	{
+		return nullptr;
+	}
+
+	io_uring_sqe* sqe = &m_sqes[m_sqeTail & m_sqMask];
+	++m_sqeTail;
+	std::memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+unsigned IoUring::sqSpaceLeft() const
+{
+	const unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	return m_sqEntries - (m_sqeTail - head);
+}
+
+unsigned IoUring::publishSqes()
+{
+	const unsigned published = *m_sqTail;
+	__atomic_store_n(m_sqTail, m_sqeTail, __ATOMIC_RELEASE);
+	return m_sqeTail - published;
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize)
+{
+	const long result = syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, arg, argSize);
+	return result == -1 ? -errno : static_cast<int>(result);
+}
+
+int IoUring::submit()
+{
+	const unsigned toSubmit = publishSqes();
+	if (toSubmit == 0)
+	{
+		return 0;
+	}
+	return enter(toSubmit, 0, 0, nullptr, 0);
+}
+
+int IoUring::submitAndWait(int timeoutMs)
+{
+	const unsigned toSubmit = publishSqes();
+
+	__kernel_timespec timeout{};
+	io_uring_getevents_arg arg{};
+	if (timeoutMs >= 0)
+	{
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+		arg.ts = reinterpret_cast<uint64_t>(&timeout);
+	}
+
+	return enter(toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+int IoUring::registerBufferRing(void* ring, unsigned entries, uint16_t groupId)
+{
+	io_uring_buf_reg reg{};
+	reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+	reg.ring_entries = entries;
+	reg.bgid = groupId;
+
+	const long result = syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+	return result == -1 ? -errno : 0;
+}
+
+int IoUring::unregisterBufferRing(uint16_t groupId)
+{
+	io_uring_buf_reg reg{};
+	reg.bgid = groupId;
+
+	const long result = syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+	return result == -1 ? -errno : 0;
+}
+
+ProvidedBuffers::ProvidedBuffers(IoUring& ring, uint16_t groupId, unsigned bufferCount, unsigned bufferSize)
+	: m_uring(ring), m_groupId(groupId), m_bufferCount(bufferCount), m_bufferSize(bufferSize), m_mask(bufferCount - 1)
+{
+	if (bufferCount == 0 || (bufferCount & (bufferCount - 1)) != 0 || bufferCount > 32768)
+	{
+		throw std::invalid_argument("Provided buffer count must be a power of two up to 32768");
+	}
+
+	m_buffersSize = static_cast<size_t>(bufferCount) * bufferSize;
+	void* buffers = mmap(nullptr, m_buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED)
+	{
+		throw ioUringError("mmap(buffers)", errno);
+	}
+	m_buffers = static_cast<char*>(buffers);
+
+	if (!setupRing())
+	{
+		provide(0, bufferCount);
+		m_uring.submit();
+	}
+}
+
+ProvidedBuffers::~ProvidedBuffers()
+{
+	if (m_ring)
+	{
+		m_uring.unregisterBufferRing(m_groupId);
+		munmap(m_ring, m_ringSize);
+	}
+	munmap(m_buffers, m_buffersSize);
+}
+
+bool ProvidedBuffers::setupRing()
+{
+	m_ringSize = m_bufferCount * sizeof(io_uring_buf);
+	void* ringMemory = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (ringMemory == MAP_FAILED)
+	{
+		return false;
+	}
+
+	if (m_uring.registerBufferRing(ringMemory, m_bufferCount, m_groupId) < 0)
+	{
+		munmap(ringMemory, m_ringSize);
+		return false;
+	}
+	m_ring = static_cast<io_uring_buf_ring*>(ringMemory);
+
+	for (unsigned i = 0; i < m_bufferCount; ++i)
+	{
+		add(static_cast<uint16_t>(i));
+	}
+	__atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+
+	if (!ringDeliversBuffers())
+	{
+		// Registration succeeds on some kernels whose buffer selection then never sees the
+		// ring's entries and fails every receive with -ENOBUFS
+		m_uring.unregisterBufferRing(m_groupId);
+		munmap(m_ring, m_ringSize);
+		m_ring = nullptr;
+		m_tail = 0;
+		return false;
+	}
+	return true;
+}
+
+bool ProvidedBuffers::ringDeliversBuffers()
+{
+	// A buffer-select read of a ready eventfd completes inline, so the ring must still be idle
+	const int probeFd = eventfd(1, EFD_CLOEXEC);
+	if (probeFd == -1)
+	{
+		return true;
+	}
+
+	io_uring_sqe* sqe = m_uring.getSqe();
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = probeFd;
+	sqe->len = sizeof(uint64_t);
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = m_groupId;
+
+	bool delivered = false;
+	if (m_uring.submitAndWait(1000) >= 0)
+	{
+		m_uring.forEachCqe([this, &delivered](const io_uring_cqe& cqe) {
+			if (cqe.res >= 0 && (cqe.flags & IORING_CQE_F_BUFFER))
+			{
+				delivered = true;
+				recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+			}
+		});
+	}
+	close(probeFd);
+	return delivered;
+}
+
+const char* ProvidedBuffers::data(uint16_t bufferId) const
+{
+	return m_buffers + static_cast<size_t>(bufferId) * m_bufferSize;
+}
+
+void ProvidedBuffers::add(uint16_t bufferId)
+{
+	io_uring_buf& buffer = m_ring->bufs[m_tail & m_mask];
+	buffer.addr = reinterpret_cast<uint64_t>(m_buffers + static_cast<size_t>(bufferId) * m_bufferSize);
+	buffer.len = m_bufferSize;
+	buffer.bid = bufferId;
+	++m_tail;
+}
+
+void ProvidedBuffers::provide(uint16_t firstId, unsigned count)
+{
+	io_uring_sqe* sqe = m_uring.getSqe();
+	if (!sqe)
+	{
+		m_uring.submit();
+		sqe = m_uring.getSqe();
+	}
+
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = static_cast<int>(count);
+	sqe->addr = reinterpret_cast<uint64_t>(m_buffers + static_cast<size_t>(firstId) * m_bufferSize);
+	sqe->len = m_bufferSize;
+	sqe->off = firstId;
+	sqe->buf_group = m_groupId;
+	// Nothing to report on success; the completion would only be noise for the owner's loop
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+}
+
+void ProvidedBuffers::recycle(uint16_t bufferId)
+{
+	if (!m_ring)
+	{
+		provide(bufferId, 1);
+		return;
+	}
+
+	add(bufferId);
+	__atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+}
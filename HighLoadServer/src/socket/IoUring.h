@@ -0,0 +1,116 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <cstdint>
+#include <cstddef>
+
+// Minimal io_uring wrapper over the raw syscalls: one submission and one completion ring,
+// SQEs handed out in ring order and published on submit.
+class IoUring
+{
+public:
+	explicit IoUring(unsigned entries);
+	~IoUring();
+
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+
+	// Zeroed SQE, or nullptr when the submission ring is full
+	io_uring_sqe* getSqe();
+	[[nodiscard]] unsigned sqSpaceLeft() const;
+
+	// Submits queued SQEs without waiting
+	int submit();
+	// Submits queued SQEs and waits for at least one completion; timeoutMs < 0 waits forever.
+	// Returns -errno on failure, -ETIME when the timeout expired.
+	int submitAndWait(int timeoutMs);
+
+	template <typename Callback>
+	unsigned forEachCqe(Callback&& onCqe);
+
+	int registerBufferRing(void* ring, unsigned entries, uint16_t groupId);
+	int unregisterBufferRing(uint16_t groupId);
+
+	[[nodiscard]] int getFd() const { return m_fd; }
+
+private:
+	int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize);
+	unsigned publishSqes();
+
+	int m_fd = -1;
+	unsigned m_features = 0;
+
+	void* m_sqRing = nullptr;
+	size_t m_sqRingSize = 0;
+	void* m_cqRing = nullptr;
+	size_t m_cqRingSize = 0;
+	io_uring_sqe* m_sqes = nullptr;
+	size_t m_sqesSize = 0;
+
+	unsigned* m_sqHead = nullptr;
+	unsigned* m_sqTail = nullptr;
+	unsigned m_sqMask = 0;
+	unsigned m_sqEntries = 0;
+	unsigned m_sqeTail = 0;
+
+	unsigned* m_cqHead = nullptr;
+	unsigned* m_cqTail = nullptr;
+	unsigned m_cqMask = 0;
+	io_uring_cqe* m_cqes = nullptr;
+};
+
+template <typename Callback>
+unsigned IoUring::forEachCqe(Callback&& onCqe)
+{
+	unsigned head = *m_cqHead;
+	const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+	unsigned count = 0;
+
+	while (head != tail)
+	{
+		onCqe(m_cqes[head & m_cqMask]);
+		++head;
+		++count;
+	}
+
+	__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	return count;
+}
+
+// Receive buffers handed to the kernel for buffer-select operations. Multishot receives pick
+// a buffer per completion; the reactor copies the data out and returns the buffer. Uses a
+// kernel-shared buffer ring (IORING_REGISTER_PBUF_RING) where it works, and otherwise falls
+// back to IORING_OP_PROVIDE_BUFFERS, which costs an SQE per returned buffer.
+class ProvidedBuffers
+{
+public:
+	ProvidedBuffers(IoUring& ring, uint16_t groupId, unsigned bufferCount, unsigned bufferSize);
+	~ProvidedBuffers();
+
+	ProvidedBuffers(const ProvidedBuffers&) = delete;
+	ProvidedBuffers& operator=(const ProvidedBuffers&) = delete;
+
+	[[nodiscard]] const char* data(uint16_t bufferId) const;
+	void recycle(uint16_t bufferId);
+
+	[[nodiscard]] uint16_t getGroupId() const { return m_groupId; }
+	[[nodiscard]] bool isRingMapped() const { return m_ring != nullptr; }
+
+private:
+	bool setupRing();
+	bool ringDeliversBuffers();
+	void provide(uint16_t firstId, unsigned count);
+	void add(uint16_t bufferId);
+
+	IoUring& m_uring;
+	io_uring_buf_ring* m_ring = nullptr;
+	size_t m_ringSize = 0;
+	char* m_buffers = nullptr;
+	size_t m_buffersSize = 0;
+	uint16_t m_groupId;
+	unsigned m_bufferCount;
+	unsigned m_bufferSize;
+	unsigned m_mask;
+	uint16_t m_tail = 0;
+};
@@ -0,0 +1,613 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "IoUringReactor.h"
+#include "../common/Logger.h"
+
+constexpr std::chrono::seconds clientTimeout{ 10 };
+constexpr std::chrono::seconds writeTimeout{ 10 };
+constexpr unsigned ringEntries = 4096;
+constexpr uint16_t bufferGroup = 0;
+constexpr unsigned bufferCount = 1024;
+constexpr unsigned bufferSize = 4096;
+// Upper bound on one linked send chain; a longer outbound queue goes out in several chains
+constexpr size_t maxLinkedSends = 64;
+// Nothing signals that the pool has room again, so paused connections retry this often
+constexpr int pausedRetryMs = 1;
+
+namespace
+{
+// user_data layout: operation in the top byte, then the 32-bit generation and a 24-bit slot
+// (the fd). The reactor's own operations carry no connection.
+uint64_t encode(uint8_t operation, SlotHandle handle = {})
+{
+	return (static_cast<uint64_t>(operation) << 56)
+		| (static_cast<uint64_t>(handle.generation) << 24)
+		| (handle.slot & 0xFFFFFF);
+}
+
+uint8_t operationOf(uint64_t userData)
+{
+	return static_cast<uint8_t>(userData >> 56);
+}
+
+SlotHandle handleOf(uint64_t userData)
+{
+	return { static_cast<uint32_t>(userData & 0xFFFFFF), static_cast<uint32_t>(userData >> 24) };
+}
+} // namespace
+
+IoUringReactor::IoUringReactor(TcpServer listener, AdmissionControl& admission, const MessageHandler& onMessage)
+	: m_server(std::move(listener))
+	, m_pipeline(admission, onMessage)
+	, m_ring(ringEntries)
+	, m_buffers(m_ring, bufferGroup, bufferCount, bufferSize)
+{
+}
+
+IoUringReactor::~IoUringReactor() = default;
+
+bool IoUringReactor::steerIncomingCpu(int cpu)
+{
+	return m_server.setIncomingCpu(cpu);
+}
+
+void IoUringReactor::setDispatchPolicy(DispatchPolicy dispatch)
+{
+	m_pipeline.setDispatchPolicy(dispatch);
+}
+
+void IoUringReactor::run()
+{
+	armAccept();
+	armWakePoll();
+
+	while (true)
+	{
+		if (m_stopRequested && m_acceptArmed && !m_acceptCancelled)
+		{
+			cancelAccept();
+		}
+		if (m_stopRequested && m_connections.empty() && !m_acceptArmed)
+		{
+			break;
+		}
+
+		int timeoutMs = m_timers.nextTimeoutMs(std::chrono::steady_clock::now());
+		if (!m_pausedConnections.empty())
+		{
+			timeoutMs = timeoutMs < 0 ? pausedRetryMs : std::min(timeoutMs, pausedRetryMs);
+		}
+		const int result = m_ring.submitAndWait(timeoutMs);
+		if (result < 0 && result != -ETIME && result != -EINTR && result != -EBUSY)
+		{
+			LOG_ERROR("io_uring_enter error: {}", strerror(-result));
+			break;
+		}
+
+		checkTimeouts();
+
+		m_ring.forEachCqe([this](const io_uring_cqe& cqe) {
+			handleCqe(cqe);
+		});
+		resumeReading();
+		m_pipeline.submitBatch();
+
+		// Responses completed while handling this batch go out as one chain per connection
+		for (SlotHandle handle: m_dirtyConnections)
+		{
+			if (Connection* connection = m_connections.get(handle))
+			{
+				submitSends(*connection);
+				finishIfDrained(*connection);
+			}
+		}
+		m_dirtyConnections.clear();
+	}
+}
+
+io_uring_sqe* IoUringReactor::getSqe()
+{
+	io_uring_sqe* sqe = m_ring.getSqe();
+	if (!sqe)
+	{
+		// Without SQPOLL the kernel consumes the whole submission ring on submit
+		m_ring.submit();
+		sqe = m_ring.getSqe();
+	}
+	if (!sqe)
+	{
+		throw std::runtime_error("io_uring submission ring is full");
+	}
+	return sqe;
+}
+
+void IoUringReactor::armAccept()
+{
+	io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = m_server.getHandle();
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = encode(AcceptOp);
+	m_acceptArmed = true;
+}
+
+void IoUringReactor::cancelAccept()
+{
+	io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = encode(AcceptOp);
+	sqe->user_data = encode(CancelOp);
+	m_acceptCancelled = true;
+}
+
+void IoUringReactor::armWakePoll()
+{
+	// A multishot poll rather than a read: the eventfd is O_NONBLOCK, and io_uring completes
+	// reads on such files with -EAGAIN instead of waiting
+	io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = m_pipeline.getWakeFd();
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = encode(WakeOp);
+}
+
+void IoUringReactor::armRecv(Connection& connection)
+{
+	io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = connection.tcp.getHandle();
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = m_buffers.getGroupId();
+	sqe->user_data = encode(RecvOp, connection.handle);
+	connection.recvArmed = true;
+	++connection.pendingOps;
+}
+
+void IoUringReactor::submitSends(Connection& connection)
+{
+	// One chain in flight at a time keeps the byte order on the socket
+	if (connection.closing || connection.sendsInFlight != 0 || connection.stream.outbound.empty())
+	{
+		return;
+	}
+
+	const size_t count = std::min({ connection.stream.outbound.size(), maxLinkedSends, static_cast<size_t>(m_ring.sqSpaceLeft()) });
+	if (count == 0)
+	{
+		m_ring.submit();
+		m_dirtyConnections.push_back(connection.handle);
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const std::string& response = connection.stream.outbound[i];
+		io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = connection.tcp.getHandle();
+		sqe->addr = reinterpret_cast<uint64_t>(response.data());
+		sqe->len = static_cast<uint32_t>(response.size());
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		// A failed or short send cancels the rest of the chain, so nothing is sent out of order
+		sqe->flags = i + 1 < count ? IOSQE_IO_LINK : 0;
+		sqe->user_data = encode(SendOp, connection.handle);
+	}
+	connection.sendsInFlight = count;
+	connection.pendingOps += static_cast<int>(count);
+
+	// A peer that stops reading leaves the chain pending; give it as long as epoll does
+	m_timers.arm(connection.writeTimer, std::chrono::steady_clock::now() + writeTimeout);
+}
+
+void IoUringReactor::handleCqe(const io_uring_cqe& cqe)
+{
+	const uint8_t operation = operationOf(cqe.user_data);
+	if (operation == AcceptOp)
+	{
+		handleAccept(cqe);
+		return;
+	}
+	if (operation == WakeOp)
+	{
+		handleWake(cqe);
+		return;
+	}
+	if (operation == CancelOp)
+	{
+		// The cancelled receive reports on its own CQE
+		return;
+	}
+
+	Connection* connection = m_connections.get(handleOf(cqe.user_data));
+	if (!connection)
+	{
+		// A buffer picked for an already released connection still has to go back
+		if (cqe.flags & IORING_CQE_F_BUFFER)
+		{
+			m_buffers.recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+		}
+		return;
+	}
+
+	if (operation == RecvOp)
+	{
+		handleRecv(*connection, cqe);
+	}
+	else if (operation == SendOp)
+	{
+		handleSend(*connection, cqe);
+	}
+}
+
+void IoUringReactor::handleAccept(const io_uring_cqe& cqe)
+{
+	if (!(cqe.flags & IORING_CQE_F_MORE))
+	{
+		m_acceptArmed = false;
+		if (!m_stopRequested)
+		{
+			armAccept();
+		}
+	}
+
+	if (cqe.res < 0)
+	{
+		if (!m_stopRequested && cqe.res != -ECANCELED)
+		{
+			LOG_ERROR("accept failed: {}", strerror(-cqe.res));
+		}
+		return;
+	}
+
+	const int clientFd = cqe.res;
+	if (m_stopRequested || clientFd > 0xFFFFFF)
+	{
+		::close(clientFd);
+		return;
+	}
+
+	auto [handle, connection] = m_connections.emplace(static_cast<uint32_t>(clientFd), TcpClient(clientFd));
+	connection.handle = handle;
+	connection.idleTimer.userData = handle.pack();
+	connection.idleTimer.kind = IdleTimeout;
+	connection.writeTimer.userData = handle.pack();
+	connection.writeTimer.kind = WriteTimeout;
+	m_timers.arm(connection.idleTimer, std::chrono::steady_clock::now() + clientTimeout);
+	armRecv(connection);
+
+	m_clientCount = m_connections.size();
+	m_metrics.accepts.inc();
+	m_metrics.activeConnections.add(1);
+	m_tracer.record(m_tracer.sample(), TraceStage::Accept, clientFd);
+	LOG_DEBUG("Client connected: {}", clientFd);
+}
+
+void IoUringReactor::handleWake(const io_uring_cqe& cqe)
+{
+	if (cqe.res < 0)
+	{
+		LOG_ERROR("eventfd poll failed: {}", strerror(-cqe.res));
+	}
+	if (!(cqe.flags & IORING_CQE_F_MORE))
+	{
+		armWakePoll();
+	}
+
+	processCompletions();
+}
+
+void IoUringReactor::handleRecv(Connection& connection, const io_uring_cqe& cqe)
+{
+	const int clientFd = connection.tcp.getHandle();
+	const bool more = cqe.flags & IORING_CQE_F_MORE;
+	if (!more)
+	{
+		connection.recvArmed = false;
+		--connection.pendingOps;
+	}
+
+	if (cqe.res > 0)
+	{
+		const auto bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+		auto space = connection.decoder.prepareWrite(static_cast<size_t>(cqe.res));
+		std::memcpy(space.data(), m_buffers.data(bufferId), static_cast<size_t>(cqe.res));
+		connection.decoder.commitWrite(static_cast<size_t>(cqe.res));
+		m_buffers.recycle(bufferId);
+		m_metrics.bytesReceived.inc(static_cast<uint64_t>(cqe.res));
+		if (m_tracer.isEnabled())
+		{
+			connection.stream.readTicks = traceTicks();
+		}
+	}
+
+	if (connection.closing)
+	{
+		releaseIfIdle(connection);
+		return;
+	}
+
+	if (cqe.res > 0)
+	{
+		m_timers.arm(connection.idleTimer, std::chrono::steady_clock::now() + clientTimeout);
+
+		// Data that was already on its way when the receive got cancelled waits in the decoder
+		if (connection.readPaused)
+		{
+			return;
+		}
+		if (!processFrames(connection))
+		{
+			pauseReading(connection);
+			return;
+		}
+
+		if (connection.decoder.isOverflowed())
+		{
+			LOG_WARN("Client {} sent an oversized query. Closing.", clientFd);
+			closeConnection(connection);
+			return;
+		}
+		if (connection.decoder.isMalformed())
+		{
+			LOG_WARN("Client {} sent a malformed binary frame. Closing.", clientFd);
+			closeConnection(connection);
+			return;
+		}
+		if (!more)
+		{
+			// The kernel may end a multishot receive at any time; just start a new one
+			armRecv(connection);
+		}
+		return;
+	}
+
+	if (cqe.res == -ECANCELED)
+	{
+		// Cancelled by pauseReading; when the connection resumed before this arrived, the
+		// receive is re-armed here
+		if (!connection.readPaused)
+		{
+			armRecv(connection);
+		}
+		return;
+	}
+
+	if (cqe.res == -ENOBUFS)
+	{
+		// Every provided buffer is queued in some connection's CQE; they come back this batch
+		if (!connection.readPaused)
+		{
+			armRecv(connection);
+		}
+		return;
+	}
+
+	if (cqe.res < 0)
+	{
+		LOG_ERROR("recv failed on client {}: {}", clientFd, strerror(-cqe.res));
+	}
+
+	// The peer may have only shut down its write side: answer what is in flight first
+	LOG_DEBUG("Client closed or recv error: {}", clientFd);
+	connection.peerClosed = true;
+	finishIfDrained(connection);
+}
+
+void IoUringReactor::handleSend(Connection& connection, const io_uring_cqe& cqe)
+{
+	--connection.sendsInFlight;
+	--connection.pendingOps;
+
+	if (connection.closing)
+	{
+		releaseIfIdle(connection);
+		return;
+	}
+
+	if (cqe.res == -ECANCELED)
+	{
+		// An earlier send of the chain came up short; this one is resubmitted with the rest
+	}
+	else if (cqe.res < 0)
+	{
+		LOG_ERROR("send failed on client {}: {}", connection.tcp.getHandle(), strerror(-cqe.res));
+		m_metrics.sendErrors.inc();
+		closeConnection(connection);
+		return;
+	}
+	else if (static_cast<size_t>(cqe.res) < connection.stream.outbound.front().size())
+	{
+		connection.stream.outbound.front().erase(0, static_cast<size_t>(cqe.res));
+		m_metrics.bytesSent.inc(static_cast<uint64_t>(cqe.res));
+	}
+	else
+	{
+		m_metrics.bytesSent.inc(static_cast<uint64_t>(cqe.res));
+		m_pipeline.buffers().recycle(std::move(connection.stream.outbound.front()));
+		connection.stream.outbound.pop_front();
+	}
+
+	if (connection.sendsInFlight == 0)
+	{
+		if (connection.stream.outbound.empty())
+		{
+			connection.stream.tracedResponses.written(connection.stream.sequencer.released());
+		}
+		m_timers.cancel(connection.writeTimer);
+		submitSends(connection);
+		finishIfDrained(connection);
+	}
+}
+
+bool IoUringReactor::processFrames(Connection& connection)
+{
+	while (auto frame = connection.decoder.next())
+	{
+		if (connection.stream.closeAfterFlush)
+		{
+			continue;
+		}
+		const auto dispatched = m_pipeline.dispatch(connection.stream, connection.handle, connection.tcp.getHandle(),
+													*frame, connection.decoder.protocol());
+		if (dispatched == RequestPipeline::Dispatched::Deferred)
+		{
+			return false;
+		}
+		if (dispatched == RequestPipeline::Dispatched::Answered)
+		{
+			m_dirtyConnections.push_back(connection.handle);
+		}
+	}
+	return true;
+}
+
+void IoUringReactor::pauseReading(Connection& connection)
+{
+	connection.readPaused = true;
+	m_pausedConnections.push_back(connection.handle);
+	m_metrics.readPauses.inc();
+
+	if (connection.recvArmed)
+	{
+		io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = encode(RecvOp, connection.handle);
+		sqe->user_data = encode(CancelOp);
+	}
+}
+
+void IoUringReactor::resumeReading()
+{
+	std::erase_if(m_pausedConnections, [this](SlotHandle handle) {
+		Connection* connection = m_connections.get(handle);
+		if (!connection || connection->closing)
+		{
+			return true;
+		}
+		if (!m_pipeline.retry(connection->stream))
+		{
+			return false;
+		}
+
+		// Requests already buffered go before anything new is read
+		if (!processFrames(*connection))
+		{
+			return false;
+		}
+		connection->readPaused = false;
+		if (!connection->recvArmed && !connection->peerClosed)
+		{
+			armRecv(*connection);
+		}
+		return true;
+	});
+}
+
+void IoUringReactor::processCompletions()
+{
+	m_pipeline.drainCompletions([this](RequestPipeline::Completion& completion) {
+		Connection* connection = m_connections.get(completion.connection);
+		if (!connection || connection->closing)
+		{
+			// The connection went away while the request was on the pool
+			return;
+		}
+
+		connection->stream.accept(completion.sequence, std::move(completion.response));
+		m_dirtyConnections.push_back(completion.connection);
+	});
+}
+
+void IoUringReactor::finishIfDrained(Connection& connection)
+{
+	if (!connection.closing && connection.stream.outbound.empty() && connection.sendsInFlight == 0
+		&& (connection.stream.closeAfterFlush || (connection.peerClosed && connection.stream.sequencer.idle())))
+	{
+		closeConnection(connection);
+	}
+}
+
+void IoUringReactor::closeConnection(Connection& connection)
+{
+	if (connection.closing)
+	{
+		return;
+	}
+
+	// Ends the multishot receive and fails pending sends; the slot (and with it the fd) is
+	// released once the kernel has posted their last completions
+	connection.closing = true;
+	m_timers.cancel(connection.idleTimer);
+	m_timers.cancel(connection.writeTimer);
+	::shutdown(connection.tcp.getHandle(), SHUT_RDWR);
+	releaseIfIdle(connection);
+}
+
+void IoUringReactor::releaseIfIdle(Connection& connection)
+{
+	if (connection.pendingOps == 0)
+	{
+		m_connections.erase(connection.handle);
+		m_clientCount = m_connections.size();
+		m_metrics.activeConnections.add(-1);
+	}
+}
+
+size_t IoUringReactor::getClientCount() const
+{
+	return m_clientCount;
+}
+
+std::string IoUringReactor::getLocalAddress() const
+{
+	return m_server.getLocalAddress();
+}
+
+int IoUringReactor::getListenerHandle() const
+{
+	return m_server.getHandle();
+}
+
+void IoUringReactor::shutdown()
+{
+	m_stopRequested = true;
+	// The loop wakes up and cancels the accept; the descriptor itself is closed when the
+	// reactor is destroyed
+	m_pipeline.wake();
+}
+
+void IoUringReactor::checkTimeouts()
+{
+	m_timers.expire(std::chrono::steady_clock::now(), [this](const TimerWheel::Timer& timer) {
+		Connection* connection = m_connections.get(SlotHandle::unpack(timer.userData));
+		if (!connection)
+		{
+			return;
+		}
+
+		if (timer.kind == IdleTimeout)
+		{
+			LOG_INFO("Client {} timed out (no activity for {}s). Closing.",
+					 connection->tcp.getHandle(), clientTimeout.count());
+			m_metrics.idleTimeouts.inc();
+		}
+		else
+		{
+			LOG_INFO("Client {} stopped reading responses for {}s. Closing.",
+					 connection->tcp.getHandle(), writeTimeout.count());
+			m_metrics.writeTimeouts.inc();
+		}
+		closeConnection(*connection);
+	});
+}
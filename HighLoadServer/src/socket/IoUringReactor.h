@@ -0,0 +1,128 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "ServerBackend.h"
+#include "IoUring.h"
+#include "ServerMetrics.h"
+#include "AdmissionControl.h"
+#include "RequestPipeline.h"
+#include "../common/QueryDecoder.h"
+#include "../common/TimerWheel.h"
+#include "../common/SlotTable.h"
+#include "../common/RequestTracer.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// io_uring counterpart of EpollReactor. One multishot accept feeds the connection table,
+// every connection has one multishot recv drawing from shared provided buffers, and queued
+// responses leave as a chain of linked sends, so in steady state the loop makes a single
+// io_uring_enter per iteration for all of its I/O.
+class IoUringReactor
+{
+public:
+	using MessageHandler = ServerBackend::MessageHandler;
+
+	// listener is bound and listening already (see openListener)
+	IoUringReactor(TcpServer listener, AdmissionControl& admission, const MessageHandler& onMessage);
+	~IoUringReactor();
+
+	IoUringReactor(const IoUringReactor&) = delete;
+	IoUringReactor& operator=(const IoUringReactor&) = delete;
+
+	// Asks the kernel for the connections received on cpu, the one this reactor runs on
+	bool steerIncomingCpu(int cpu);
+
+	// Takes effect for requests decoded from then on; Pool until set
+	void setDispatchPolicy(DispatchPolicy dispatch);
+
+	void run();
+	void shutdown();
+
+	size_t getClientCount() const;
+	std::string getLocalAddress() const;
+	int getListenerHandle() const;
+
+private:
+	enum Operation : uint8_t {
+		AcceptOp = 1,
+		RecvOp,
+		SendOp,
+		WakeOp,
+		CancelOp,
+	};
+
+	enum TimeoutKind {
+		IdleTimeout,
+		WriteTimeout,
+	};
+
+	struct Connection {
+		explicit Connection(TcpClient client) : tcp(std::move(client)) {}
+
+		TcpClient tcp;
+		SlotHandle handle;
+		QueryDecoder decoder;
+		RequestStream stream;
+
+		// The first sendsInFlight entries of stream.outbound are referenced by submitted send
+		// SQEs; the deque keeps them in place while later responses are appended
+		size_t sendsInFlight = 0;
+
+		// Submitted operations whose final CQE has not arrived yet
+		int pendingOps = 0;
+		bool recvArmed = false;
+		bool peerClosed = false;
+		bool closing = false;
+		// A request waits in stream.stalledTask and the receive is cancelled
+		bool readPaused = false;
+
+		TimerWheel::Timer idleTimer;
+		TimerWheel::Timer writeTimer;
+	};
+
+	io_uring_sqe* getSqe();
+	void armAccept();
+	// Stops the multishot accept at shutdown. Shutting the listener down instead would stop it
+	// in every process holding it, including one it has been handed off to.
+	void cancelAccept();
+	void armWakePoll();
+	void armRecv(Connection& connection);
+	void submitSends(Connection& connection);
+
+	void handleCqe(const io_uring_cqe& cqe);
+	void handleAccept(const io_uring_cqe& cqe);
+	void handleRecv(Connection& connection, const io_uring_cqe& cqe);
+	void handleSend(Connection& connection, const io_uring_cqe& cqe);
+	void handleWake(const io_uring_cqe& cqe);
+	void processCompletions();
+	// Returns false when a request was deferred and reading has to pause
+	bool processFrames(Connection& connection);
+	void pauseReading(Connection& connection);
+	void resumeReading();
+	void finishIfDrained(Connection& connection);
+
+	void closeConnection(Connection& connection);
+	void releaseIfIdle(Connection& connection);
+	void checkTimeouts();
+
+	TcpServer m_server;
+	RequestPipeline m_pipeline;
+
+	IoUring m_ring;
+	ProvidedBuffers m_buffers;
+	bool m_acceptArmed = false;
+	bool m_acceptCancelled = false;
+
+	TimerWheel m_timers;
+	SlotTable<Connection> m_connections;
+	std::atomic<size_t> m_clientCount = 0;
+
+	std::vector<SlotHandle> m_dirtyConnections;
+	std::vector<SlotHandle> m_pausedConnections;
+
+	std::atomic<bool> m_stopRequested = false;
+
+	ServerMetrics& m_metrics = ServerMetrics::instance();
+	RequestTracer& m_tracer = RequestTracer::instance();
+};
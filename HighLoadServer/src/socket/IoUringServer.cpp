@@ -0,0 +1,158 @@
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include "IoUringServer.h"
+#include "../common/CpuAffinity.h"
+#include "../common/Logger.h"
+
+IoUringServer::IoUringServer(unsigned short port, ServerConfig config)
+	: m_reactorCpus(config.reactorCpus)
+{
+	if (config.udp)
+	{
+		throw std::runtime_error("UDP is served by the epoll backend only");
+	}
+	if (!config.unixPath.empty())
+	{
+		throw std::runtime_error("Unix sockets are served by the epoll backend only");
+	}
+	if (config.busyPoll.budget.count() > 0 || config.busyPoll.socketPoll.count() > 0)
+	{
+		throw std::runtime_error("Busy polling is done by the epoll backend only");
+	}
+
+	const size_t reactorCount = reactorCountFor(config);
+
+	m_threadPool = makeWorkerPool(config);
+	m_admission = std::make_unique<AdmissionControl>(*m_threadPool, config);
+
+	m_reactors.reserve(reactorCount);
+	for (size_t i = 0; i < reactorCount; ++i)
+	{
+		auto makeReactor = [&]() {
+			TcpServer listener = openListener(port, config, i);
+			// Port 0 binds the first listener to an ephemeral port; the other reactors join
+			// its SO_REUSEPORT group there rather than each getting a port of its own
+			if (port == 0)
+			{
+				port = listener.getLocalPort();
+			}
+			return std::make_unique<IoUringReactor>(std::move(listener), *m_admission, m_onMessage);
+		};
+		const int cpu = reactorCpu(i);
+		if (cpu < 0)
+		{
+			m_reactors.push_back(makeReactor());
+			continue;
+		}
+
+		// Built on its own CPU so its tables and buffers come from that CPU's NUMA node
+		m_reactors.push_back(runOnCpu(cpu, makeReactor));
+		if (config.steerByIncomingCpu)
+		{
+			m_reactors.back()->steerIncomingCpu(cpu);
+		}
+		LOG_INFO("Reactor {} pinned to CPU {} (NUMA node {})", i, cpu, numaNodeOf(cpu));
+	}
+
+	m_port = port;
+
+	LOG_INFO("IoUringServer listening on {} with {} reactor(s)", getLocalAddress(), reactorCount);
+}
+
+IoUringServer::~IoUringServer()
+{
+	// Workers still running queued requests post into the reactors, so drain them first.
+	m_threadPool.reset();
+}
+
+void IoUringServer::setMessageHandler(MessageHandler handler, DispatchPolicy dispatch)
+{
+	m_onMessage = std::move(handler);
+	for (auto& reactor: m_reactors)
+	{
+		reactor->setDispatchPolicy(dispatch);
+	}
+}
+
+void IoUringServer::setConnectionHandler(ConnectionHandler)
+{
+	throw std::runtime_error("Connection handlers are not supported by the io_uring backend");
+}
+
+void IoUringServer::run()
+{
+	std::vector<std::jthread> reactorThreads;
+	reactorThreads.reserve(m_reactors.size() - 1);
+
+	for (size_t i = 1; i < m_reactors.size(); ++i)
+	{
+		reactorThreads.emplace_back([reactor = m_reactors[i].get(), cpu = reactorCpu(i)]() {
+			if (cpu >= 0)
+			{
+				pinCurrentThread(cpu);
+			}
+			try
+			{
+				reactor->run();
+			}
+			catch (const std::exception& e)
+			{
+				LOG_ERROR("Reactor error: {}", e.what());
+			}
+		});
+	}
+
+	// The first reactor runs on the calling thread, which it pins like the others
+	if (reactorCpu(0) >= 0)
+	{
+		pinCurrentThread(reactorCpu(0));
+	}
+	m_reactors.front()->run();
+}
+
+void IoUringServer::shutdown()
+{
+	size_t activeClients = 0;
+	for (auto& reactor: m_reactors)
+	{
+		reactor->shutdown();
+		activeClients += reactor->getClientCount();
+	}
+	LOG_INFO("Server stopped accepting new connections.");
+
+	if (activeClients != 0)
+	{
+		LOG_INFO("Active clients: {}. Waiting for them to finish...", activeClients);
+	}
+}
+
+int IoUringServer::reactorCpu(size_t index) const
+{
+	return m_reactorCpus.empty() ? -1 : m_reactorCpus[index % m_reactorCpus.size()];
+}
+
+std::vector<int> IoUringServer::getListeners() const
+{
+	std::vector<int> listeners;
+	for (const auto& reactor: m_reactors)
+	{
+		listeners.push_back(reactor->getListenerHandle());
+	}
+	return listeners;
+}
+
+size_t IoUringServer::getReactorCount() const
+{
+	return m_reactors.size();
+}
+
+std::string IoUringServer::getLocalAddress() const
+{
+	return m_reactors.front()->getLocalAddress();
+}
+
+unsigned short IoUringServer::getLocalPort() const
+{
+	return m_port;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ServerBackend.h"
+#include "IoUringReactor.h"
+#include "AdmissionControl.h"
+#include "../common/Executor.h"
+#include <memory>
+#include <vector>
+
+class IoUringServer : public ServerBackend
+{
+public:
+	explicit IoUringServer(unsigned short port, ServerConfig config = {});
+	~IoUringServer() override;
+
+	void setMessageHandler(MessageHandler handler, DispatchPolicy dispatch) override;
+	// Coroutine handlers are driven by the epoll reactor only
+	void setConnectionHandler(ConnectionHandler handler) override;
+	void run() override;
+	void shutdown() override;
+
+	size_t getReactorCount() const override;
+	std::vector<int> getListeners() const override;
+	std::string getLocalAddress() const override;
+	unsigned short getLocalPort() const override;
+
+private:
+	// CPU reactor index is pinned to, or -1
+	int reactorCpu(size_t index) const;
+
+	MessageHandler m_onMessage;
+	std::unique_ptr<Executor> m_threadPool;
+	std::unique_ptr<AdmissionControl> m_admission;
+	std::vector<std::unique_ptr<IoUringReactor>> m_reactors;
+	std::vector<int> m_reactorCpus;
+	unsigned short m_port = 0;
+};
@@ -0,0 +1,206 @@
+#include "RequestPipeline.h"
+#include "../common/Logger.h"
+
+void RequestStream::accept(uint64_t sequence, std::string response)
+{
+	sequencer.complete(sequence, std::move(response), [this](std::string ready) {
+		if (closeAfterFlush)
+		{
+			return;
+		}
+		if (ready.empty())
+		{
+			// The handler rejected the request: send what precedes it, then close
+			closeAfterFlush = true;
+			return;
+		}
+		outbound.push_back(std::move(ready));
+	});
+}
+
+RequestPipeline::RequestPipeline(AdmissionControl& admission, const MessageHandler& onMessage)
+	: m_admission(admission)
+	, m_onMessage(onMessage)
+{
+}
+
+void RequestPipeline::setDispatchPolicy(DispatchPolicy dispatch)
+{
+	m_dispatch = dispatch;
+}
+
+RequestPipeline::Dispatched RequestPipeline::dispatch(RequestStream& stream, SlotHandle connection, int fd,
+													  std::string_view request, WireProtocol protocol)
+{
+	if (!m_onMessage)
+	{
+		// Nobody to answer it: dropped
+		return Dispatched::Queued;
+	}
+
+	const uint64_t sequence = stream.sequencer.reserve();
+	const uint64_t traceId = m_tracer.sample();
+	if (traceId != 0)
+	{
+		m_tracer.record(traceId, TraceStage::ReadComplete, fd, stream.readTicks);
+		stream.tracedResponses.add(sequence, traceId);
+	}
+
+	if (m_dispatch == DispatchPolicy::Inline)
+	{
+		// The decoder's view is good until the next read, which is all the handler needs
+		std::string response = m_buffers.take();
+		runHandler(request, protocol, traceId, response);
+		stream.accept(sequence, std::move(response));
+		return Dispatched::Answered;
+	}
+	if (m_dispatch == DispatchPolicy::Batched)
+	{
+		m_batch.push_back({ connection, sequence, protocol, copyRequest(request), m_buffers.take(), traceId });
+		return Dispatched::Queued;
+	}
+
+	// Queued without an allocation: the task is stored inline and both buffers are reused
+	static_assert(Task::storedInline<PoolRequest>);
+	Task task = PoolRequest{ this, copyRequest(request), m_buffers.take(), connection, sequence, traceId,
+							 std::chrono::steady_clock::now(), protocol };
+
+	m_tracer.record(traceId, TraceStage::Enqueue);
+	const TaskTag tag = m_admission.tagRequest(request, protocol, static_cast<uint64_t>(fd));
+	const auto result = m_admission.submit(task, tag);
+	if (result == AdmissionControl::Result::Rejected)
+	{
+		// Still owned by the task, which never ran
+		PoolRequest& refused = *task.target<PoolRequest>();
+		m_buffers.recycle(std::move(refused.request));
+		appendBusyFrame(protocol, refused.response);
+		stream.accept(sequence, std::move(refused.response));
+		return Dispatched::Answered;
+	}
+	if (result == AdmissionControl::Result::Deferred)
+	{
+		stream.stalledTask = std::move(task);
+		stream.stalledTag = tag;
+		return Dispatched::Deferred;
+	}
+	return Dispatched::Queued;
+}
+
+bool RequestPipeline::retry(RequestStream& stream)
+{
+	if (!m_admission.retry(stream.stalledTask, stream.stalledTag))
+	{
+		return false;
+	}
+	stream.stalledTask.reset();
+	return true;
+}
+
+void RequestPipeline::submitBatch()
+{
+	if (m_batch.empty())
+	{
+		return;
+	}
+
+	const size_t requestCount = m_batch.size();
+	if (m_tracer.isEnabled())
+	{
+		for (const PendingRequest& pending: m_batch)
+		{
+			m_tracer.record(pending.traceId, TraceStage::Enqueue);
+		}
+	}
+	Task task = Batch{ this, std::move(m_batch), std::chrono::steady_clock::now() };
+	m_batch.clear();
+	if (m_admission.submitBatch(task, requestCount) != AdmissionControl::Result::Rejected)
+	{
+		return;
+	}
+
+	// The requests span many connections, which the reactor looks up as it drains these
+	std::vector<Completion> busy;
+	busy.reserve(requestCount);
+	for (PendingRequest& pending: task.target<Batch>()->requests)
+	{
+		appendBusyFrame(pending.protocol, pending.response);
+		busy.push_back({ pending.connection, pending.sequence, std::move(pending.response), std::move(pending.request) });
+	}
+	m_completions.postAll(busy);
+}
+
+void RequestPipeline::PoolRequest::operator()()
+{
+	pipeline->m_tracer.record(traceId, TraceStage::Dequeue);
+	if (pipeline->m_admission.admit(enqueuedAt, std::chrono::steady_clock::now()))
+	{
+		pipeline->runHandler(request, protocol, traceId, response);
+	}
+	else
+	{
+		appendBusyFrame(protocol, response);
+	}
+	pipeline->m_completions.post({ connection, sequence, std::move(response), std::move(request) });
+}
+
+void RequestPipeline::Batch::operator()()
+{
+	RequestTracer& tracer = pipeline->m_tracer;
+	if (tracer.isEnabled())
+	{
+		for (const PendingRequest& pending: requests)
+		{
+			tracer.record(pending.traceId, TraceStage::Dequeue);
+		}
+	}
+	const bool admitted = pipeline->m_admission.admit(enqueuedAt, std::chrono::steady_clock::now(), requests.size());
+
+	std::vector<Completion> completions;
+	completions.reserve(requests.size());
+	for (PendingRequest& pending: requests)
+	{
+		if (admitted)
+		{
+			pipeline->runHandler(pending.request, pending.protocol, pending.traceId, pending.response);
+		}
+		else
+		{
+			appendBusyFrame(pending.protocol, pending.response);
+		}
+		completions.push_back({ pending.connection, pending.sequence, std::move(pending.response), std::move(pending.request) });
+	}
+	pipeline->m_completions.postAll(completions);
+}
+
+void RequestPipeline::runHandler(std::string_view request, WireProtocol protocol, uint64_t traceId, std::string& response)
+{
+	const auto startedAt = std::chrono::steady_clock::now();
+	m_tracer.record(traceId, TraceStage::HandlerStart);
+	try
+	{
+		m_onMessage(request, protocol, response);
+	}
+	catch (const std::exception& ex)
+	{
+		LOG_ERROR("Error in message handler: {}", ex.what());
+	}
+	m_tracer.record(traceId, TraceStage::HandlerEnd);
+	m_metrics.handlerDuration.record(ServerMetrics::elapsedNs(startedAt, std::chrono::steady_clock::now()));
+}
+
+std::string RequestPipeline::copyRequest(std::string_view request)
+{
+	std::string copy = m_buffers.take();
+	copy.assign(request);
+	return copy;
+}
+
+int RequestPipeline::getWakeFd() const
+{
+	return m_completions.getFd();
+}
+
+void RequestPipeline::wake()
+{
+	m_completions.signal();
+}
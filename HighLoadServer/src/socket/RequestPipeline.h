@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ServerBackend.h"
+#include "ServerMetrics.h"
+#include "AdmissionControl.h"
+#include "../common/BufferPool.h"
+#include "../common/CompletionQueue.h"
+#include "../common/ResponseSequencer.h"
+#include "../common/RequestTracer.h"
+#include "../common/SlotTable.h"
+#include "../common/Task.h"
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Request side of one connection, kept by the reactor next to its socket state
+struct RequestStream
+{
+	ResponseSequencer sequencer;
+	// When the last read returned, for the requests it completed; only kept while tracing
+	uint64_t readTicks = 0;
+	TracedResponses tracedResponses;
+
+	// Responses in request order, waiting to be sent by the reactor
+	std::deque<std::string> outbound;
+	// Set once a response is rejected (left empty): what precedes it is sent, then the
+	// connection closes and nothing is queued after it
+	bool closeAfterFlush = false;
+
+	// Set while the pool is full under OverloadPolicy::PauseReading: the refused request,
+	// its sequence already reserved, waits here and the reactor stops reading
+	Task stalledTask;
+	TaskTag stalledTag;
+
+	// Queues the response to request sequence behind every earlier one
+	void accept(uint64_t sequence, std::string response);
+};
+
+// What happens to a request between the decoder and the outbound queue, whichever backend
+// reads it: tracing, dispatch by DispatchPolicy, admission to the worker pool, the busy
+// answer when it is shed, and the responses coming back from the workers. One per reactor;
+// everything but the pool tasks runs on the reactor thread.
+//
+// Request copies and responses are built in buffers from buffers(), to which the reactor
+// returns outbound entries once sent, so that in steady state no request allocates.
+class RequestPipeline
+{
+public:
+	using MessageHandler = ServerBackend::MessageHandler;
+
+	enum class Dispatched
+	{
+		// Handed to the pool; the response arrives through drainCompletions()
+		Queued,
+		// Answered on the spot, by the handler or with a busy frame: flush the connection
+		Answered,
+		// The pool is full: stop reading the connection until retry() succeeds
+		Deferred
+	};
+
+	struct Completion {
+		SlotHandle connection;
+		uint64_t sequence;
+		std::string response;
+		// The copy the worker ran on, back for reuse
+		std::string request;
+	};
+
+	RequestPipeline(AdmissionControl& admission, const MessageHandler& onMessage);
+
+	RequestPipeline(const RequestPipeline&) = delete;
+	RequestPipeline& operator=(const RequestPipeline&) = delete;
+
+	// Takes effect for requests dispatched from then on; Pool until set
+	void setDispatchPolicy(DispatchPolicy dispatch);
+
+	// request, decoded from the connection's socket fd, belongs to stream
+	Dispatched dispatch(RequestStream& stream, SlotHandle connection, int fd, std::string_view request, WireProtocol protocol);
+	// Submits the stream's stalled request again; false while the pool is still full
+	bool retry(RequestStream& stream);
+	// Hands the requests gathered since the last call to the pool as one task. When the pool
+	// refuses it, their busy frames come back through drainCompletions().
+	void submitBatch();
+
+	// Where sent responses go back to
+	BufferPool& buffers() { return m_buffers; }
+
+	// Readable when responses are waiting; the reactor watches it
+	[[nodiscard]] int getWakeFd() const;
+	// Wakes the reactor without posting anything
+	void wake();
+	// Passes every response that has come back from the pool to onCompletion(Completion&)
+	template <typename Callback>
+	void drainCompletions(Callback&& onCompletion)
+	{
+		m_completions.consumeSignal();
+		m_completions.drain([this, &onCompletion](Completion& completion) {
+			m_buffers.recycle(std::move(completion.request));
+			onCompletion(completion);
+		});
+	}
+
+private:
+	struct PendingRequest {
+		SlotHandle connection;
+		uint64_t sequence;
+		WireProtocol protocol;
+		std::string request;
+		std::string response;
+		uint64_t traceId;
+	};
+
+	// Pool task of a DispatchPolicy::Pool hand-off; a named type so that a rejected request
+	// can be answered in the buffer it carries
+	struct PoolRequest {
+		RequestPipeline* pipeline;
+		std::string request;
+		std::string response;
+		SlotHandle connection;
+		uint64_t sequence;
+		uint64_t traceId;
+		std::chrono::steady_clock::time_point enqueuedAt;
+		WireProtocol protocol;
+
+		void operator()();
+	};
+
+	// Pool task of a DispatchPolicy::Batched hand-off; a named type so that a rejected batch
+	// can still be answered
+	struct Batch {
+		RequestPipeline* pipeline;
+		std::vector<PendingRequest> requests;
+		std::chrono::steady_clock::time_point enqueuedAt;
+
+		void operator()();
+	};
+
+	// Runs the message handler, which writes into response; any thread
+	void runHandler(std::string_view request, WireProtocol protocol, uint64_t traceId, std::string& response);
+	// A copy of request in a reused buffer
+	std::string copyRequest(std::string_view request);
+
+	AdmissionControl& m_admission;
+	const MessageHandler& m_onMessage;
+	DispatchPolicy m_dispatch = DispatchPolicy::Pool;
+
+	CompletionQueue<Completion> m_completions;
+	std::vector<PendingRequest> m_batch;
+	BufferPool m_buffers;
+
+	ServerMetrics& m_metrics = ServerMetrics::instance();
+	RequestTracer& m_tracer = RequestTracer::instance();
+};
@@ -0,0 +1,129 @@
+#include "ServerBackend.h"
+#include "EpollServer.h"
+#include "IoUringServer.h"
+#include "ServerMetrics.h"
+#include "../common/Logger.h"
+#include <algorithm>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+CoTask<> serveMessages(CoConnection& connection, const ServerBackend::MessageHandler& handler)
+{
+	while (auto request = co_await connection.read())
+	{
+		std::string response = connection.buffer();
+		handler(*request, connection.protocol(), response);
+		if (response.empty())
+		{
+			co_return;
+		}
+		co_await connection.write(std::move(response));
+	}
+}
+} // namespace
+
+std::unique_ptr<ServerBackend> makeServerBackend(unsigned short port, ServerConfig config)
+{
+	switch (config.backend)
+	{
+	case BackendKind::IoUring:
+		return std::make_unique<IoUringServer>(port, config);
+	case BackendKind::Epoll:
+	default:
+		return std::make_unique<EpollServer>(port, config);
+	}
+}
+
+std::unique_ptr<Executor> makeWorkerPool(const ServerConfig& config)
+{
+	ServerMetrics& metrics = ServerMetrics::instance();
+	PoolSizing sizing = config.workerSizing;
+	if (sizing.isElastic())
+	{
+		sizing.onResize = [&metrics](const PoolResize& resize) {
+			metrics.poolWorkers.add(static_cast<int64_t>(resize.to) - static_cast<int64_t>(resize.from));
+			(resize.to > resize.from ? metrics.poolGrows : metrics.poolShrinks).inc();
+			LOG_INFO("Worker pool resized from {} to {}: queue wait {} us, workers busy {}%, CPU {}%",
+				resize.from, resize.to, resize.queueWait.count(),
+				static_cast<int>(resize.busy * 100), static_cast<int>(resize.cpus * 100));
+		};
+	}
+
+	auto pool = makeExecutor(config.workerPool, config.queueCapacity, config.workerCpus, std::move(sizing));
+	metrics.poolWorkers.add(static_cast<int64_t>(pool->getThreadCount()));
+	return pool;
+}
+
+size_t reactorCountFor(const ServerConfig& config)
+{
+	return std::max<size_t>({ config.reactorCount, config.inheritedListeners.size(), 1 });
+}
+
+TcpServer openListener(unsigned short port, const ServerConfig& config, size_t index)
+{
+	if (index < config.inheritedListeners.size())
+	{
+		return TcpServer(config.inheritedListeners[index]);
+	}
+
+	// With a single reactor there is nobody to share the port with, so SO_REUSEPORT is
+	// only requested in multi-reactor mode, after a handoff or when one is to come.
+	const bool reusePort = reactorCountFor(config) > 1 || config.reusePort || !config.inheritedListeners.empty();
+	TcpServer listener;
+	if ((reusePort && !listener.enableReusePort()) || !listener.bind(port) || !listener.listen())
+	{
+		throw std::runtime_error("Failed to bind or listen on server socket");
+	}
+	return listener;
+}
+
+void adoptListeners(ServerConfig& config, const std::vector<int>& listeners)
+{
+	for (const int listener: listeners)
+	{
+		sockaddr_storage local{};
+		socklen_t length = sizeof(local);
+		if (getsockname(listener, reinterpret_cast<sockaddr*>(&local), &length) != 0 || local.ss_family != AF_UNIX)
+		{
+			config.inheritedListeners.push_back(listener);
+		}
+		else if (config.unixPath.empty())
+		{
+			::close(listener);
+		}
+		else
+		{
+			config.inheritedUnixListener = listener;
+		}
+	}
+}
+
+TcpServer openUnixListener(const ServerConfig& config)
+{
+	if (config.inheritedUnixListener != -1)
+	{
+		TcpServer inherited(config.inheritedUnixListener);
+		if (inherited.getLocalAddress() == "unix:" + config.unixPath)
+		{
+			return inherited;
+		}
+		LOG_WARN("Inherited {} is not {}; binding a new socket", inherited.getLocalAddress(), config.unixPath);
+	}
+
+	TcpServer listener(SocketFamily::Unix);
+	if (!listener.bind(config.unixPath) || !listener.listen())
+	{
+		throw std::runtime_error("Failed to bind or listen on unix socket " + config.unixPath);
+	}
+	return listener;
+}
+
+ServerBackend::ConnectionHandler asConnectionHandler(ServerBackend::MessageHandler handler)
+{
+	return [handler = std::move(handler)](CoConnection& connection) {
+		return serveMessages(connection, handler);
+	};
+}
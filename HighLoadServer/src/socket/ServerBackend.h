@@ -0,0 +1,176 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CoConnection.h"
+#include "TcpServer.h"
+#include "../common/CoTask.h"
+#include "../common/Executor.h"
+#include "../common/WireProtocol.h"
+
+enum class BackendKind
+{
+	Epoll,
+	IoUring
+};
+
+// What a reactor does with a request when the worker pool queue is full
+enum class OverloadPolicy
+{
+	// Answer it at once with a busy frame
+	Reject,
+	// Hold it and stop reading the connection until the pool has room
+	PauseReading,
+	// Wait for room, stalling every connection of the reactor
+	Block
+};
+
+// Where a reactor runs the message handler
+enum class DispatchPolicy
+{
+	// On the reactor thread as soon as the request is decoded: no hand-off at all, for
+	// handlers that take less time than the hand-off, but a slow one stalls the reactor
+	Inline,
+	// One worker pool task per request
+	Pool,
+	// One worker pool task per event-loop iteration, carrying every request it decoded
+	Batched
+};
+
+// Latency mode of the epoll reactors, for deployments that would rather burn CPU than pay
+// for waking a reactor that sleeps in epoll_wait
+struct BusyPollConfig
+{
+	// Longest a reactor with nothing to do polls epoll without blocking before it sleeps.
+	// The reactor adapts what it spends between 0 and this: spins that keep running out go
+	// shorter, wakeups that spinning would have caught bring them back. 0 always blocks.
+	std::chrono::microseconds budget{ 0 };
+	// SO_BUSY_POLL on accepted sockets, with SO_PREFER_BUSY_POLL: the kernel polls the
+	// device queue this long for a socket that has nothing to read. Above
+	// net.core.busy_read it needs CAP_NET_ADMIN. 0 leaves the sockets alone.
+	std::chrono::microseconds socketPoll{ 0 };
+};
+
+// What the shared worker pool tells requests apart by when it queues them (see TaskTag)
+enum class FairnessKey
+{
+	// One queue for every request
+	None,
+	// A queue per connection
+	Connection,
+	// A queue per client name (Query::name), whatever connections the client uses
+	ClientName
+};
+
+struct ServerConfig
+{
+	BackendKind backend = BackendKind::Epoll;
+	size_t reactorCount = 1;
+	WorkerPoolKind workerPool = WorkerPoolKind::Shared;
+	int maxEvents = 64;
+
+	// Requests that may wait for a worker; 0 = unbounded
+	size_t queueCapacity = 0;
+	OverloadPolicy overloadPolicy = OverloadPolicy::Reject;
+	// CoDel target for the time a request waits for a worker; 0 disables delay-based shedding
+	std::chrono::milliseconds codelTarget{ 0 };
+	std::chrono::milliseconds codelInterval{ 100 };
+
+	// Elastic sizing of the shared worker pool (see PoolSizing); the pool keeps a fixed size
+	// unless maxThreads is set
+	PoolSizing workerSizing;
+
+	// Fair queuing in the shared worker pool: a queue per key, served in turn, so that a
+	// client flooding the pool delays its own requests rather than everyone's. Requests from
+	// the listed client names queue in the High or Low lane instead of Normal; requests of a
+	// lower lane wait while any of a higher one is queued.
+	FairnessKey fairness = FairnessKey::None;
+	std::vector<std::string> highPriorityNames;
+	std::vector<std::string> lowPriorityNames;
+
+	// CPUs the reactors and the pool workers are pinned to, handed out in turn; empty leaves
+	// placement to the scheduler. With workerCpus set there is one worker per listed CPU.
+	std::vector<int> reactorCpus;
+	std::vector<int> workerCpus;
+	// Has the kernel hand each reactor the connections whose packets arrive on its CPU
+	// (SO_INCOMING_CPU); needs reactorCpus
+	bool steerByIncomingCpu = false;
+
+	// Listening sockets handed over by the process this one replaces (see ListenerHandoff),
+	// served instead of binding new ones; there are at least as many reactors as these
+	std::vector<int> inheritedListeners;
+	// The AF_UNIX listener handed over with them, served for unixPath if it is bound there;
+	// -1 when there is none
+	int inheritedUnixListener = -1;
+	// Bind with SO_REUSEPORT even with a single reactor, so that a successor that runs more
+	// reactors can add its own sockets to the group
+	bool reusePort = false;
+
+	// Also answer queries sent as UDP datagrams to the same port number, with one UdpReactor
+	// beside each reactor; epoll backend only
+	bool udp = false;
+
+	// Also accept connections on this AF_UNIX socket, a path or an abstract @name (see
+	// isUnixSocketPath), for clients on the same host; empty = TCP only. Epoll backend only.
+	std::string unixPath;
+
+	// Epoll backend only
+	BusyPollConfig busyPoll;
+};
+
+// Common surface of the I/O backends Server can run on
+class ServerBackend
+{
+public:
+	// Writes the answer to request, one frame in the connection's protocol, into response,
+	// which arrives empty and is sent as it is. Leaving it empty rejects the request: the
+	// connection closes after the earlier answers. Requests shed under overload are answered
+	// with a busy frame (see appendBusyFrame) without reaching the handler.
+	using MessageHandler = std::function<void(std::string_view request, WireProtocol protocol, std::string& response)>;
+	// Serves one connection from accept to close as a coroutine running on the reactor
+	// thread; see CoConnection. The connection closes once the coroutine returns and its
+	// writes have been sent.
+	using ConnectionHandler = std::function<CoTask<>(CoConnection& connection)>;
+
+	virtual ~ServerBackend() = default;
+
+	virtual void setMessageHandler(MessageHandler handler, DispatchPolicy dispatch = DispatchPolicy::Pool) = 0;
+	// Takes over from the message handler for connections accepted from then on. Throws
+	// when the backend has no coroutine support.
+	virtual void setConnectionHandler(ConnectionHandler handler) = 0;
+	virtual void run() = 0;
+	virtual void shutdown() = 0;
+
+	virtual size_t getReactorCount() const = 0;
+	// One listening socket per reactor, and the unix one if it has an abstract name, for
+	// handing over to a successor process
+	virtual std::vector<int> getListeners() const = 0;
+	virtual std::string getLocalAddress() const = 0;
+	// Port every reactor listens on, the one the kernel picked when constructed with port 0
+	virtual unsigned short getLocalPort() const = 0;
+};
+
+std::unique_ptr<ServerBackend> makeServerBackend(unsigned short port, ServerConfig config);
+
+// The worker pool for config; its size and resizes go to ServerMetrics and the log
+std::unique_ptr<Executor> makeWorkerPool(const ServerConfig& config);
+
+// Reactors a backend runs for config: at least one, and at least one per inherited listener
+size_t reactorCountFor(const ServerConfig& config);
+// Listening socket of reactor index: the inherited one if there is one, otherwise a new one
+// bound to port. Throws when binding fails.
+TcpServer openListener(unsigned short port, const ServerConfig& config, size_t index);
+// Sorts the listeners a predecessor handed over into config's inheritedListeners and
+// inheritedUnixListener; a unix one is closed when config has no unixPath
+void adoptListeners(ServerConfig& config, const std::vector<int>& listeners);
+// The listening socket for ServerConfig::unixPath: the inherited one if it is bound there,
+// otherwise a new one. Throws when binding fails.
+TcpServer openUnixListener(const ServerConfig& config);
+
+// handler as a connection handler: requests answered one by one on the reactor thread, as
+// under DispatchPolicy::Inline
+ServerBackend::ConnectionHandler asConnectionHandler(ServerBackend::MessageHandler handler);
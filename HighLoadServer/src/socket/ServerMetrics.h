@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "../common/Metrics.h"
+
+// Metrics shared by every reactor of either backend; looked up once and then updated lock-free
+struct ServerMetrics
+{
+	static ServerMetrics& instance()
+	{
+		static ServerMetrics metrics;
+		return metrics;
+	}
+
+	static uint64_t elapsedNs(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point until)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(until - since).count());
+	}
+
+	MetricsRegistry& registry = MetricsRegistry::instance();
+
+	Counter& accepts = registry.counter("hls_accepts_total", "Connections accepted");
+	Gauge& activeConnections = registry.gauge("hls_connections_active", "Connections currently open");
+	Counter& bytesReceived = registry.counter("hls_bytes_received_total", "Bytes read from clients");
+	Counter& bytesSent = registry.counter("hls_bytes_sent_total", "Bytes written to clients");
+	Counter& sendErrors = registry.counter("hls_send_errors_total", "Sends that failed and closed the connection");
+	Counter& idleTimeouts = registry.counter("hls_timeouts_total", "Connections closed by a timeout", "kind=\"idle\"");
+	Counter& writeTimeouts = registry.counter("hls_timeouts_total", "Connections closed by a timeout", "kind=\"write\"");
+
+	Gauge& poolQueueDepth = registry.gauge("hls_pool_queue_depth", "Requests waiting for a worker");
+	Histogram& poolQueueWait = registry.histogram("hls_pool_queue_wait_seconds", "Time a request waited for a worker");
+	Histogram& handlerDuration = registry.histogram("hls_handler_duration_seconds", "Time spent in the message handler");
+	Gauge& poolWorkers = registry.gauge("hls_pool_workers", "Worker threads in the pool");
+	Counter& poolGrows = registry.counter("hls_pool_resizes_total", "Times an elastic pool resized", "direction=\"grow\"");
+	Counter& poolShrinks = registry.counter("hls_pool_resizes_total", "Times an elastic pool resized", "direction=\"shrink\"");
+
+	Counter& queueFullSheds = registry.counter("hls_requests_shed_total", "Requests answered busy without reaching the handler", "reason=\"queue_full\"");
+	Counter& codelSheds = registry.counter("hls_requests_shed_total", "Requests answered busy without reaching the handler", "reason=\"codel\"");
+	Counter& datagramsReceived = registry.counter("hls_udp_datagrams_total", "UDP datagrams", "direction=\"in\"");
+	Counter& datagramsSent = registry.counter("hls_udp_datagrams_total", "UDP datagrams", "direction=\"out\"");
+	Counter& datagramsDropped = registry.counter("hls_udp_datagrams_dropped_total", "UDP queries left unanswered: truncated, malformed, rejected or unsendable");
+
+	Histogram& busyPollSpin = registry.histogram("hls_busy_poll_spin_seconds", "Time a reactor polled epoll without blocking before it found events or slept");
+	Counter& busyPollHits = registry.counter("hls_busy_polls_total", "Busy-poll spins of a reactor", "outcome=\"events\"");
+	Counter& busyPollMisses = registry.counter("hls_busy_polls_total", "Busy-poll spins of a reactor", "outcome=\"slept\"");
+
+	Counter& readPauses = registry.counter("hls_read_pauses_total", "Times a connection stopped being read because the worker pool was full");
+};
@@ -1,9 +1,11 @@
 #include "Socket.h"
-#include <iostream>
 #include <stdexcept>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include "../common/Logger.h"
 
 Socket::Socket(int sock)
 	: m_sock(sock)
@@ -47,7 +49,7 @@ void Socket::close()
 	if (m_sock != -1)
 	{
 		::close(m_sock);
-		std::cout << "Connection closed" << std::endl;
+		LOG_DEBUG("Connection closed");
 		m_sock = -1;
 	}
 }
@@ -82,4 +84,28 @@ int Socket::recv(char* buffer, int len) const
 	}
 
 	return result;
+}
+
+bool isUnixSocketPath(std::string_view address)
+{
+	return address.starts_with('/') || address.starts_with('@');
+}
+
+socklen_t makeUnixAddress(std::string_view path, sockaddr_un& out)
+{
+	out = {};
+	out.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(out.sun_path))
+	{
+		return 0;
+	}
+
+	std::copy(path.begin(), path.end(), out.sun_path);
+	if (path.front() == '@')
+	{
+		// Abstract names start with a NUL and take exactly the bytes given, no terminator
+		out.sun_path[0] = '\0';
+		return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+	}
+	return static_cast<socklen_t>(sizeof(out));
 }
\ No newline at end of file
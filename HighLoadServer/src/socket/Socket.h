@@ -1,6 +1,22 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum class SocketFamily
+{
+	Inet,
+	// AF_UNIX stream sockets, for clients on the same host
+	Unix
+};
+
+// Whether address names an AF_UNIX socket rather than an IPv4 host: an absolute path, or
+// @name for a name in the abstract namespace, which leaves nothing behind in the filesystem
+bool isUnixSocketPath(std::string_view address);
+// Fills out for a path as above; 0 when it does not fit in sun_path
+socklen_t makeUnixAddress(std::string_view path, sockaddr_un& out);
 
 class Socket
 {
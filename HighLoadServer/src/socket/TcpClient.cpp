@@ -1,18 +1,17 @@
 #include "TcpClient.h"
 
-#include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
-#include <syncstream>
+#include "../common/Logger.h"
 
-TcpClient::TcpClient()
-	: Socket(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
+TcpClient::TcpClient(SocketFamily family)
+	: Socket(family == SocketFamily::Unix ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
 {
-	std::osyncstream(std::cout) << "Client socket created" << std::endl;
+	LOG_DEBUG("Client socket created");
 	if (!isValid())
 	{
 		throw std::runtime_error("Invalid socket handle");
@@ -36,14 +35,29 @@ bool TcpClient::connect(const std::string& ip, u_short port) const
 	addr.sin_addr.s_addr = inet_addr(ip.c_str());
 
 	const int result = ::connect(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
-	std::osyncstream(std::cout) << "Client socket connected to " << ip << ":" << port << std::endl;
+	LOG_DEBUG("Client socket connected to {}:{}", ip, port);
+
+	return result != -1;
+}
+
+bool TcpClient::connect(const std::string& path) const
+{
+	sockaddr_un addr{};
+	const socklen_t length = makeUnixAddress(path, addr);
+	if (length == 0)
+	{
+		return false;
+	}
+
+	const int result = ::connect(m_sock, reinterpret_cast<sockaddr*>(&addr), length);
+	LOG_DEBUG("Client socket connected to {}", path);
 
 	return result != -1;
 }
 
 int TcpClient::sendString(const std::string& str) const
 {
-	std::osyncstream(std::cout) << "Send: " << str << std::endl;
+	LOG_DEBUG("Send: {}", str);
 	return send(str.c_str(), static_cast<int>(str.length()));
 }
 
@@ -65,19 +79,39 @@ std::string TcpClient::receiveString(size_t maxLen) const
 		}
 		if (bytes == 0)
 		{
-			std::osyncstream(std::cout) << "Connection closed by peer" << std::endl;
+			LOG_DEBUG("Connection closed by peer");
 			return {};
 		}
 
 		std::string str(buffer.data(), static_cast<size_t>(bytes));
-		std::osyncstream(std::cout) << "Receive: " << str << std::endl;
+		LOG_DEBUG("Receive: {}", str);
 		return str;
 	}
 	catch (const std::exception& e)
 	{
-		std::osyncstream(std::cout) << e.what() << std::endl;
+		LOG_ERROR("{}", e.what());
 	}
 
 	return "";
 }
 
+ssize_t TcpClient::receiveSome(char* buffer, size_t len) const
+{
+	return ::recv(m_sock, buffer, len, 0);
+}
+
+ssize_t TcpClient::sendSome(const iovec* buffers, size_t count) const
+{
+	msghdr message{};
+	message.msg_iov = const_cast<iovec*>(buffers);
+	message.msg_iovlen = count;
+	return ::sendmsg(m_sock, &message, MSG_NOSIGNAL);
+}
+
+bool TcpClient::setBusyPoll(std::chrono::microseconds duration) const
+{
+	const int usec = static_cast<int>(duration.count());
+	const int prefer = 1;
+	return setsockopt(m_sock, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) == 0
+		&& setsockopt(m_sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) == 0;
+}
@@ -1,13 +1,25 @@
 #pragma once
 #include "Socket.h"
+#include <chrono>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 class TcpClient : public Socket
 {
 public:
-	TcpClient();
+	explicit TcpClient(SocketFamily family = SocketFamily::Inet);
 	explicit TcpClient(int sock);
 	bool connect(const std::string& ip, u_short port) const;
+	// AF_UNIX: connects to a path or an abstract @name (see isUnixSocketPath)
+	bool connect(const std::string& path) const;
 
 	int sendString(const std::string& str) const;
 	std::string receiveString(size_t maxLen = 1024) const;
+	// Raw non-throwing recv for event loops: bytes read, 0 on orderly close, -1 with errno set
+	ssize_t receiveSome(char* buffer, size_t len) const;
+	// Gathered non-blocking write (writev semantics without SIGPIPE): bytes written or -1 with errno set
+	ssize_t sendSome(const iovec* buffers, size_t count) const;
+	// SO_BUSY_POLL for duration and SO_PREFER_BUSY_POLL; false with errno set when the kernel
+	// refuses either
+	bool setBusyPoll(std::chrono::microseconds duration) const;
 };
@@ -1,26 +1,86 @@
 #include "TcpServer.h"
 #include "TcpClient.h"
-#include <iostream>
 #include <stdexcept>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <cstddef>
 #include <cstring>
-#include <syncstream>
+#include <utility>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../common/Logger.h"
 
-TcpServer::TcpServer()
-	: Socket(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
+TcpServer::TcpServer(SocketFamily family)
+	: Socket(family == SocketFamily::Unix ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
 {
-	std::osyncstream(std::cout) << "Server socket created" << std::endl;
+	LOG_DEBUG("Server socket created");
 	if (!isValid())
 	{
 		throw std::runtime_error("Invalid socket: " + std::string(strerror(errno)));
 	}
+	if (family == SocketFamily::Unix)
+	{
+		return;
+	}
 
 	int yes = 1;
 	if (setsockopt(m_sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1)
 	{
-		std::cerr << "Warning: setsockopt(SO_REUSEADDR) failed" << std::endl;
+		LOG_WARN("setsockopt(SO_REUSEADDR) failed: {}", strerror(errno));
+	}
+}
+
+TcpServer::TcpServer(int listeningSocket)
+	: Socket(listeningSocket)
+{
+}
+
+TcpServer::~TcpServer()
+{
+	struct stat current{};
+	if (!m_boundPath.empty() && ::stat(m_boundPath.c_str(), &current) == 0 && current.st_ino == m_boundInode)
+	{
+		::unlink(m_boundPath.c_str());
+	}
+}
+
+TcpServer::TcpServer(TcpServer&& other) noexcept
+	: Socket(std::move(other))
+	, m_boundPath(std::exchange(other.m_boundPath, {}))
+	, m_boundInode(std::exchange(other.m_boundInode, 0))
+{
+}
+
+TcpServer& TcpServer::operator=(TcpServer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Socket::operator=(std::move(other));
+		m_boundPath = std::exchange(other.m_boundPath, {});
+		m_boundInode = std::exchange(other.m_boundInode, 0);
+	}
+	return *this;
+}
+
+bool TcpServer::enableReusePort() const
+{
+	int yes = 1;
+	if (setsockopt(m_sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)
+	{
+		LOG_ERROR("setsockopt(SO_REUSEPORT) failed: {}", strerror(errno));
+		return false;
 	}
+	return true;
+}
+
+bool TcpServer::setIncomingCpu(int cpu) const
+{
+	if (setsockopt(m_sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == -1)
+	{
+		LOG_ERROR("setsockopt(SO_INCOMING_CPU) failed: {}", strerror(errno));
+		return false;
+	}
+	return true;
 }
 
 bool TcpServer::bind(unsigned short port) const
@@ -33,44 +93,90 @@ bool TcpServer::bind(unsigned short port) const
 	const int result = ::bind(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
 	if (result == 0)
 	{
-		std::osyncstream(std::cout) << "Server socket bound to port " << port << std::endl;
+		LOG_DEBUG("Server socket bound to port {}", port);
 		return true;
 	}
 	else
 	{
-		std::osyncstream(std::cerr) << "Bind failed: " << strerror(errno) << std::endl;
+		LOG_ERROR("Bind failed: {}", strerror(errno));
 		return false;
 	}
 }
 
+bool TcpServer::bind(const std::string& path)
+{
+	sockaddr_un addr{};
+	const socklen_t length = makeUnixAddress(path, addr);
+	if (length == 0)
+	{
+		LOG_ERROR("Bind failed: invalid socket path '{}'", path);
+		return false;
+	}
+
+	// Only ever a socket: anything else at path is left alone and bind fails on it
+	struct stat existing{};
+	const bool inFilesystem = path.front() != '@';
+	if (inFilesystem && ::lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+	{
+		::unlink(path.c_str());
+	}
+
+	if (::bind(m_sock, reinterpret_cast<sockaddr*>(&addr), length) == -1)
+	{
+		LOG_ERROR("Bind to {} failed: {}", path, strerror(errno));
+		return false;
+	}
+
+	struct stat bound{};
+	if (inFilesystem && ::stat(path.c_str(), &bound) == 0)
+	{
+		m_boundPath = path;
+		m_boundInode = bound.st_ino;
+	}
+	LOG_DEBUG("Server socket bound to {}", path);
+	return true;
+}
+
 bool TcpServer::listen(int backlog) const
 {
 	const int result = ::listen(m_sock, backlog);
 	if (result == -1)
 	{
-		std::osyncstream(std::cerr) << "Listen failed: " << strerror(errno) << std::endl;
+		LOG_ERROR("Listen failed: {}", strerror(errno));
 		return false;
 	}
 	return true;
 }
 
-std::unique_ptr<TcpClient> TcpServer::accept() const
+std::optional<TcpClient> TcpServer::accept() const
 {
 	int client_fd = ::accept(m_sock, nullptr, nullptr);
 	if (client_fd == -1)
 	{
 		if (errno != EAGAIN && errno != EWOULDBLOCK)
 		{
-			std::osyncstream(std::cerr) << "Accept failed: " << strerror(errno) << std::endl;
+			LOG_ERROR("Accept failed: {}", strerror(errno));
 		}
-		return nullptr;
+		return std::nullopt;
 	}
 
-	return std::make_unique<TcpClient>(client_fd);
+	return TcpClient(client_fd);
 }
 
 std::string TcpServer::getLocalAddress() const
 {
+	sockaddr_un local{};
+	socklen_t localLen = sizeof(local);
+	if (getsockname(m_sock, reinterpret_cast<sockaddr*>(&local), &localLen) == 0 && local.sun_family == AF_UNIX)
+	{
+		const size_t pathLen = localLen - offsetof(sockaddr_un, sun_path);
+		if (pathLen > 0 && local.sun_path[0] == '\0')
+		{
+			return "unix:@" + std::string(local.sun_path + 1, pathLen - 1);
+		}
+		return "unix:" + std::string(local.sun_path, strnlen(local.sun_path, pathLen));
+	}
+
 	sockaddr_in addr{};
 	socklen_t len = sizeof(addr);
 	if (getsockname(m_sock, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
@@ -82,4 +188,15 @@ std::string TcpServer::getLocalAddress() const
 		}
 	}
 	return "unknown";
-}
\ No newline at end of file
+}
+
+u_short TcpServer::getLocalPort() const
+{
+	sockaddr_in addr{};
+	socklen_t len = sizeof(addr);
+	if (getsockname(m_sock, reinterpret_cast<sockaddr*>(&addr), &len) == 0 && addr.sin_family == AF_INET)
+	{
+		return ntohs(addr.sin_port);
+	}
+	return 0;
+}
@@ -1,17 +1,41 @@
 #pragma once
-#include <memory>
+#include <optional>
 
 #include "Socket.h"
 #include "TcpClient.h"
 #include <sys/socket.h>
+#include <sys/types.h>
 
+// Listening stream socket: TCP over IPv4, or AF_UNIX for clients on the same host
 class TcpServer : public Socket
 {
 public:
-	TcpServer();
+	explicit TcpServer(SocketFamily family = SocketFamily::Inet);
+	// Takes over a socket that is already bound and listening, e.g. one inherited from the
+	// process this one replaces
+	explicit TcpServer(int listeningSocket);
+	// Removes the socket file bound by bind(path), unless another server has replaced it since
+	~TcpServer() override;
+
+	TcpServer(TcpServer&& other) noexcept;
+	TcpServer& operator=(TcpServer&& other) noexcept;
+
+	bool enableReusePort() const;
+	// Within a SO_REUSEPORT group, prefer this socket for connections received on cpu
+	bool setIncomingCpu(int cpu) const;
 	bool bind(u_short port) const;
+	// AF_UNIX: binds to a path or an abstract @name (see isUnixSocketPath). A socket file left
+	// at path, say by a server that crashed or one being replaced, is removed first.
+	bool bind(const std::string& path);
 	bool listen(int backlog = SOMAXCONN) const;
-	std::unique_ptr<TcpClient> accept() const;
+	std::optional<TcpClient> accept() const;
 
 	std::string getLocalAddress() const;
+	// Port an IPv4 socket is bound to, e.g. the one the kernel picked for bind(0); 0 otherwise
+	u_short getLocalPort() const;
+
+private:
+	// Socket file created by bind(path) and its inode, to tell it from a successor's
+	std::string m_boundPath;
+	ino_t m_boundInode = 0;
 };
@@ -0,0 +1,224 @@
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "UdpReactor.h"
+#include "../common/Logger.h"
+
+constexpr uint64_t socketToken = 0;
+constexpr uint64_t wakeToken = 1;
+
+UdpReactor::UdpReactor(unsigned short port, const MessageHandler& onMessage)
+	: m_onMessage(onMessage), m_buffers(new char[batchSize * maxDatagramSize])
+{
+	if (!m_socket.enableReusePort() || !m_socket.bind(port))
+	{
+		throw std::runtime_error("Failed to bind UDP socket");
+	}
+
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd == -1 || m_wakeFd == -1)
+	{
+		const std::string error = strerror(errno);
+		if (m_epollFd != -1)
+		{
+			close(m_epollFd);
+		}
+		if (m_wakeFd != -1)
+		{
+			close(m_wakeFd);
+		}
+		throw std::runtime_error("epoll_create1/eventfd failed: " + error);
+	}
+
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u64 = socketToken;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_socket.getHandle(), &event);
+	event.data.u64 = wakeToken;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+	for (unsigned i = 0; i < batchSize; ++i)
+	{
+		m_requestVectors[i] = { m_buffers.get() + i * maxDatagramSize, maxDatagramSize };
+		m_requests[i].msg_hdr.msg_iov = &m_requestVectors[i];
+		m_requests[i].msg_hdr.msg_iovlen = 1;
+		m_requests[i].msg_hdr.msg_name = &m_peers[i];
+	}
+}
+
+UdpReactor::~UdpReactor()
+{
+	close(m_epollFd);
+	close(m_wakeFd);
+}
+
+bool UdpReactor::steerIncomingCpu(int cpu)
+{
+	return m_socket.setIncomingCpu(cpu);
+}
+
+void UdpReactor::run()
+{
+	epoll_event events[2];
+	while (!m_stopRequested)
+	{
+		const int count = epoll_wait(m_epollFd, events, 2, -1);
+		if (count == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			LOG_ERROR("UDP epoll_wait error: {}", strerror(errno));
+			break;
+		}
+
+		// A full batch means more may be waiting; a short one has drained the socket
+		while (!m_stopRequested && serveBatch() == batchSize)
+		{
+		}
+	}
+}
+
+unsigned UdpReactor::serveBatch()
+{
+	for (mmsghdr& request: m_requests)
+	{
+		request.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		request.msg_hdr.msg_flags = 0;
+	}
+
+	int received;
+	do
+	{
+		received = m_socket.receiveBatch(m_requests.data(), batchSize);
+	} while (received == -1 && errno == EINTR);
+	if (received <= 0)
+	{
+		if (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			LOG_ERROR("recvmmsg failed: {}", strerror(errno));
+		}
+		return 0;
+	}
+	const uint64_t readTicks = m_tracer.isEnabled() ? traceTicks() : 0;
+
+	const auto count = static_cast<unsigned>(received);
+	unsigned replies = 0;
+	uint64_t bytesIn = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const mmsghdr& request = m_requests[i];
+		bytesIn += request.msg_len;
+		m_traceIds[i] = m_tracer.sample();
+		m_tracer.record(m_traceIds[i], TraceStage::ReadComplete, m_socket.getHandle(), readTicks);
+
+		m_responses[i].clear();
+		if (!(request.msg_hdr.msg_flags & MSG_TRUNC))
+		{
+			answer(i, { m_buffers.get() + i * maxDatagramSize, request.msg_len });
+		}
+		if (m_responses[i].empty())
+		{
+			m_metrics.datagramsDropped.inc();
+			continue;
+		}
+
+		m_replyVectors[replies] = { m_responses[i].data(), m_responses[i].size() };
+		mmsghdr& reply = m_replies[replies++];
+		reply.msg_hdr = {};
+		reply.msg_hdr.msg_name = &m_peers[i];
+		reply.msg_hdr.msg_namelen = request.msg_hdr.msg_namelen;
+		reply.msg_hdr.msg_iov = &m_replyVectors[replies - 1];
+		reply.msg_hdr.msg_iovlen = 1;
+	}
+	m_metrics.datagramsReceived.inc(count);
+	m_metrics.bytesReceived.inc(bytesIn);
+
+	unsigned sent = 0;
+	unsigned delivered = 0;
+	while (sent < replies)
+	{
+		const int result = m_socket.sendBatch(m_replies.data() + sent, replies - sent);
+		if (result == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result == -1)
+		{
+			// A full send buffer or an unreachable peer: UDP gives up on that datagram
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				LOG_DEBUG("sendmmsg failed: {}", strerror(errno));
+			}
+			m_metrics.sendErrors.inc();
+			m_metrics.datagramsDropped.inc();
+			++sent;
+			continue;
+		}
+		for (int i = 0; i < result; ++i)
+		{
+			m_metrics.bytesSent.inc(m_replies[sent + i].msg_len);
+		}
+		sent += static_cast<unsigned>(result);
+		delivered += static_cast<unsigned>(result);
+	}
+	m_metrics.datagramsSent.inc(delivered);
+
+	if (m_tracer.isEnabled())
+	{
+		const uint64_t writeTicks = traceTicks();
+		for (unsigned i = 0; i < count; ++i)
+		{
+			m_tracer.record(m_traceIds[i], TraceStage::WriteComplete, -1, writeTicks);
+		}
+	}
+	return count;
+}
+
+void UdpReactor::answer(unsigned index, std::string_view datagram)
+{
+	if (datagram.empty() || !m_onMessage)
+	{
+		return;
+	}
+	const WireProtocol protocol = static_cast<uint8_t>(datagram.front()) == binaryQueryMarker ? WireProtocol::Binary : WireProtocol::Text;
+	if (protocol == WireProtocol::Binary
+		&& (binaryFrameSize(datagram) != datagram.size() || !isBinaryHeaderValid(datagram)))
+	{
+		return;
+	}
+
+	const auto startedAt = std::chrono::steady_clock::now();
+	m_tracer.record(m_traceIds[index], TraceStage::HandlerStart);
+	try
+	{
+		m_onMessage(datagram, protocol, m_responses[index]);
+	}
+	catch (const std::exception& ex)
+	{
+		LOG_ERROR("Error in message handler: {}", ex.what());
+		m_responses[index].clear();
+	}
+	m_tracer.record(m_traceIds[index], TraceStage::HandlerEnd);
+	m_metrics.handlerDuration.record(ServerMetrics::elapsedNs(startedAt, std::chrono::steady_clock::now()));
+}
+
+void UdpReactor::shutdown()
+{
+	m_stopRequested = true;
+	const uint64_t one = 1;
+	if (::write(m_wakeFd, &one, sizeof(one)) == -1)
+	{
+		LOG_ERROR("UDP reactor wakeup failed: {}", strerror(errno));
+	}
+}
+
+std::string UdpReactor::getLocalAddress() const
+{
+	return m_socket.getLocalAddress();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "UdpSocket.h"
+#include "ServerBackend.h"
+#include "ServerMetrics.h"
+#include "../common/QueryDecoder.h"
+#include "../common/RequestTracer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Serves queries over UDP. A datagram carries one query frame, text or binary, and is
+// answered with one datagram in the same protocol; there is no connection, so nothing to
+// accept, order or time out. Each reactor owns a socket of the port's SO_REUSEPORT group,
+// so the kernel shards datagrams across reactors by source address, and moves up to
+// batchSize datagrams per recvmmsg and per sendmmsg. The handler runs inline on the reactor
+// thread, as under DispatchPolicy::Inline, and a batch is answered with one sendmmsg.
+class UdpReactor
+{
+public:
+	using MessageHandler = ServerBackend::MessageHandler;
+
+	static constexpr unsigned batchSize = 64;
+	// Room for the largest query frame; longer datagrams are dropped
+	static constexpr size_t maxDatagramSize = QueryDecoder::defaultMaxFrameSize;
+
+	// Binds to port in a SO_REUSEPORT group, so that every reactor and a successor process
+	// can add their own sockets. Throws when binding fails.
+	UdpReactor(unsigned short port, const MessageHandler& onMessage);
+	~UdpReactor();
+
+	UdpReactor(const UdpReactor&) = delete;
+	UdpReactor& operator=(const UdpReactor&) = delete;
+
+	// Asks the kernel for the datagrams received on cpu, the one this reactor runs on
+	bool steerIncomingCpu(int cpu);
+
+	void run();
+	void shutdown();
+
+	std::string getLocalAddress() const;
+
+private:
+	// Reads, answers and sends one batch; returns the number of datagrams read
+	unsigned serveBatch();
+	// Empty when the datagram is not a complete frame or the handler rejects it
+	void answer(unsigned index, std::string_view datagram);
+
+	UdpSocket m_socket;
+	int m_epollFd = -1;
+	int m_wakeFd = -1;
+	const MessageHandler& m_onMessage;
+
+	// Receive side: one buffer and one source address per slot of the batch
+	std::unique_ptr<char[]> m_buffers;
+	std::array<sockaddr_in, batchSize> m_peers{};
+	std::array<iovec, batchSize> m_requestVectors{};
+	std::array<mmsghdr, batchSize> m_requests{};
+
+	// Send side: responses keep their capacity from batch to batch
+	std::array<std::string, batchSize> m_responses;
+	std::array<uint64_t, batchSize> m_traceIds{};
+	std::array<iovec, batchSize> m_replyVectors{};
+	std::array<mmsghdr, batchSize> m_replies{};
+
+	std::atomic<bool> m_stopRequested = false;
+
+	ServerMetrics& m_metrics = ServerMetrics::instance();
+	RequestTracer& m_tracer = RequestTracer::instance();
+};
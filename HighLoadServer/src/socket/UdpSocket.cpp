@@ -0,0 +1,77 @@
+#include "UdpSocket.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../common/Logger.h"
+
+UdpSocket::UdpSocket()
+	: Socket(socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP))
+{
+	if (!isValid())
+	{
+		throw std::runtime_error("Invalid socket: " + std::string(strerror(errno)));
+	}
+}
+
+bool UdpSocket::enableReusePort() const
+{
+	int yes = 1;
+	if (setsockopt(m_sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)
+	{
+		LOG_ERROR("setsockopt(SO_REUSEPORT) failed: {}", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool UdpSocket::setIncomingCpu(int cpu) const
+{
+	if (setsockopt(m_sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == -1)
+	{
+		LOG_ERROR("setsockopt(SO_INCOMING_CPU) failed: {}", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool UdpSocket::bind(u_short port) const
+{
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = INADDR_ANY;
+
+	if (::bind(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
+	{
+		LOG_ERROR("UDP bind failed: {}", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+int UdpSocket::receiveBatch(mmsghdr* messages, unsigned count) const
+{
+	return ::recvmmsg(m_sock, messages, count, MSG_DONTWAIT, nullptr);
+}
+
+int UdpSocket::sendBatch(mmsghdr* messages, unsigned count) const
+{
+	return ::sendmmsg(m_sock, messages, count, MSG_DONTWAIT);
+}
+
+std::string UdpSocket::getLocalAddress() const
+{
+	sockaddr_in addr{};
+	socklen_t len = sizeof(addr);
+	if (getsockname(m_sock, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+	{
+		char ipStr[INET_ADDRSTRLEN];
+		if (inet_ntop(AF_INET, &addr.sin_addr, ipStr, sizeof(ipStr)))
+		{
+			return std::string(ipStr) + ":" + std::to_string(ntohs(addr.sin_port));
+		}
+	}
+	return "unknown";
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "Socket.h"
+
+// Non-blocking IPv4 datagram socket that moves many datagrams per system call
+class UdpSocket : public Socket
+{
+public:
+	UdpSocket();
+	bool enableReusePort() const;
+	// Within a SO_REUSEPORT group, prefer this socket for datagrams received on cpu
+	bool setIncomingCpu(int cpu) const;
+	bool bind(u_short port) const;
+
+	// recvmmsg/sendmmsg without blocking: the number of messages moved, or -1 with errno set
+	int receiveBatch(mmsghdr* messages, unsigned count) const;
+	int sendBatch(mmsghdr* messages, unsigned count) const;
+
+	std::string getLocalAddress() const;
+};